@@ -0,0 +1,233 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_ARENA_AVL_H_
+#define ABSTRACT_CONTAINER_ARENA_AVL_H_
+
+// AVL Tree with Nodes in a Fixed-Size Array.
+//
+// The nodes of the tree are elements of an array (the arena) that is a
+// member of the tree object.  Handles are indexes into the array, of an
+// unsigned integer type that can be narrower than a pointer (typically
+// uint16_t or uint32_t).  The balance factor is packed into the high bits
+// of the child links (as in avl_ex2.cpp), so the only overhead per node
+// is two indexes.  The arena also serves as the storage allocator for the
+// nodes, with a free list, so there is no use of new/delete.
+
+#include <stddef.h>
+#include <assert.h>
+
+#include "avl_tree.h"
+
+namespace abstract_container
+{
+
+// Abstractor for avl_tree, for nodes in an array.
+//
+// traits parameter class must have these public members, or equivalents
+// (the same as for mmap_avl_abs):
+//
+// Types:
+//
+// key -- a copyable type.
+// value -- the type of the data stored in each node.
+//
+// Member functions:
+//
+// int compare_key_value(key k, const value &v) -- returns a negative,
+//   zero or positive value if k is less than, equal to or greater than the
+//   key of v.
+// int compare_value_value(const value &v1, const value &v2) -- returns a
+//   negative, zero or positive value if the key of v1 is less than, equal
+//   to or greater than the key of v2.
+//
+// index must be an unsigned integral type.  The high bit of an index is
+// not part of the handle, so capacity must be less than half the number
+// of values of index.
+//
+template <class traits, typename index, index capacity>
+class arena_avl_abs
+  {
+  public:
+
+    typedef index handle;
+    typedef index size;
+    typedef typename traits::key key;
+    typedef typename traits::value value;
+
+    // Element of the arena.  The high bit of lt is set if the balance
+    // factor is not zero.  The high bit of gt is set if the balance
+    // factor is negative.  In free nodes, lt is the free list link.
+    struct node
+      {
+	index lt, gt;
+	value val;
+      };
+
+  private:
+
+    static const index bf_bit = index(index(1) << ((8 * sizeof(index)) - 1));
+
+    static const index link_mask = index(bf_bit - 1);
+
+    // Causes a compile error if the capacity is too big for the index
+    // type.
+    typedef char capacity_check[(capacity <= link_mask) ? 1 : -1];
+
+  public:
+
+    handle get_less(handle h, bool) { return(arena[h].lt & link_mask); }
+    void set_less(handle h, handle lh)
+      { arena[h].lt = index((arena[h].lt & bf_bit) | lh); }
+
+    handle get_greater(handle h, bool) { return(arena[h].gt & link_mask); }
+    void set_greater(handle h, handle gh)
+      { arena[h].gt = index((arena[h].gt & bf_bit) | gh); }
+
+    int get_balance_factor(handle h)
+      {
+	if (arena[h].gt & bf_bit)
+	  return(-1);
+	return(arena[h].lt >> ((8 * sizeof(index)) - 1));
+      }
+    void set_balance_factor(handle h, int bf)
+      {
+	node &n = arena[h];
+
+	n.lt &= link_mask;
+	n.gt &= link_mask;
+	if (bf != 0)
+	  {
+	    n.lt |= bf_bit;
+	    if (bf < 0)
+	      n.gt |= bf_bit;
+	  }
+      }
+
+    int compare_key_node(key k, handle h)
+      { return(traits::compare_key_value(k, arena[h].val)); }
+
+    int compare_node_node(handle h1, handle h2)
+      { return(traits::compare_value_value(arena[h1].val, arena[h2].val)); }
+
+    // Largest value that fits in the low bits of an index.
+    static handle null() { return(link_mask); }
+
+    static bool read_error() { return(false); }
+
+    arena_avl_abs() { reset(); }
+
+    // Returns the handle of a newly allocated node, or null if all the
+    // nodes are in use.
+    handle alloc()
+      {
+	handle h = free_list;
+
+	if (h != null())
+	  {
+	    free_list = arena[h].lt;
+	    return(h);
+	  }
+
+	if (num_used == capacity)
+	  return(null());
+
+	return(num_used++);
+      }
+
+    // Free a node (that is not in the tree), so it can be reused.
+    void free(handle h)
+      {
+	arena[h].lt = free_list;
+	free_list = h;
+      }
+
+    // Makes all the nodes free.
+    void reset()
+      {
+	free_list = null();
+	num_used = 0;
+      }
+
+    value & val(handle h)
+      {
+	assert(h < capacity);
+
+	return(arena[h].val);
+      }
+
+  private:
+
+    // List of free nodes, linked by the lt field.
+    handle free_list;
+
+    // Nodes at or above this index have never been allocated.
+    size num_used;
+
+    node arena[capacity];
+  };
+
+// AVL tree with its nodes in an array that is part of the tree object.  So,
+// if the capacity is large, the tree object should be static or
+// dynamically allocated, not on the stack.
+//
+template <class traits, typename index, index capacity,
+	  unsigned max_depth = 48>
+class arena_avl_tree :
+  public avl_tree<arena_avl_abs<traits, index, capacity>, max_depth>
+  {
+  private:
+
+    typedef avl_tree<arena_avl_abs<traits, index, capacity>, max_depth> base;
+
+  public:
+
+    typedef typename base::handle handle;
+    typedef typename base::size size;
+    typedef typename traits::value value;
+
+    // Memory used by each node, including the links and balance factor.
+    static const size_t node_size =
+      sizeof(typename arena_avl_abs<traits, index, capacity>::node);
+
+    // The null handle (the largest handle value).
+    static handle null()
+      { return(arena_avl_abs<traits, index, capacity>::null()); }
+
+    // Returns the handle of a newly allocated node (not in the tree), or
+    // null if all the nodes are in use.
+    handle alloc() { return(this->abs.alloc()); }
+
+    // Frees a node that is not in the tree.
+    void free(handle h) { this->abs.free(h); }
+
+    // Empties the tree, and makes all the nodes free.
+    void clear()
+      {
+	this->purge();
+	this->abs.reset();
+      }
+
+    value & val(handle h) { return(this->abs.val(h)); }
+  };
+
+} // end namespace abstract_container
+
+#endif
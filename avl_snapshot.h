@@ -0,0 +1,395 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_AVL_SNAPSHOT_H_
+#define ABSTRACT_CONTAINER_AVL_SNAPSHOT_H_
+
+// Snapshot (Save and Restore) of an AVL Tree as a Byte Stream.
+//
+// save_snapshot() writes the nodes of a tree (an avl_tree, or any class
+// with compatible iter, is_empty() and read_error() members) in ascending
+// key order.  Only a fixed-size payload for each node, provided by a
+// callback, is written.  load_snapshot() reads the stream, passes each
+// payload to a callback that returns the handle of a node holding it, and
+// builds the tree with build().  So loading does no key comparisons, and
+// uses O(max_depth) memory besides a block buffer provided by the caller.
+//
+// The header holds the number of nodes.  If the tree keeps subtree sizes
+// (it has a static store_size member that is true), the count is from
+// num_nodes(), and save_snapshot() traverses the nodes once.  Otherwise,
+// it traverses them once to count them, and again to write them.
+//
+// Stream format (all integers are little-endian):
+//
+// header:  magic (4 bytes) "AVLS", payload size (4 bytes), number of
+//   nodes (8 bytes), CRC-32 of the preceding 16 bytes (4 bytes).
+// blocks:  number of payloads in the block (4 bytes), the payloads, CRC-32
+//   of the preceding bytes of the block (4 bytes).
+//
+// The number of payloads in each block is determined by the size of the
+// buffer used to save the snapshot, so the stream can be loaded with a
+// buffer of a different size.
+//
+// The CRC-32 functions are in crc32.cpp, which must be linked in.
+
+#include <stdint.h>
+
+#include "crc32.h"
+
+namespace abstract_container
+{
+
+namespace impl
+{
+
+const uint32_t snapshot_magic = 0x534c5641;
+
+const unsigned snapshot_header_size = 20;
+
+inline void snapshot_put(unsigned char *p, uint64_t v, unsigned num_bytes)
+  {
+    for (unsigned i = 0; i < num_bytes; ++i)
+      {
+	p[i] = static_cast<unsigned char>(v & 0xff);
+	v >>= 8;
+      }
+  }
+
+inline uint64_t snapshot_get(const unsigned char *p, unsigned num_bytes)
+  {
+    uint64_t v = 0;
+
+    while (num_bytes--)
+      v = (v << 8) | p[num_bytes];
+
+    return(v);
+  }
+
+// value is true if tree_t has a static store_size member that is true.
+template <class tree_t>
+class snapshot_store_size
+  {
+  private:
+
+    typedef char yes[1];
+    typedef char no[2];
+
+    template <bool> struct sfinae { };
+
+    template <class t>
+    static yes & test(sfinae<t::store_size> *);
+
+    template <class t>
+    static no & test(...);
+
+    template <class t, bool has_mbr>
+    struct get { static const bool value = false; };
+
+    template <class t>
+    struct get<t, true> { static const bool value = t::store_size; };
+
+  public:
+
+    static const bool value =
+      get<tree_t, sizeof(test<tree_t>(0)) == sizeof(yes)>::value;
+  };
+
+// Sets num_nodes to the number of nodes in the tree.  Returns false if
+// there was a read error.
+template <bool store_size>
+struct snapshot_count
+  {
+    template <class tree_t>
+    static bool get(tree_t &tree, uint64_t &num_nodes)
+      {
+	typename tree_t::iter it;
+	typename tree_t::handle last;
+
+	num_nodes = 0;
+	if (tree.is_empty())
+	  return(true);
+
+	it.start_iter_greatest(tree);
+	last = *it;
+	for (it.start_iter_least(tree); ; it++)
+	  {
+	    if (tree.read_error())
+	      return(false);
+	    ++num_nodes;
+	    if (*it == last)
+	      return(true);
+	  }
+      }
+  };
+
+template <>
+struct snapshot_count<true>
+  {
+    template <class tree_t>
+    static bool get(tree_t &tree, uint64_t &num_nodes)
+      {
+	num_nodes = tree.num_nodes();
+	return(!tree.read_error());
+      }
+  };
+
+// State of the input stream of a snapshot being loaded.
+template <typename handle, class read_t, class load_t>
+struct snapshot_in
+  {
+    read_t &read;
+    load_t &load;
+    unsigned char *buf;
+    unsigned buf_size, payload_size;
+
+    // Offset in buf of the next payload, and the number of payloads left
+    // in the current block.
+    unsigned pos, block_left;
+
+    // Number of nodes not yet loaded.
+    uint64_t left;
+
+    bool error;
+
+    snapshot_in(
+      read_t &read_, load_t &load_, unsigned char *buf_,
+      unsigned buf_size_, unsigned payload_size_, uint64_t num_nodes)
+      : read(read_), load(load_), buf(buf_), buf_size(buf_size_),
+	payload_size(payload_size_), pos(0), block_left(0),
+	left(num_nodes), error(false)
+      { }
+
+    // Reads the next block into buf and checks it.  Returns false on
+    // failure.
+    bool next_block()
+      {
+	if (!read(buf, 4))
+	  return(false);
+
+	uint32_t n = uint32_t(snapshot_get(buf, 4));
+
+	if ((n == 0) || (n > left) ||
+	    (n > ((buf_size - 8) / payload_size)))
+	  return(false);
+
+	unsigned data_size = 4 + (n * payload_size);
+
+	if (!read(buf + 4, data_size - 4 + 4))
+	  return(false);
+
+	if (crc32(buf, data_size) != snapshot_get(buf + data_size, 4))
+	  return(false);
+
+	pos = 4;
+	block_left = n;
+
+	return(true);
+      }
+
+    // Loads the next node and returns its handle.  After a failure, the
+    // handle returned is not valid, and build() stops, because
+    // build_iter_error() returns true.
+    handle next()
+      {
+	if (error || (left == 0) || ((block_left == 0) && !next_block()))
+	  {
+	    error = true;
+	    return(handle());
+	  }
+
+	handle h = load(static_cast<const void *>(buf + pos));
+	pos += payload_size;
+	--block_left;
+	--left;
+
+	return(h);
+      }
+  };
+
+// Forward iterator over the nodes of a snapshot being loaded, for
+// build().
+template <typename handle, class in_t>
+class snapshot_iter
+  {
+  public:
+
+    snapshot_iter(in_t &in_) : in(&in_), h(), loaded(false) { }
+
+    handle operator * ()
+      {
+	if (!loaded)
+	  {
+	    h = in->next();
+	    loaded = true;
+	  }
+	return(h);
+      }
+
+    void operator ++ ()
+      {
+	**this;
+	loaded = false;
+      }
+
+    void operator ++ (int) { ++(*this); }
+
+  private:
+
+    in_t *in;
+    handle h;
+    bool loaded;
+
+    template <typename h_t, class i_t>
+    friend bool build_iter_error(const snapshot_iter<h_t, i_t> &it);
+  };
+
+template <typename handle, class in_t>
+inline bool build_iter_error(const snapshot_iter<handle, in_t> &it)
+  { return(it.in->error); }
+
+} // end namespace impl
+
+// Writes a snapshot of all the nodes in the tree.  buf points to a buffer
+// of buf_size bytes, which must be at least payload_size + 8.  Takes
+// these function objects (or function pointers) as parameters:
+//
+// void save(handle h, void *payload) -- stores the payload_size bytes of
+//   the payload for the node with handle h.
+// bool write(const void *data, unsigned num_bytes) -- writes the bytes
+//   to the stream, returning false on failure.
+//
+// Returns false if there was a write error, or a read error in the tree.
+//
+template <class tree_t, class save_t, class write_t>
+bool save_snapshot(
+  tree_t &tree, unsigned payload_size, save_t save, write_t write,
+  unsigned char *buf, unsigned buf_size)
+  {
+    if ((payload_size == 0) || (buf_size < (payload_size + 8)))
+      return(false);
+
+    typename tree_t::iter it;
+    uint64_t num_nodes;
+
+    // The count goes in the header, before the payloads.
+    if (!impl::snapshot_count<impl::snapshot_store_size<tree_t>::value>::get(
+	   tree, num_nodes))
+      return(false);
+
+    unsigned char hdr[impl::snapshot_header_size];
+
+    impl::snapshot_put(hdr, impl::snapshot_magic, 4);
+    impl::snapshot_put(hdr + 4, payload_size, 4);
+    impl::snapshot_put(hdr + 8, num_nodes, 8);
+    impl::snapshot_put(hdr + 16, crc32(hdr, 16), 4);
+    if (!write(static_cast<const void *>(hdr), impl::snapshot_header_size))
+      return(false);
+
+    unsigned per_block = (buf_size - 8) / payload_size;
+    uint64_t left = num_nodes;
+
+    if (left)
+      it.start_iter_least(tree);
+
+    while (left)
+      {
+	unsigned n = left < per_block ? unsigned(left) : per_block;
+	unsigned pos = 4;
+
+	impl::snapshot_put(buf, n, 4);
+	for (unsigned i = 0; i < n; ++i)
+	  {
+	    save(*it, static_cast<void *>(buf + pos));
+	    pos += payload_size;
+	    it++;
+	  }
+	if (tree.read_error())
+	  return(false);
+	impl::snapshot_put(buf + pos, crc32(buf, pos), 4);
+	if (!write(static_cast<const void *>(buf), pos + 4))
+	  return(false);
+
+	left -= n;
+      }
+
+    return(true);
+  }
+
+// Replaces the contents of the tree with the nodes in a snapshot.  buf
+// points to a buffer of buf_size bytes, which must be large enough to
+// hold the largest block in the stream (so at least payload_size + 8).
+// Takes these function objects (or function pointers) as parameters:
+//
+// bool read(void *data, unsigned num_bytes) -- reads exactly num_bytes
+//   bytes from the stream, returning false on failure.
+// handle load(const void *payload) -- returns the handle of a node (not
+//   in any tree) holding the payload_size bytes of payload.
+//
+// Returns false if there was a read error, the stream was not a valid
+// snapshot with the given payload size, or a CRC did not match.  In this
+// case, the tree is left empty, and the links in any nodes returned by
+// load() are undefined.
+//
+template <class tree_t, class read_t, class load_t>
+bool load_snapshot(
+  tree_t &tree, unsigned payload_size, read_t read, load_t load,
+  unsigned char *buf, unsigned buf_size)
+  {
+    typedef typename tree_t::handle handle;
+    typedef impl::snapshot_in<handle, read_t, load_t> in_t;
+
+    tree.purge();
+
+    if ((payload_size == 0) || (buf_size < (payload_size + 8)))
+      return(false);
+
+    unsigned char hdr[impl::snapshot_header_size];
+
+    if (!read(static_cast<void *>(hdr), impl::snapshot_header_size) ||
+	(impl::snapshot_get(hdr, 4) != impl::snapshot_magic) ||
+	(impl::snapshot_get(hdr + 4, 4) != payload_size) ||
+	(impl::snapshot_get(hdr + 16, 4) != crc32(hdr, 16)))
+      return(false);
+
+    uint64_t num_nodes = impl::snapshot_get(hdr + 8, 8);
+
+    if (num_nodes != uint64_t(typename tree_t::size(num_nodes)))
+      return(false);
+
+    if (num_nodes == 0)
+      return(true);
+
+    in_t in(read, load, buf, buf_size, payload_size, num_nodes);
+
+    impl::snapshot_iter<handle, in_t> it(in);
+
+    if (!tree.build(it, typename tree_t::size(num_nodes)) || in.error ||
+	(in.block_left != 0))
+      {
+	tree.purge();
+	return(false);
+      }
+
+    return(true);
+  }
+
+} // end namespace abstract_container
+
+#endif /* Include once */
@@ -34,6 +34,12 @@ SOFTWARE.
 #include <bitset>
 #include <utility>
 
+#include <stdint.h>
+
+#if __cplusplus >= 201100
+#include <thread>
+#endif
+
 namespace abstract_container
 {
 
@@ -56,6 +62,349 @@ enum search_type
 
 #endif
 
+namespace impl
+{
+
+// Defines the class template avl_has_MBR, whose static member 'value' is
+// true if the abstractor class has a (non-overloaded) member named MBR.
+// This is used to detect optional abstractor capabilities.
+//
+#define ABSTRACT_CONTAINER_AVL_HAS_MBR(MBR) \
+template <class abstractor> \
+class avl_has_##MBR \
+  { \
+  private: \
+    typedef char yes[1]; \
+    typedef char no[2]; \
+    template <unsigned> struct sfinae { }; \
+    template <class a> static yes & test(sfinae<sizeof(&a::MBR)> *); \
+    template <class a> static no & test(...); \
+  public: \
+    static const bool value = sizeof(test<abstractor>(0)) == sizeof(yes); \
+  };
+
+// Unsigned integral type with at least num_bits bits, for word_bset.
+// size_class is 0 for up to 32 bits, 1 for up to 64 bits.  (There is
+// no type for more than 64 bits.)
+template <unsigned num_bits,
+	  unsigned size_class = (num_bits > 32) + (num_bits > 64)>
+struct avl_bset_word;
+
+template <unsigned num_bits>
+struct avl_bset_word<num_bits, 0> { typedef uint32_t type; };
+
+template <unsigned num_bits>
+struct avl_bset_word<num_bits, 1> { typedef uint64_t type; };
+
+ABSTRACT_CONTAINER_AVL_HAS_MBR(get_size)
+
+// Maintenance of subtree sizes, for abstractors that store them.
+//
+template <bool store_size>
+struct avl_size
+  {
+    template <class abs_t, class handle>
+    static void update(abs_t &, handle) { }
+  };
+
+template <>
+struct avl_size<true>
+  {
+    template <class abs_t, class handle>
+    static typename abs_t::size get(abs_t &abs, handle h)
+      { return(h == abs.null() ? 0 : abs.get_size(h)); }
+
+    template <class abs_t, class handle>
+    static void update(abs_t &abs, handle h)
+      {
+	abs.set_size(
+	  h, 1 + get(abs, abs.get_less(h, true)) +
+	       get(abs, abs.get_greater(h, true)));
+      }
+  };
+
+ABSTRACT_CONTAINER_AVL_HAS_MBR(get_max_end)
+
+// Maintenance of the greatest interval end in each subtree, for
+// abstractors that store them.
+//
+template <bool store_max_end>
+struct avl_max_end
+  {
+    template <class abs_t, class handle>
+    static void update(abs_t &, handle) { }
+  };
+
+template <>
+struct avl_max_end<true>
+  {
+    template <class abs_t, class handle>
+    static void update(abs_t &abs, handle h)
+      {
+	typename abs_t::key e = abs.get_end(h);
+	handle ch = abs.get_less(h, true);
+
+	if ((ch != abs.null()) &&
+	    (abs.compare_key_key(abs.get_max_end(ch), e) > 0))
+	  e = abs.get_max_end(ch);
+	ch = abs.get_greater(h, true);
+	if ((ch != abs.null()) &&
+	    (abs.compare_key_key(abs.get_max_end(ch), e) > 0))
+	  e = abs.get_max_end(ch);
+
+	abs.set_max_end(h, e);
+      }
+  };
+
+ABSTRACT_CONTAINER_AVL_HAS_MBR(get_agg)
+
+// Maintenance of subtree aggregates, for abstractors that store them.
+// agg is a placeholder type if they are not stored.
+//
+template <class abs_t, bool store_agg>
+struct avl_agg
+  {
+    typedef char agg;
+
+    template <class handle>
+    static void update(abs_t &, handle) { }
+  };
+
+template <class abs_t>
+struct avl_agg<abs_t, true>
+  {
+    typedef typename abs_t::agg agg;
+
+    template <class handle>
+    static void update(abs_t &abs, handle h)
+      {
+	agg a = abs.get_node_agg(h);
+	handle ch = abs.get_less(h, true);
+
+	if (ch != abs.null())
+	  a = abs.combine(abs.get_agg(ch), a);
+	ch = abs.get_greater(h, true);
+	if (ch != abs.null())
+	  a = abs.combine(a, abs.get_agg(ch));
+
+	abs.set_agg(h, a);
+      }
+  };
+
+// Handles of the nodes in a search path, for insertion or substitution.
+// They are only kept if the stored values of the nodes in the path must
+// be updated afterward.
+//
+template <class handle, unsigned max_depth, bool keep>
+struct avl_path
+  {
+    void set(unsigned, handle) { }
+  };
+
+template <class handle, unsigned max_depth>
+struct avl_path<handle, max_depth, true>
+  {
+    handle h[max_depth];
+
+    void set(unsigned depth, handle h_) { h[depth] = h_; }
+  };
+
+ABSTRACT_CONTAINER_AVL_HAS_MBR(get_key_prefix)
+
+// The prefix of a key to be compared to the keys of the nodes in a
+// search path, if the abstractor provides key prefixes.  So the prefix
+// of the key is only computed once, and the prefixes are compared
+// first.
+//
+template <class abs_t, bool has_prefix>
+class avl_key_prefix
+  {
+  public:
+
+    typedef typename abs_t::key key;
+    typedef typename abs_t::handle handle;
+
+    void set(abs_t &, key) { }
+
+    int cmp(abs_t &abs, key k, handle h) const
+      { return(abs.compare_key_node(k, h)); }
+  };
+
+template <class abs_t>
+class avl_key_prefix<abs_t, true>
+  {
+  public:
+
+    typedef typename abs_t::key key;
+    typedef typename abs_t::handle handle;
+
+    void set(abs_t &abs, key k) { p = abs.get_key_prefix(k); }
+
+    int cmp(abs_t &abs, key k, handle h) const
+      {
+	typename abs_t::key_prefix np = abs.get_prefix(h);
+
+	if (p != np)
+	  return(p < np ? -1 : 1);
+
+	return(abs.compare_key_node(k, h));
+      }
+
+  private:
+
+    typename abs_t::key_prefix p;
+  };
+
+// A key, with its prefix.
+//
+template <class abs_t, bool has_prefix>
+class avl_search_key
+  {
+  public:
+
+    typedef typename abs_t::key key;
+    typedef typename abs_t::handle handle;
+
+    avl_search_key(abs_t &abs, key k_) : k(k_) { kp.set(abs, k_); }
+
+    int cmp(abs_t &abs, handle h) const { return(kp.cmp(abs, k, h)); }
+
+  private:
+
+    key k;
+    avl_key_prefix<abs_t, has_prefix> kp;
+  };
+
+// Same as avl_search_key, but for the key of a node (being inserted).
+//
+template <class abs_t, bool has_prefix>
+class avl_search_node
+  {
+  public:
+
+    typedef typename abs_t::handle handle;
+
+    avl_search_node(abs_t &, handle h_) : h(h_) { }
+
+    int cmp(abs_t &abs, handle h2) const
+      { return(abs.compare_node_node(h, h2)); }
+
+  private:
+
+    handle h;
+  };
+
+template <class abs_t>
+class avl_search_node<abs_t, true>
+  {
+  public:
+
+    typedef typename abs_t::handle handle;
+
+    avl_search_node(abs_t &abs, handle h_) : h(h_), p(abs.get_prefix(h_))
+      { }
+
+    int cmp(abs_t &abs, handle h2) const
+      {
+	typename abs_t::key_prefix p2 = abs.get_prefix(h2);
+
+	if (p != p2)
+	  return(p < p2 ? -1 : 1);
+
+	return(abs.compare_node_node(h, h2));
+      }
+
+  private:
+
+    handle h;
+    typename abs_t::key_prefix p;
+  };
+
+ABSTRACT_CONTAINER_AVL_HAS_MBR(get_parent)
+
+// Maintenance of parent links, for abstractors that store them.
+//
+template <bool store_parent>
+struct avl_parent
+  {
+    template <class abs_t, class handle>
+    static void link(abs_t &, handle, bool) { }
+
+    template <class abs_t, class handle>
+    static void set_root(abs_t &, handle) { }
+  };
+
+template <>
+struct avl_parent<true>
+  {
+    // Make h the parent of its greater child (if greater is true) or
+    // its less child.  The child is read back from h, so that it will
+    // be accessed.
+    template <class abs_t, class handle>
+    static void link(abs_t &abs, handle h, bool greater)
+      {
+	handle ch = greater ? abs.get_greater(h, true) : abs.get_less(h, true);
+
+	if (ch != abs.null())
+	  abs.set_parent(ch, h);
+      }
+
+    template <class abs_t, class handle>
+    static void set_root(abs_t &abs, handle h)
+      {
+	if (h != abs.null())
+	  abs.set_parent(h, abs.null());
+      }
+  };
+
+ABSTRACT_CONTAINER_AVL_HAS_MBR(prefetch)
+
+// Prefetching of nodes, for abstractors that can do it.
+//
+template <bool can_prefetch>
+struct avl_prefetch
+  {
+    template <class abs_t, class handle>
+    static void fetch(abs_t &, handle) { }
+  };
+
+template <>
+struct avl_prefetch<true>
+  {
+    template <class abs_t, class handle>
+    static void fetch(abs_t &abs, handle h) { abs.prefetch(h); }
+  };
+
+} // end namespace impl
+
+// Returns true if the sequence of nodes that the iterator p refers to,
+// passed to build(), has failed (for example, because it is being read
+// from a file).  An iterator type that can fail overloads this function,
+// in its own namespace, so it is found by argument-dependent lookup.
+// build() then stops, and returns false, rather than using the handle
+// from the failed iterator.
+//
+template <typename fwd_iter>
+inline bool build_iter_error(const fwd_iter &) { return(false); }
+
+// Returns the first 8 characters of the nul-terminated string s (or all
+// of them, followed by zeros, if there are fewer), packed into an integer
+// with the first character in the most significant byte.  Comparing
+// these values gives the same order as strcmp(), for strings that differ
+// in their first 8 characters.  So this can be used as the key prefix for
+// string keys (see below).
+//
+inline uint64_t str_key_prefix(const char *s)
+  {
+    uint64_t p = 0;
+    unsigned i = 0;
+
+    for ( ; (i < 8) && s[i]; ++i)
+      p = (p << 8) | static_cast<unsigned char>(s[i]);
+
+    return(i ? p << (8 * (8 - i)) : 0);
+  }
+
 // The base_avl_tree template is the same as the avl_tree template,
 // except for one additional template parameter: bset.  Here is the
 // reference class for bset.
@@ -84,6 +433,101 @@ enum search_type
 //     void reset();
 //   };
 //
+// Optionally, the abstractor may store the number of nodes in the subtree
+// whose root is each node, by having these member functions:
+//
+//   size get_size(handle h);
+//   void set_size(handle h, size s);
+//
+// In this case the tree keeps the sizes up to date, and the select(),
+// rank(), count_range() and num_nodes() member functions can be used.
+//
+// Optionally, the abstractor may store the handle of the parent of each
+// node, by having these member functions:
+//
+//   // Returns the (accessed) handle of the parent of the node, or null
+//   // if the node is the root.
+//   handle get_parent(handle h);
+//   void set_parent(handle h, handle parent);
+//
+// In this case the tree keeps the parent links up to date, and the
+// remove_node() member function and the parent_iter iterator class can
+// be used.
+//
+// Optionally, the abstractor may have this member function:
+//
+//   // Start loading the node into the cache (for example, with
+//   // __builtin_prefetch()), without waiting for it.
+//   void prefetch(handle h);
+//
+// In this case search_batch() calls it for each node, some time before
+// comparing the node's key.
+//
+// Optionally, each node may hold an interval, whose start is the node's
+// key, by the abstractor having these member functions:
+//
+//   // Returns the end of the node's interval.  The interval contains the
+//   // keys that are greater than or equal to the start, and less than the
+//   // end.
+//   key get_end(handle h);
+//
+//   // Get or set the greatest end of the intervals of the nodes in the
+//   // subtree whose root is the node.
+//   key get_max_end(handle h);
+//   void set_max_end(handle h, key e);
+//
+//   int compare_key_key(key k1, key k2);
+//
+// In this case the tree keeps the greatest ends up to date, and the
+// overlap_first() and overlap_next() member functions of iter can be
+// used to find the intervals that overlap a given key or interval.  If
+// the end of the interval of a node in the tree is changed, the node must
+// be substituted (possibly for itself) with subst() (which recomputes the
+// greatest ends).
+//
+// Optionally, the abstractor may store an aggregate (such as a sum,
+// minimum or maximum) of values of the nodes in the subtree whose root is
+// each node, by having these members:
+//
+//   // The aggregate type.  combine() must be associative (but need not
+//   // be commutative), with agg_identity() as its identity.  The first
+//   // parameter of combine() is the aggregate of nodes with lesser keys.
+//   typedef ... agg;
+//   agg agg_identity();
+//   agg combine(agg a1, agg a2);
+//
+//   // Returns the aggregate of the node by itself.
+//   agg get_node_agg(handle h);
+//
+//   // Get or set the aggregate of the subtree whose root is the node.
+//   agg get_agg(handle h);
+//   void set_agg(handle h, agg a);
+//
+// In this case the tree keeps the aggregates up to date, and the
+// aggregate() member function can be used.  If the value of a node in
+// the tree changes, the node must be substituted for itself with subst()
+// (which recomputes the aggregates).
+//
+// Optionally, the abstractor may provide a prefix of each key, which is
+// cheaper to compare than the whole key (for example, because the key is
+// a string stored outside the node), by having these members:
+//
+//   // A type (such as an unsigned integer) compared with < and !=.
+//   typedef ... key_prefix;
+//
+//   // If the prefix of k1 is less than the prefix of k2, k1 must be
+//   // less than k2.  This is called once for each search (not for each
+//   // comparison).
+//   key_prefix get_key_prefix(key k);
+//
+//   // Returns the prefix of the key of the node (typically, stored in
+//   // the node).
+//   key_prefix get_prefix(handle h);
+//
+// In this case, the tree compares prefixes first, and only calls
+// compare_key_node() or compare_node_node() if they are equal.  See
+// str_key_prefix() above.
+//
 template <class abstractor, unsigned max_depth, class bset>
 class base_avl_tree
   {
@@ -93,18 +537,194 @@ class base_avl_tree
     typedef typename abstractor::handle handle;
     typedef typename abstractor::size size;
 
+    static const bool store_agg = impl::avl_has_get_agg<abstractor>::value;
+
+    // True if the abstractor stores subtree sizes, so num_nodes() can be
+    // used.
+    static const bool store_size = impl::avl_has_get_size<abstractor>::value;
+
+    typedef typename impl::avl_agg<abstractor, store_agg>::agg agg;
+
     inline handle insert(handle h);
 
     inline handle search(key k, search_type st = EQUAL);
+
+    // Does the n searches search(keys[i], st), putting the results in
+    // out[i].  The searches are done in groups, advancing every search
+    // in a group one level in the tree at a time.  So the load of a node
+    // for one search can overlap the comparisons of the others (more so
+    // if the abstractor has a prefetch() member function).  Returns false
+    // if there was a read error, in which case all of out is null.
+    inline bool search_batch(
+      const key *keys, size n, handle *out, search_type st = EQUAL);
+
     inline handle search_least();
     inline handle search_greatest();
 
     inline handle remove(key k);
 
+    // Removes the node with handle h, which must be in the tree, without
+    // doing any key comparisons.  Requires the abstractor to store parent
+    // links.  Returns h, or null if there was a read error.
+    inline handle remove_node(handle h);
+
     inline handle subst(handle new_node);
 
+    // Splits the tree in two, in O(log n) time.  The nodes whose keys
+    // would satisfy a search with the given key and search type (for
+    // example, all nodes with keys less than or equal to k for LESS_EQUAL)
+    // remain in this tree.  All other nodes are moved into 'rest'.  Any
+    // nodes previously in 'rest' are dropped from it, as with purge().
+    // Returns false if there was a read error.
+    //
+    // For split() and join(), the abstractor instances of all the trees
+    // involved must be able to access the nodes of any of them.
+    //
+    inline bool split(key k, search_type st, base_avl_tree &rest);
+
+    // Makes this tree contain all the nodes of tree_lt and tree_gt, in
+    // O(log n) time.  Every key in tree_lt must be less than every key
+    // in tree_gt.  tree_lt and tree_gt are left empty, unless one of them
+    // is this tree.  Any nodes previously in this tree (and not in tree_lt
+    // or tree_gt) are dropped from it.  Returns false if there was a
+    // read error.
+    //
+    inline bool join(base_avl_tree &tree_lt, base_avl_tree &tree_gt);
+
+    // Order statistics.  These require the abstractor to store subtree
+    // sizes.  All take O(log n) time.
+
+    // Returns the handle of the node with the (0-based) kth least key, or
+    // null if k is not less than the number of nodes in the tree.
+    inline handle select(size k);
+
+    // Returns the number of nodes with keys that would satisfy a search
+    // with the given key and search type (for example, the number of
+    // nodes with keys less than k for LESS).
+    inline size rank(key k, search_type st = LESS);
+
+    // Returns the number of nodes with keys greater than or equal to lo
+    // and less than hi.
+    size count_range(key lo, key hi)
+      {
+	size n_hi = rank(hi), n_lo = rank(lo);
+
+	return(n_hi > n_lo ? n_hi - n_lo : 0);
+      }
+
+    size num_nodes() { return(get_size(abs.root)); }
+
+    // Returns the aggregate (in key order) of the nodes with keys that
+    // would satisfy a search with key lo and search type st_lo (GREATER
+    // or GREATER_EQUAL), and also a search with key hi and search type
+    // st_hi (LESS or LESS_EQUAL).  Requires the abstractor to store
+    // aggregates.  Takes O(log n) time.  Returns the identity if there are
+    // no such nodes, or there was a read error.
+    agg aggregate(key lo, search_type st_lo, key hi, search_type st_hi)
+      {
+	handle h = abs.root, ch;
+	agg lt_agg = abs.agg_identity(), gt_agg = lt_agg;
+	search_key sk_lo(abs, lo), sk_hi(abs, hi);
+
+	// Find the highest node in the range.  The other nodes of the range
+	// in its less subtree hang off the path from it to lo, and the ones
+	// in its greater subtree hang off the path from it to hi.
+	for ( ; ; )
+	  {
+	    if (h == null())
+	      return(lt_agg);
+	    if (!above_lo(h, sk_lo, st_lo))
+	      h = get_gt(h);
+	    else if (!below_hi(h, sk_hi, st_hi))
+	      h = get_lt(h);
+	    else
+	      break;
+	    if (read_error())
+	      return(abs.agg_identity());
+	  }
+
+	for (ch = get_lt(h); ch != null(); )
+	  {
+	    if (above_lo(ch, sk_lo, st_lo))
+	      {
+		agg a = abs.get_node_agg(ch);
+
+		if (get_gt(ch) != null())
+		  a = abs.combine(a, abs.get_agg(get_gt(ch)));
+		lt_agg = abs.combine(a, lt_agg);
+		ch = get_lt(ch);
+	      }
+	    else
+	      ch = get_gt(ch);
+	    if (read_error())
+	      return(abs.agg_identity());
+	  }
+
+	for (ch = get_gt(h); ch != null(); )
+	  {
+	    if (below_hi(ch, sk_hi, st_hi))
+	      {
+		if (get_lt(ch) != null())
+		  gt_agg = abs.combine(gt_agg, abs.get_agg(get_lt(ch)));
+		gt_agg = abs.combine(gt_agg, abs.get_node_agg(ch));
+		ch = get_gt(ch);
+	      }
+	    else
+	      ch = get_lt(ch);
+	    if (read_error())
+	      return(abs.agg_identity());
+	  }
+
+	return(abs.combine(abs.combine(lt_agg, abs.get_node_agg(h)), gt_agg));
+      }
+
     void purge() { abs.root = null(); }
 
+    // Empties the tree, passing the handle of each node that was in it to
+    // discard().  The links of a node are not accessed after the node is
+    // passed to discard(), so discard() may free or reuse it.  Takes
+    // O(n) time and O(1) extra space.  Rather than keeping a path, each
+    // node with a less child is rotated to the greater side of that
+    // child, so the tree is unrolled into a list linked through the
+    // greater links as it is consumed.  Returns false if there was a
+    // read error, in which case some nodes may not have been passed to
+    // discard().
+    template <class discard_t>
+    bool purge(discard_t discard)
+      {
+	handle h = abs.root, child;
+
+	abs.root = null();
+
+	while (h != null())
+	  {
+	    child = get_lt(h);
+	    if (read_error())
+	      return(false);
+	    if (child == null())
+	      {
+		child = get_gt(h);
+		if (read_error())
+		  return(false);
+		discard(h);
+		h = child;
+	      }
+	    else
+	      {
+		// Rotate child up into the position of h.  Parent links
+		// and balance factors are not maintained, since all the
+		// nodes are being discarded.
+		abs.set_less(h, get_gt(child, false));
+		if (read_error())
+		  return(false);
+		abs.set_greater(child, h);
+		h = child;
+	      }
+	  }
+
+	return(true);
+      }
+
     bool is_empty() { return(abs.root == null()); }
 
     bool read_error() { return(abs.read_error()); }
@@ -152,6 +772,7 @@ class base_avl_tree
 	    int cmp, target_cmp;
 	    handle h = tree_->abs.root;
 	    unsigned d = 0;
+	    search_key sk(tree_->abs, k);
 
 	    depth = unsigned(~0);
 
@@ -171,7 +792,7 @@ class base_avl_tree
 
 	    for ( ; ; )
 	      {
-		cmp = cmp_k_n(k, h);
+		cmp = tree_->cmp_k_n(sk, h);
 		if (cmp == 0)
 		  {
 		    if (st & EQUAL)
@@ -247,6 +868,28 @@ class base_avl_tree
 	      }
 	  }
 
+	// The overlap functions require the abstractor to store interval
+	// ends.  overlap_first() starts the iterator at the node with the
+	// least key whose interval overlaps the interval [lo, hi) (that is,
+	// the start of the node's interval is less than hi, and its end is
+	// greater than lo).  overlap_next() moves the iterator to the next
+	// node (in key order) whose interval overlaps the same interval.
+	// The iterator is invalid if there is no such node.  Finding all k
+	// overlapping intervals takes O(min(n, (k + 1) log n)) time.
+	//
+	// The overloads with the single key p find the intervals that
+	// contain p.
+
+	void overlap_first(base_avl_tree &tree, key lo, key hi)
+	  { overlap_start(tree, lo, hi, false); }
+
+	void overlap_first(base_avl_tree &tree, key p)
+	  { overlap_start(tree, p, p, true); }
+
+	void overlap_next(key lo, key hi) { overlap_step(lo, hi, false); }
+
+	void overlap_next(key p) { overlap_step(p, p, true); }
+
 	handle operator * ()
 	  {
 	    if (depth == unsigned(~0))
@@ -341,6 +984,8 @@ class base_avl_tree
 
       protected:
 
+	friend class base_avl_tree;
+
 	// Tree being iterated over.
 	base_avl_tree *tree_;
 
@@ -356,52 +1001,925 @@ class base_avl_tree
 	// Handles of nodes in path from root to current node (returned by *).
 	handle path_h[max_depth - 1];
 
-	int cmp_k_n(key k, handle h)
-	  { return(tree_->abs.compare_key_node(k, h)); }
-	int cmp_n_n(handle h1, handle h2)
-	  { return(tree_->abs.compare_node_node(h1, h2)); }
+	int cmp_k_n(key k, handle h) { return(tree_->cmp_k_n(k, h)); }
 	handle get_lt(handle h)
 	  { return(tree_->abs.get_less(h, true)); }
 	handle get_gt(handle h)
 	  { return(tree_->abs.get_greater(h, true)); }
 	handle null() { return(tree_->abs.null()); }
 
-      };
+	// Handle of node at (0-based) depth d in path.
+	handle path(unsigned d)
+	  { return(d == 0 ? tree_->abs.root : path_h[d - 1]); }
 
-    template<typename fwd_iter>
-    bool build(fwd_iter p, size num_nodes)
-      {
-	// NOTE:  GCC allows me to define this outside the class definition
-	// using the following syntax:
-	//
-	// template <class abstractor, unsigned max_depth, class bset>
-	// template<typename fwd_iter>
-	// inline void base_avl_tree<abstractor, max_depth, bset>::build(
-	//   fwd_iter p, size num_nodes)
-	//   {
-	//     ...
-	//   }
-	//
-	// but Visual C++ .NET won't accept it.  Is this a GCC extension?
+	// True if the end of the interval of the node h is greater than k.
+	bool end_gt(handle h, key k)
+	  {
+	    return(
+	      tree_->abs.compare_key_key(tree_->abs.get_end(h), k) > 0);
+	  }
 
-	if (num_nodes == 0)
+	// True if the greatest interval end in the subtree whose root is h
+	// is greater than k.  False if h is null.
+	bool max_end_gt(handle h, key k)
 	  {
-	    abs.root = null();
-	    return(true);
+	    return((h != null()) &&
+		   (tree_->abs.compare_key_key(
+		      tree_->abs.get_max_end(h), k) > 0));
 	  }
 
-	// Gives path to subtree being built.  If branch[N] is false, branch
-	// less from the node at depth N, if true branch greater.
+	// The node at depth is the root of a subtree with an interval
+	// whose end is greater than lo.  Moves down to the node with the
+	// least key with such an interval.
+	void overlap_descend(key lo)
+	  {
+	    handle h = **this, ch;
+
+	    for ( ; ; )
+	      {
+		ch = get_lt(h);
+		if (read_error())
+		  {
+		    depth = unsigned(~0);
+		    return;
+		  }
+		if (max_end_gt(ch, lo))
+		  branch[depth] = false;
+		else if (end_gt(h, lo))
+		  return;
+		else
+		  {
+		    ch = get_gt(h);
+		    if (read_error())
+		      {
+			depth = unsigned(~0);
+			return;
+		      }
+		    branch[depth] = true;
+		  }
+		path_h[depth++] = ch;
+		h = ch;
+	      }
+	  }
+
+	// Makes the iterator invalid if the start of the interval of the
+	// current node is not less than hi (or equal to hi, if hi_closed
+	// is true).
+	void overlap_check_hi(key hi, bool hi_closed)
+	  {
+	    if (depth != unsigned(~0))
+	      {
+		int cmp = cmp_k_n(hi, **this);
+
+		if ((cmp < 0) || ((cmp == 0) && !hi_closed))
+		  depth = unsigned(~0);
+	      }
+	  }
+
+	void overlap_start(base_avl_tree &tree, key lo, key hi, bool hi_closed)
+	  {
+	    tree_ = &tree;
+
+	    depth = unsigned(~0);
+
+	    if (max_end_gt(tree_->abs.root, lo))
+	      {
+		depth = 0;
+		overlap_descend(lo);
+		overlap_check_hi(hi, hi_closed);
+	      }
+	  }
+
+	void overlap_step(key lo, key hi, bool hi_closed)
+	  {
+	    if (depth == unsigned(~0))
+	      return;
+
+	    handle h = **this, ch;
+
+	    for ( ; ; )
+	      {
+		ch = get_gt(h);
+		if (read_error())
+		  {
+		    depth = unsigned(~0);
+		    return;
+		  }
+		if (max_end_gt(ch, lo))
+		  {
+		    branch[depth] = true;
+		    path_h[depth++] = ch;
+		    overlap_descend(lo);
+		    break;
+		  }
+
+		// Climb to the nearest node whose less subtree the
+		// current node is in.
+		do
+		  {
+		    if (depth == 0)
+		      {
+			depth = unsigned(~0);
+			return;
+		      }
+		    depth--;
+		  }
+		while (branch[depth]);
+
+		h = **this;
+		if (end_gt(h, lo))
+		  break;
+	      }
+
+	    overlap_check_hi(hi, hi_closed);
+	  }
+
+      };
+
+    // Iterator for use when the abstractor stores parent links.  Instead
+    // of a path from the root, it only holds the handle of the current
+    // node.  Unlike iter, it is not invalidated by the insertion or
+    // removal of other nodes.  It is only invalidated by the removal of
+    // the current node.
+    class parent_iter
+      {
+      public:
+
+	parent_iter() : tree_(0), cur() { }
+
+	void start_iter(base_avl_tree &tree, key k, search_type st = EQUAL)
+	  {
+	    tree_ = &tree;
+	    cur = tree.search(k, st);
+	  }
+
+	// Start the iterator at the node with handle h, which must be
+	// in the tree.
+	void start_iter_node(base_avl_tree &tree, handle h)
+	  {
+	    tree_ = &tree;
+	    cur = h;
+	  }
+
+	void start_iter_least(base_avl_tree &tree)
+	  {
+	    tree_ = &tree;
+	    cur = tree.search_least();
+	  }
+
+	void start_iter_greatest(base_avl_tree &tree)
+	  {
+	    tree_ = &tree;
+	    cur = tree.search_greatest();
+	  }
+
+	handle operator * () { return(cur); }
+
+	void operator ++ () { step(true); }
+
+	void operator -- () { step(false); }
+
+	void operator ++ (int) { step(true); }
+
+	void operator -- (int) { step(false); }
+
+	bool read_error() { return(tree_->read_error()); }
+
+      protected:
+
+	// Tree being iterated over.
+	base_avl_tree *tree_;
+
+	// Handle of current node, null if iterator is invalid.
+	handle cur;
+
+	// Move to the next greater node if greater is true, otherwise to
+	// the next less node.
+	void step(bool greater)
+	  {
+	    if (cur == tree_->null())
+	      return;
+
+	    handle h = tree_->get_ch(cur, greater);
+
+	    if (read_error())
+	      ;
+	    else if (h != tree_->null())
+	      // Go to the nearest node in that subtree.
+	      do
+		{
+		  cur = h;
+		  h = tree_->get_ch(cur, !greater);
+		}
+	      while ((h != tree_->null()) && !read_error());
+	    else
+	      // Go up to the first ancestor that has the current node in
+	      // the subtree on the other side.
+	      do
+		{
+		  h = cur;
+		  cur = tree_->abs.get_parent(h);
+		}
+	      while ((cur != tree_->null()) && !read_error() &&
+		     (tree_->get_ch(cur, greater) == h));
+
+	    if (read_error())
+	      cur = tree_->null();
+	  }
+
+      };
+
+    // Finger operations.  These start from the node an iterator refers
+    // to, rather than from the root.  They climb the iterator's path only
+    // as far as needed to reach a subtree that must contain the given
+    // key, then descend from there.  So, if each key is close to the key
+    // used in the previous call (for example, when inserting keys in
+    // ascending order), each call takes amortized O(1) key comparisons.
+    // But each call still takes O(log n) time, because the climb, and
+    // the search for the node to rebalance after an insert, step
+    // through the iterator's path without comparing keys (and, if the
+    // abstractor stores subtree sizes or aggregates, insert updates
+    // every node in the path).  If the iterator is invalid, or refers to
+    // a different tree, these start from the root.
+
+    // Same as insert(h), except that the iterator 'hint' is used as the
+    // starting point.  If the node is inserted, 'hint' is left referring
+    // to it, otherwise to the node already in the tree with the same key.
+    // Other iterators for the tree are invalidated.
+    inline handle insert(handle h, iter &hint);
+
+    // Returns the handle of the node with key k, or null if there is no
+    // such node, using the iterator 'hint' as the starting point.  If
+    // the node is found, 'hint' is left referring to it.  Otherwise
+    // 'hint' is left referring to the last node compared to k, which has
+    // the next less or next greater key than k.
+    inline handle search(key k, iter &hint);
+
+    template<typename fwd_iter>
+    bool build(fwd_iter p, size num_nodes)
+      {
+	if (num_nodes == 0)
+	  {
+	    abs.root = null();
+	    return(true);
+	  }
+
+	handle h = build_seq(p, num_nodes);
+	if (read_error() || (h == null()))
+	  return(false);
+
+	set_root(h);
+
+	return(true);
+      }
+
+    // Same as build(), but for a random-access iterator p, and the
+    // disjoint subtrees can be built concurrently.  The resulting tree
+    // has exactly the same shape (and balance factors) as the one build()
+    // produces.  If num_threads is greater than one, the tree is split
+    // into subtrees that are built on that many threads (in which case
+    // the abstractor must be able to be called concurrently for distinct
+    // nodes).  Returns false if there was a read error, or p failed (see
+    // build_iter_error()), in which case the root is not changed.
+    template<typename rand_iter>
+    bool parallel_build(rand_iter p, size num_nodes, unsigned num_threads = 1)
+      {
+	if (num_nodes == 0)
+	  {
+	    abs.root = null();
+	    return(true);
+	  }
+
+	handle h = build_sub(p, num_nodes, num_threads);
+	if (read_error() || (h == null()))
+	  return(false);
+
+	set_root(h);
+
+	return(true);
+      }
+
+    // Bulk set operations.  Each takes time O(m log(n/m + 1)), where m
+    // is the number of nodes in the smaller tree, and n the number in the
+    // larger.  The handle of each node dropped from either tree is passed
+    // to discard(), so its resources can be released.  If num_threads is
+    // greater than one, recursive subproblems are split across that many
+    // threads (in which case discard() and the abstractor must be able to
+    // be called concurrently for distinct nodes).  Returns false if there
+    // was a read error.  As for join(), the abstractor instances of both
+    // trees must be able to access the nodes of either of them.
+
+    // This tree becomes the union of itself and 'other', and 'other' is
+    // left empty.  For each node in 'other' with the same key as a node
+    // in this tree, the node in 'other' is dropped.
+    template <class discard_t>
+    bool set_union(
+      base_avl_tree &other, discard_t discard, unsigned num_threads = 1)
+      { return(set_op(union_op, other, discard, num_threads)); }
+
+    // Nodes in this tree are dropped unless 'other' contains a node with
+    // the same key.  'other' is unchanged.
+    template <class discard_t>
+    bool set_intersection(
+      base_avl_tree &other, discard_t discard, unsigned num_threads = 1)
+      { return(set_op(intersection_op, other, discard, num_threads)); }
+
+    // Nodes in this tree are dropped if 'other' contains a node with the
+    // same key.  'other' is unchanged.
+    template <class discard_t>
+    bool set_difference(
+      base_avl_tree &other, discard_t discard, unsigned num_threads = 1)
+      { return(set_op(difference_op, other, discard, num_threads)); }
+
+    // Removes the nodes whose keys would satisfy both a search with key
+    // lo and search type st_lo, and a search with key hi and search
+    // type st_hi (for example, all nodes with keys greater than or equal
+    // to lo and less than hi, for GREATER_EQUAL and LESS).  The handle
+    // of each removed node is passed to discard().  Takes O(k + log n)
+    // time, where k is the number of nodes removed.  Returns false if
+    // there was a read error.  To remove all the nodes with keys less
+    // than t, pass t with search type LESS for both bounds.
+    template <class discard_t>
+    bool remove_range(
+      key lo, search_type st_lo, key hi, search_type st_hi,
+      discard_t discard)
+      {
+	sub_tree t, below_lo, in_lo, above_lo, below_hi, in_hi, above_hi;
+
+	t.root = abs.root;
+	t.depth = calc_depth(t.root);
+	if (read_error())
+	  return(false);
+
+	// in_lo contains the nodes satisfying the lo bound, and in_hi
+	// the nodes of in_lo also satisfying the hi bound.
+	if (!split_st(t, lo, st_lo, below_lo, in_lo, above_lo) ||
+	    !split_st(in_lo, hi, st_hi, below_hi, in_hi, above_hi))
+	  return(false);
+
+	below_lo = join_sub(below_lo, below_hi);
+	above_hi = join_sub(above_hi, above_lo);
+	t = join_sub(below_lo, above_hi);
+	if (read_error())
+	  return(false);
+
+	set_root(t.root);
+
+	discard_sub(in_hi.root, discard);
+
+	return(!read_error());
+      }
+
+  protected:
+
+    friend class iter;
+    friend class parent_iter;
+
+    // Create a class whose sole purpose is to take advantage of
+    // the "empty member" optimization.
+    struct abs_plus_root : public abstractor
+      {
+	// The handle of the root element in the AVL tree.
+	handle root;
+      };
+
+    abs_plus_root abs;
+
+
+    static const bool store_parent =
+      impl::avl_has_get_parent<abstractor>::value;
+
+    handle get_lt(handle h, bool access = true)
+      { return(abs.get_less(h, access)); }
+    void set_lt(handle h, handle lh)
+      {
+	abs.set_less(h, lh);
+	impl::avl_parent<store_parent>::link(abs, h, false);
+      }
+
+    handle get_gt(handle h, bool access = true)
+      { return(abs.get_greater(h, access)); }
+    void set_gt(handle h, handle gh)
+      {
+	abs.set_greater(h, gh);
+	impl::avl_parent<store_parent>::link(abs, h, true);
+      }
+
+    // Make h the root.  (Parent links may temporarily be wrong while
+    // links in a path are reversed, but they are all corrected when the
+    // path is restored and the root is set.)
+    void set_root(handle h)
+      {
+	abs.root = h;
+	impl::avl_parent<store_parent>::set_root(abs, h);
+      }
+
+    int get_bf(handle h) { return(abs.get_balance_factor(h)); }
+    void set_bf(handle h, int bf) { abs.set_balance_factor(h, bf); }
+
+    static const bool has_prefix =
+      impl::avl_has_get_key_prefix<abstractor>::value;
+
+    typedef impl::avl_key_prefix<abstractor, has_prefix> key_prefix_cache;
+    typedef impl::avl_search_key<abstractor, has_prefix> search_key;
+    typedef impl::avl_search_node<abstractor, has_prefix> search_node;
+
+    int cmp_k_n(const search_key &sk, handle h) { return(sk.cmp(abs, h)); }
+
+    int cmp_k_n(key k, handle h) { return(cmp_k_n(search_key(abs, k), h)); }
+
+    // True if the key of h would satisfy a search with key lo and search
+    // type st_lo (GREATER or GREATER_EQUAL).
+    bool above_lo(handle h, const search_key &lo, search_type st_lo)
+      {
+	int cmp = cmp_k_n(lo, h);
+
+	return((cmp < 0) || ((cmp == 0) && (st_lo & EQUAL)));
+      }
+
+    // True if the key of h would satisfy a search with key hi and search
+    // type st_hi (LESS or LESS_EQUAL).
+    bool below_hi(handle h, const search_key &hi, search_type st_hi)
+      {
+	int cmp = cmp_k_n(hi, h);
+
+	return((cmp > 0) || ((cmp == 0) && (st_hi & EQUAL)));
+      }
+    int cmp_n_n(const search_node &sn, handle h) { return(sn.cmp(abs, h)); }
+
+    int cmp_n_n(handle h1, handle h2)
+      { return(cmp_n_n(search_node(abs, h1), h2)); }
+
+    handle null() { return(abs.null()); }
+
+    static const bool can_prefetch =
+      impl::avl_has_prefetch<abstractor>::value;
+
+    void prefetch(handle h)
+      { impl::avl_prefetch<can_prefetch>::fetch(abs, h); }
+
+    // Number of searches in a group, for search_batch().
+    static const unsigned batch_width = 16;
+
+    // Size of subtree, 0 if h is null.
+    size get_size(handle h)
+      { return(impl::avl_size<store_size>::get(abs, h)); }
+
+    static const bool store_max_end =
+      impl::avl_has_get_max_end<abstractor>::value;
+
+    // True if update() does anything.
+    static const bool store_aug =
+      store_size || store_max_end || store_agg;
+
+    // True if update() stores values that depend on the node itself (not
+    // just on the tree structure), so they can change with subst().
+    static const bool store_node_aug = store_max_end || store_agg;
+
+    // Recompute the stored values for a node that depend on the values
+    // stored in its children (the subtree size, the greatest interval end
+    // and the aggregate).  Must be called on a node after its children
+    // change, working upward from the lowest changed node.
+    void update(handle h)
+      {
+	impl::avl_size<store_size>::update(abs, h);
+	impl::avl_max_end<store_max_end>::update(abs, h);
+	impl::avl_agg<abstractor, store_agg>::update(abs, h);
+      }
+
+    // Calls update() for the first depth nodes in a path, working upward.
+    void update_path(
+      const impl::avl_path<handle, max_depth, true> &path, unsigned depth)
+      {
+	while (depth-- > 0)
+	  update(path.h[depth]);
+      }
+    void update_path(
+      const impl::avl_path<handle, max_depth, false> &, unsigned)
+      { }
+
+    // Get or set the greater child if 'greater' is true, otherwise the
+    // less child.
+    handle get_ch(handle h, bool greater, bool access = true)
+      { return(greater ? get_gt(h, access) : get_lt(h, access)); }
+    void set_ch(handle h, bool greater, handle ch)
+      {
+	if (greater)
+	  set_gt(h, ch);
+	else
+	  set_lt(h, ch);
+      }
+
+    // A subtree, along with its (1-based) depth.  An empty subtree has
+    // a depth of 0.
+    struct sub_tree
+      {
+	handle root;
+	unsigned depth;
+      };
+
+    sub_tree empty_sub()
+      {
+	sub_tree s;
+	s.root = null();
+	s.depth = 0;
+	return(s);
+      }
+
+    // Returns the depth of a subtree, following the deeper branch from
+    // each node down to a leaf.
+    unsigned calc_depth(handle h)
+      {
+	unsigned d = 0;
+
+	while (h != null())
+	  {
+	    d++;
+	    h = get_bf(h) < 0 ? get_lt(h) : get_gt(h);
+	    if (read_error())
+	      break;
+	  }
+
+	return(d);
+      }
+
+    // Returns a subtree containing the nodes of lt, the node mid, and the
+    // nodes of gt.  The key of mid must be greater than all the keys in
+    // lt, and less than all the keys in gt.  Takes time proportional
+    // to the difference in depth of lt and gt.
+    sub_tree join_sub(sub_tree lt, handle mid, sub_tree gt)
+      {
+	sub_tree res = empty_sub();
+
+	if ((lt.depth <= (gt.depth + 1)) && (gt.depth <= (lt.depth + 1)))
+	  {
+	    set_lt(mid, lt.root);
+	    set_gt(mid, gt.root);
+	    set_bf(mid, int(gt.depth) - int(lt.depth));
+	    update(mid);
+	    res.root = mid;
+	    res.depth = (lt.depth > gt.depth ? lt.depth : gt.depth) + 1;
+	    return(res);
+	  }
+
+	// If lt is the deeper subtree, descend along the greater edge
+	// of lt, otherwise descend along the less edge of gt.  Stop at
+	// the first subtree whose depth is no more than one greater than
+	// the depth of the shallower subtree.  mid becomes the root of
+	// that subtree joined with the shallower subtree.
+	bool greater = lt.depth > gt.depth;
+	sub_tree deep = greater ? lt : gt, shallow = greater ? gt : lt;
+
+	// As in remove(), the path from the root of the deeper subtree is
+	// recorded by temporarily making each node in the path point
+	// back to its parent.
+	handle h = deep.root, parent = null(), child;
+	unsigned d = deep.depth;
+	int bf;
+
+	while (d > (shallow.depth + 1))
+	  {
+	    bf = get_bf(h);
+	    child = get_ch(h, greater);
+	    if (read_error())
+	      return(res);
+	    set_ch(h, greater, parent);
+	    d -= 1 + (greater ? bf < 0 : bf > 0);
+	    parent = h;
+	    h = child;
+	  }
+
+	set_ch(mid, !greater, h);
+	set_ch(mid, greater, shallow.root);
+	set_bf(mid, greater ? int(shallow.depth) - int(d) :
+			      int(d) - int(shallow.depth));
+	update(mid);
+
+	// Climb back to the root of the deeper subtree, restoring the
+	// links and rebalancing as necessary.  The subtree at the
+	// position where mid was placed is one deeper than the subtree
+	// it replaced.
+	bool grew = true;
+	h = mid;
+	while (parent != null())
+	  {
+	    child = h;
+	    h = parent;
+	    parent = get_ch(h, greater);
+	    if (read_error())
+	      return(res);
+	    set_ch(h, greater, child);
+	    update(h);
+	    if (grew)
+	      {
+		bf = get_bf(h) + (greater ? 1 : -1);
+		if ((bf == -2) || (bf == 2))
+		  {
+		    h = balance(h);
+		    if (read_error())
+		      return(res);
+		    bf = get_bf(h);
+		  }
+		else
+		  set_bf(h, bf);
+		grew = (bf != 0);
+	      }
+	  }
+
+	res.root = h;
+	res.depth = deep.depth + grew;
+
+	return(res);
+      }
+
+    // Removes the node with the greatest key (if greatest is true) or
+    // the least key (if greatest is false) from the non-empty subtree t,
+    // and returns its handle.
+    handle pop_sub(sub_tree &t, bool greatest)
+      {
+	handle h = t.root, parent = null(), child;
+
+	for ( ; ; )
+	  {
+	    child = get_ch(h, greatest);
+	    if (read_error())
+	      return(null());
+	    if (child == null())
+	      break;
+	    set_ch(h, greatest, parent);
+	    parent = h;
+	    h = child;
+	  }
+
+	handle ext = h;
+	h = get_ch(ext, !greatest);
+	if (read_error())
+	  return(null());
+
+	bool reduced_depth = true;
+	int bf;
+	while (parent != null())
+	  {
+	    child = h;
+	    h = parent;
+	    parent = get_ch(h, greatest);
+	    if (read_error())
+	      return(null());
+	    set_ch(h, greatest, child);
+	    update(h);
+	    if (reduced_depth)
+	      {
+		bf = get_bf(h) + (greatest ? -1 : 1);
+		if ((bf == -2) || (bf == 2))
+		  {
+		    h = balance(h);
+		    if (read_error())
+		      return(null());
+		    bf = get_bf(h);
+		  }
+		else
+		  set_bf(h, bf);
+		reduced_depth = (bf == 0);
+	      }
+	  }
+
+	t.root = h;
+	t.depth -= reduced_depth;
+
+	return(ext);
+      }
+
+    // Returns a subtree containing the nodes of lt and gt.  All the keys
+    // in lt must be less than all the keys in gt.
+    sub_tree join_sub(sub_tree lt, sub_tree gt)
+      {
+	if (lt.depth == 0)
+	  return(gt);
+	if (gt.depth == 0)
+	  return(lt);
+
+	handle mid = pop_sub(gt, false);
+	if (read_error())
+	  return(gt);
+
+	return(join_sub(lt, mid, gt));
+      }
+
+    // Compare a key to the key of a node.
+    struct key_cmp
+      {
+	base_avl_tree &tree;
+	search_key sk;
+
+	int operator () (handle h) { return(tree.cmp_k_n(sk, h)); }
+      };
+
+    // Splits the subtree t into the subtree lt, containing the nodes
+    // whose keys are less than the split point, and the subtree gt,
+    // containing the nodes whose keys are greater.  cmp(h) must return
+    // a negative, zero or positive value if the split point is less than,
+    // equal to or greater than the key of the node h.  mid is set to
+    // the handle of the node (if any) for which cmp() returns 0, or
+    // null otherwise.  Returns false if there was a read error.
+    template <class cmp_t>
+    bool split_sub(
+      sub_tree t, cmp_t &cmp, sub_tree &lt, handle &mid, sub_tree &gt)
+      {
+	// Records the path from the root of t to the split point.  If
+	// branch[n] is true, the path takes the greater branch from the
+	// nth node in the path, otherwise the less branch.
+	bset branch;
+
+	unsigned depth = 0;
+
+	// Depth of the subtree whose root is the current node in the path.
+	unsigned d = t.depth;
+
+	handle h = t.root, parent = null(), child;
+	int c, bf;
+
+	mid = null();
+
+	// Descend to the split point, temporarily making each node in
+	// the path point back to its parent.
+	while (h != null())
+	  {
+	    c = cmp(h);
+	    if (c == 0)
+	      {
+		mid = h;
+		break;
+	      }
+	    bf = get_bf(h);
+	    child = get_ch(h, c > 0);
+	    if (read_error())
+	      return(false);
+	    set_ch(h, c > 0, parent);
+	    d -= 1 + (c > 0 ? bf < 0 : bf > 0);
+	    branch[depth++] = c > 0;
+	    parent = h;
+	    h = child;
+	  }
+
+	lt = empty_sub();
+	gt = lt;
+
+	if (mid != null())
+	  {
+	    bf = get_bf(mid);
+	    lt.root = get_lt(mid);
+	    gt.root = get_gt(mid);
+	    if (read_error())
+	      return(false);
+	    lt.depth = d - 1 - (bf > 0);
+	    gt.depth = d - 1 - (bf < 0);
+	  }
+
+	// Climb back to the root of t.  Each node in the path, along with
+	// its subtree that is not in the path, is joined to lt or gt.
+	// d is the depth (before the split) of the subtree whose root is
+	// the child of the current node that is in the path.
+	sub_tree s;
+	bool greater;
+	while (parent != null())
+	  {
+	    h = parent;
+	    greater = branch[--depth];
+	    bf = get_bf(h);
+	    parent = get_ch(h, greater);
+	    s.root = get_ch(h, !greater);
+	    if (read_error())
+	      return(false);
+	    if (greater)
+	      {
+		// bf is depth of greater subtree minus depth of less
+		// subtree.
+		s.depth = d - bf;
+		d = (bf < 0 ? s.depth : d) + 1;
+		lt = join_sub(s, h, lt);
+	      }
+	    else
+	      {
+		s.depth = d + bf;
+		d = (bf > 0 ? s.depth : d) + 1;
+		gt = join_sub(gt, h, s);
+	      }
+	    if (read_error())
+	      return(false);
+	  }
+
+	return(true);
+      }
+
+    // Splits the subtree t into three subtrees, each possibly empty.
+    // in contains the nodes whose keys would satisfy a search with key k
+    // and search type st.  below contains the nodes with lesser keys,
+    // and above the nodes with greater keys.  Returns false if there was
+    // a read error.
+    bool split_st(
+      sub_tree t, key k, search_type st, sub_tree &below, sub_tree &in,
+      sub_tree &above)
+      {
+	sub_tree lt, gt;
+	handle mid;
+	key_cmp cmp = { *this, search_key(abs, k) };
+
+	if (!split_sub(t, cmp, lt, mid, gt))
+	  return(false);
+
+	below = empty_sub();
+	in = below;
+	above = below;
+
+	if (st == EQUAL)
+	  {
+	    below = lt;
+	    if (mid != null())
+	      in = join_sub(in, mid, in);
+	    above = gt;
+	  }
+	else
+	  {
+	    // As in split().
+	    if (mid != null())
+	      {
+		if (!(st & LESS) == !(st & EQUAL))
+		  lt = join_sub(lt, mid, empty_sub());
+		else
+		  gt = join_sub(empty_sub(), mid, gt);
+	      }
+	    if (st & LESS)
+	      {
+		in = lt;
+		above = gt;
+	      }
+	    else
+	      {
+		below = lt;
+		in = gt;
+	      }
+	  }
+
+	return(!read_error());
+      }
+
+    // Compare the key of a node to the key of another node.
+    struct node_cmp
+      {
+	base_avl_tree &tree;
+	search_node sn;
+
+	int operator () (handle h) { return(tree.cmp_n_n(sn, h)); }
+      };
+
+    // Passes the handle of each node in a subtree to discard().  The
+    // children of a node are read before the node is passed.
+    template <class discard_t>
+    void discard_sub(handle h, discard_t &discard)
+      {
+	if (h == null())
+	  return;
+
+	handle lh = get_lt(h), gh = get_gt(h);
+	if (read_error())
+	  return;
+
+	discard_sub(lh, discard);
+	discard_sub(gh, discard);
+	discard(h);
+      }
+
+    // Builds a tree from the num_nodes (greater than 0) nodes in the
+    // sequence p, and returns its root (or null if there was a read
+    // error, or p failed).  The root is not made the root of this tree.
+    template<typename fwd_iter>
+    handle build_seq(fwd_iter p, size num_nodes)
+      {
+	// NOTE:  GCC allows me to define this outside the class definition
+	// using the following syntax:
+	//
+	// template <class abstractor, unsigned max_depth, class bset>
+	// template<typename fwd_iter>
+	// inline handle base_avl_tree<abstractor, max_depth, bset>::build_seq(
+	//   fwd_iter p, size num_nodes)
+	//   {
+	//     ...
+	//   }
+	//
+	// but Visual C++ .NET won't accept it.  Is this a GCC extension?
+
+	// Gives path to subtree being built.  If branch[N] is false, branch
+	// less from the node at depth N, if true branch greater.
 	bset branch;
 
 	// If rem[N] is true, then for the current subtree at depth N, it's
 	// greater subtree has one more node than it's less subtree.
 	bset rem;
 
-        // Depth of root node of current subtree.
+	// Depth of root node of current subtree.
 	unsigned depth = 0;
 
-        // Number of nodes in current subtree.
+	// Number of nodes in current subtree.
 	size num_sub = num_nodes;
 
 	// The algorithm relies on a stack of nodes whose less subtree has
@@ -434,31 +1952,34 @@ class base_avl_tree
 		// split between the two subtrees.
 
 		h = *p;
-		if (read_error())
-		  return(false);
+		if (read_error() || build_iter_error(p))
+		  return(null());
 		p++;
 		child = *p;
-		if (read_error())
-		  return(false);
+		if (read_error() || build_iter_error(p))
+		  return(null());
 		p++;
 		set_lt(child, null());
 		set_gt(child, null());
 		set_bf(child, 0);
+		update(child);
 		set_gt(h, child);
 		set_lt(h, null());
 		set_bf(h, 1);
+		update(h);
 	      }
 	    else  // num_sub == 1
 	      {
 		// Build a subtree with one node.
 
 		h = *p;
-		if (read_error())
-		  return(false);
+		if (read_error() || build_iter_error(p))
+		  return(null());
 		p++;
 		set_lt(h, null());
 		set_gt(h, null());
 		set_bf(h, 0);
+		update(h);
 	      }
 
 	    while (depth)
@@ -475,7 +1996,7 @@ class base_avl_tree
 		h = less_parent;
 		less_parent = get_gt(h);
 		if (read_error())
-		  return(false);
+		  return(null());
 		set_gt(h, child);
 		// num_sub = 2 * (num_sub - rem[depth]) + rem[depth] + 1
 		num_sub <<= 1;
@@ -486,68 +2007,247 @@ class base_avl_tree
 		else
 		  // num_sub is a power of 2
 		  set_bf(h, 1);
+		update(h);
 	      }
 
 	    if (num_sub == num_nodes)
 	      // We've completed the full tree.
 	      break;
 
-	    // The subtree we've completed is the less subtree of the
-	    // next node in the sequence.
+	    // The subtree we've completed is the less subtree of the
+	    // next node in the sequence.
+
+	    child = h;
+	    h = *p;
+	    if (read_error() || build_iter_error(p))
+	      return(null());
+	    p++;
+	    set_lt(h, child);
+
+	    // Put h into stack of less parents.
+	    set_gt(h, less_parent);
+	    less_parent = h;
+
+	    // Proceed to creating greater than subtree of h.
+	    branch[depth] = true;
+	    num_sub += rem[depth++];
+
+	  } // end for ( ; ; )
+
+	return(h);
+      }
+
+    // Builds a subtree of the num_sub (greater than 0) nodes starting at p,
+    // and returns its root (or null if there was a read error, or p
+    // failed).  The shape is the same as build() gives: the less subtree
+    // has (num_sub - 1) / 2 nodes, the greater subtree the rest.
+    template<typename rand_iter>
+    handle build_sub(rand_iter p, size num_sub, unsigned num_threads)
+      {
+	size num_lt = (num_sub - 1) >> 1, num_gt = num_sub - 1 - num_lt;
+	rand_iter p_h = p + num_lt;
+	handle h = *p_h;
+	if (read_error() || build_iter_error(p_h))
+	  return(null());
+	handle lt = null(), gt = null();
+
+	#if __cplusplus >= 201100
+	if ((num_threads > 1) && (num_lt > 0))
+	  {
+	    unsigned lt_threads = num_threads / 2;
+	    std::thread thr(
+	      [&] { lt = build_sub(p, num_lt, lt_threads); });
+	    gt = build_sub(p + (num_lt + 1), num_gt, num_threads - lt_threads);
+	    thr.join();
+	  }
+	else
+	#else
+	(void) num_threads;
+	#endif
+	  {
+	    // build_seq() builds the same shape faster, since it accesses
+	    // the nodes in sequence.
+	    if (num_lt > 0)
+	      lt = build_seq(p, num_lt);
+	    if (num_gt > 0)
+	      gt = build_seq(p + (num_lt + 1), num_gt);
+	  }
+
+	if (((num_lt > 0) && (lt == null())) ||
+	    ((num_gt > 0) && (gt == null())))
+	  return(null());
+
+	set_lt(h, lt);
+	set_gt(h, gt);
+
+	// The greater subtree is deeper only if num_sub is a power of 2.
+	set_bf(h, (num_sub > 1) && !(num_sub & (num_sub - 1)));
+	update(h);
+
+	return(h);
+      }
+
+    enum set_op_t { union_op, intersection_op, difference_op };
+
+    // Returns the result of applying the set operation op to the
+    // subtrees t1 and t2, using the algorithm in "Just Join for Parallel
+    // Ordered Sets" (Blelloch, Ferizovic and Sun).  For union, t2 is
+    // split at the root of t1.  For intersection and difference, t1 is
+    // split at the root of t2, and t2 is left unchanged.
+    template <class discard_t>
+    sub_tree set_op_sub(
+      set_op_t op, sub_tree t1, sub_tree t2, discard_t &discard,
+      unsigned num_threads)
+      {
+	if (t1.depth == 0)
+	  return(op == union_op ? t2 : t1);
+
+	if (t2.depth == 0)
+	  {
+	    if (op != intersection_op)
+	      return(t1);
+	    discard_sub(t1.root, discard);
+	    return(t2);
+	  }
+
+	sub_tree &piv = op == union_op ? t1 : t2;
+	sub_tree &cut = op == union_op ? t2 : t1;
+
+	handle r = piv.root;
+	int bf = get_bf(r);
+	sub_tree piv_lt, piv_gt;
+	piv_lt.root = get_lt(r);
+	piv_gt.root = get_gt(r);
+	if (read_error())
+	  return(empty_sub());
+	piv_lt.depth = piv.depth - 1 - (bf > 0);
+	piv_gt.depth = piv.depth - 1 - (bf < 0);
 
-	    child = h;
-	    h = *p;
-	    if (read_error())
-	      return(false);
-	    p++;
-	    set_lt(h, child);
+	node_cmp cmp = { *this, search_node(abs, r) };
+	sub_tree cut_lt, cut_gt;
+	handle mid;
+	if (!split_sub(cut, cmp, cut_lt, mid, cut_gt))
+	  return(empty_sub());
 
-	    // Put h into stack of less parents.
-	    set_gt(h, less_parent);
-	    less_parent = h;
+	if ((mid != null()) && (op != intersection_op))
+	  discard(mid);
 
-	    // Proceed to creating greater than subtree of h.
-	    branch[depth] = true;
-	    num_sub += rem[depth++];
+	if (op != union_op)
+	  {
+	    // Put the pieces of t1 first.
+	    std::swap(piv_lt, cut_lt);
+	    std::swap(piv_gt, cut_gt);
+	  }
 
-	  } // end for ( ; ; )
+	sub_tree lt, gt;
 
-	abs.root = h;
+	#if __cplusplus >= 201100
+	if (num_threads > 1)
+	  {
+	    unsigned lt_threads = num_threads / 2;
+	    std::thread thr(
+	      [&]
+		{
+		  lt = set_op_sub(op, piv_lt, cut_lt, discard, lt_threads);
+		});
+	    gt = set_op_sub(
+		   op, piv_gt, cut_gt, discard, num_threads - lt_threads);
+	    thr.join();
+	  }
+	else
+	#else
+	(void) num_threads;
+	#endif
+	  {
+	    lt = set_op_sub(op, piv_lt, cut_lt, discard, 1);
+	    gt = set_op_sub(op, piv_gt, cut_gt, discard, 1);
+	  }
 
-	return(true);
-      }
+	if (read_error())
+	  return(empty_sub());
 
-  protected:
+	if (op == union_op)
+	  return(join_sub(lt, r, gt));
 
-    friend class iter;
+	if ((op == intersection_op) && (mid != null()))
+	  return(join_sub(lt, mid, gt));
 
-    // Create a class whose sole purpose is to take advantage of
-    // the "empty member" optimization.
-    struct abs_plus_root : public abstractor
+	return(join_sub(lt, gt));
+      }
+
+    template <class discard_t>
+    bool set_op(
+      set_op_t op, base_avl_tree &other, discard_t &discard,
+      unsigned num_threads)
       {
-	// The handle of the root element in the AVL tree.
-	handle root;
-      };
+	sub_tree t1, t2;
 
-    abs_plus_root abs;
+	t1.root = abs.root;
+	t1.depth = calc_depth(t1.root);
+	t2.root = other.abs.root;
+	t2.depth = calc_depth(t2.root);
+	if (read_error())
+	  return(false);
 
+	if (op == union_op)
+	  other.abs.root = null();
 
-    handle get_lt(handle h, bool access = true)
-      { return(abs.get_less(h, access)); }
-    void set_lt(handle h, handle lh) { abs.set_less(h, lh); }
+	t1 = set_op_sub(op, t1, t2, discard, num_threads);
+	if (read_error())
+	  return(false);
 
-    handle get_gt(handle h, bool access = true)
-      { return(abs.get_greater(h, access)); }
-    void set_gt(handle h, handle gh) { abs.set_greater(h, gh); }
+	set_root(t1.root);
 
-    int get_bf(handle h) { return(abs.get_balance_factor(h)); }
-    void set_bf(handle h, int bf) { abs.set_balance_factor(h, bf); }
+	return(true);
+      }
 
-    int cmp_k_n(key k, handle h) { return(abs.compare_key_node(k, h)); }
-    int cmp_n_n(handle h1, handle h2)
-      { return(abs.compare_node_node(h1, h2)); }
+    // Climbs the path of the iterator 'it' (see the finger operations),
+    // and leaves 'it' referring to the root of a subtree that must
+    // contain the split point defined by cmp (see split_sub()).  The tree
+    // must not be empty.  Returns the result of cmp() for that root.  If
+    // it returns 0, the root is the node matching the split point.
+    template <class cmp_t>
+    int climb(iter &it, cmp_t &cmp)
+      {
+	if ((it.depth == unsigned(~0)) || (it.tree_ != this))
+	  {
+	    it.tree_ = this;
+	    it.depth = 0;
+	  }
 
-    handle null() { return(abs.null()); }
+	int c = cmp(*it);
+	if (c == 0)
+	  return(0);
+
+	// If the split point is greater than the current node, look for
+	// a node in the path that is greater than the split point, the
+	// first node in the path (going up) whose less branch was taken.
+	// And vice-versa if the split point is less than the current
+	// node.
+	bool greater = c > 0;
+	unsigned d = it.depth;
+	int c2;
+	while (d > 0)
+	  {
+	    d--;
+	    if (it.branch[d] != greater)
+	      {
+		c2 = cmp(it.path(d));
+		if (c2 == 0)
+		  {
+		    it.depth = d;
+		    return(0);
+		  }
+		if ((c2 > 0) != greater)
+		  // The split point is between this node and the node the
+		  // climb started from.
+		  break;
+		it.depth = d;
+	      }
+	  }
+
+	return(c);
+      }
 
   private:
 
@@ -600,6 +2300,9 @@ class base_avl_tree
 		    set_bf(old_h, 0);
 		    set_bf(deep_h, 0);
 		  }
+		update(old_h);
+		update(deep_h);
+		update(bal_h);
 	      }
 	    else
 	      {
@@ -615,6 +2318,8 @@ class base_avl_tree
 		    set_bf(deep_h, 0);
 		    set_bf(bal_h, 0);
 		  }
+		update(bal_h);
+		update(deep_h);
 		bal_h = deep_h;
 	      }
 	  }
@@ -657,6 +2362,9 @@ class base_avl_tree
 		    set_bf(old_h, 0);
 		    set_bf(deep_h, 0);
 		  }
+		update(old_h);
+		update(deep_h);
+		update(bal_h);
 	      }
 	    else
 	      {
@@ -672,6 +2380,8 @@ class base_avl_tree
 		    set_bf(deep_h, 0);
 		    set_bf(bal_h, 0);
 		  }
+		update(bal_h);
+		update(deep_h);
 		bal_h = deep_h;
 	      }
 	  }
@@ -688,9 +2398,10 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
     set_lt(h, null());
     set_gt(h, null());
     set_bf(h, 0);
+    update(h);
 
     if (abs.root == null())
-      abs.root = h;
+      set_root(h);
     else
       {
 	// Last unbalanced node encountered in search for insertion point.
@@ -709,9 +2420,14 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 	// so on.
 	bset branch;
 
+	// Handles of nodes in the path, only kept if update() does
+	// anything.
+	impl::avl_path<handle, max_depth, store_aug> path_h;
+
 	handle hh = abs.root;
 	handle parent = null();
 	int cmp;
+	search_node sn(abs, h);
 
 	do
  	  {
@@ -721,10 +2437,11 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 		parent_unbal = parent;
 		unbal_depth = depth;
 	      }
-	    cmp = cmp_n_n(h, hh);
+	    cmp = cmp_n_n(sn, hh);
 	    if (cmp == 0)
 	      // Duplicate key.
 	      return(hh);
+	    path_h.set(depth, hh);
 	    parent = hh;
 	    hh = cmp < 0 ? get_lt(hh) : get_gt(hh);
 	    if (read_error())
@@ -739,65 +2456,339 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 	else
 	  set_gt(parent, h);
 
+	update_path(path_h, depth);
+
 	depth = unbal_depth;
 
 	if (unbal == null())
 	  hh = abs.root;
 	else
 	  {
-	    cmp = branch[depth++] ? 1 : -1;
-	    unbal_bf = get_bf(unbal);
-	    if (cmp < 0)
-	      unbal_bf--;
-	    else  // cmp > 0
-	      unbal_bf++;
-	    hh = cmp < 0 ? get_lt(unbal) : get_gt(unbal);
-	    if (read_error())
-	      return(null());
-	    if ((unbal_bf != -2) && (unbal_bf != 2))
-	      {
-		// No rebalancing of tree is necessary.
-		set_bf(unbal, unbal_bf);
-		unbal = null();
-	      }
+	    cmp = branch[depth++] ? 1 : -1;
+	    unbal_bf = get_bf(unbal);
+	    if (cmp < 0)
+	      unbal_bf--;
+	    else  // cmp > 0
+	      unbal_bf++;
+	    hh = cmp < 0 ? get_lt(unbal) : get_gt(unbal);
+	    if (read_error())
+	      return(null());
+	    if ((unbal_bf != -2) && (unbal_bf != 2))
+	      {
+		// No rebalancing of tree is necessary.
+		set_bf(unbal, unbal_bf);
+		unbal = null();
+	      }
+	  }
+
+	if (hh != null())
+	  while (h != hh)
+	    {
+	      cmp = branch[depth++] ? 1 : -1;
+	      if (cmp < 0)
+		{
+		  set_bf(hh, -1);
+		  hh = get_lt(hh);
+		}
+	      else // cmp > 0
+		{
+		  set_bf(hh, 1);
+		  hh = get_gt(hh);
+		}
+	      if (read_error())
+		return(null());
+	    }
+
+	if (unbal != null())
+	  {
+	    unbal = balance(unbal);
+	    if (read_error())
+	      return(null());
+	    if (parent_unbal == null())
+	      set_root(unbal);
+	    else
+	      {
+		depth = unbal_depth - 1;
+		cmp = branch[depth] ? 1 : -1;
+		if (cmp < 0)
+		  set_lt(parent_unbal, unbal);
+		else  // cmp > 0
+		  set_gt(parent_unbal, unbal);
+	      }
+	  }
+
+      }
+
+    return(h);
+  }
+
+template <class abstractor, unsigned max_depth, class bset>
+inline typename base_avl_tree<abstractor, max_depth, bset>::handle
+  base_avl_tree<abstractor, max_depth, bset>::search(key k, search_type st)
+  {
+    const int MASK_HIGH_BIT = (int) ~ ((~ (unsigned) 0) >> 1);
+
+    int cmp, target_cmp;
+    handle match_h = null();
+    handle h = abs.root;
+
+    if (st & LESS)
+      target_cmp = 1;
+    else if (st & GREATER)
+      target_cmp = -1;
+    else
+      target_cmp = 0;
+
+    search_key sk(abs, k);
+
+    while (h != null())
+      {
+	cmp = cmp_k_n(sk, h);
+	if (cmp == 0)
+	  {
+	    if (st & EQUAL)
+	      {
+		match_h = h;
+		break;
+	      }
+	    cmp = -target_cmp;
+	  }
+	else if (target_cmp != 0)
+	  if (!((cmp ^ target_cmp) & MASK_HIGH_BIT))
+	    // cmp and target_cmp are both positive or both negative.
+	    match_h = h;
+	h = cmp < 0 ? get_lt(h) : get_gt(h);
+	if (read_error())
+	  {
+	    match_h = null();
+	    break;
+	  }
+      }
+
+    return(match_h);
+  }
+
+template <class abstractor, unsigned max_depth, class bset>
+inline bool
+  base_avl_tree<abstractor, max_depth, bset>::search_batch(
+    const key *keys, size n, handle *out, search_type st)
+  {
+    const int MASK_HIGH_BIT = (int) ~ ((~ (unsigned) 0) >> 1);
+
+    int cmp, target_cmp;
+
+    if (st & LESS)
+      target_cmp = 1;
+    else if (st & GREATER)
+      target_cmp = -1;
+    else
+      target_cmp = 0;
+
+    // Current node of each search in the group, and the indexes (in the
+    // group) of the searches that are not done.
+    handle cur[batch_width];
+    unsigned active[batch_width];
+    key_prefix_cache kp[batch_width];
+
+    unsigned num_active, num_left, a, j;
+    handle h;
+
+    for (size base = 0; base < n; base += batch_width)
+      {
+	num_active =
+	  (n - base) < batch_width ? unsigned(n - base) : batch_width;
+
+	for (j = 0; j < num_active; ++j)
+	  {
+	    out[base + j] = null();
+	    cur[j] = abs.root;
+	    active[j] = j;
+	    kp[j].set(abs, keys[base + j]);
+	  }
+
+	if (abs.root == null())
+	  continue;
+
+	while (num_active)
+	  {
+	    num_left = 0;
+
+	    for (a = 0; a < num_active; ++a)
+	      {
+		j = active[a];
+		h = cur[j];
+
+		// Same as the loop body in search().
+		cmp = kp[j].cmp(abs, keys[base + j], h);
+		if (cmp == 0)
+		  {
+		    if (st & EQUAL)
+		      {
+			out[base + j] = h;
+			continue;
+		      }
+		    cmp = -target_cmp;
+		  }
+		else if (target_cmp != 0)
+		  if (!((cmp ^ target_cmp) & MASK_HIGH_BIT))
+		    // cmp and target_cmp are both positive or both negative.
+		    out[base + j] = h;
+		h = cmp < 0 ? get_lt(h) : get_gt(h);
+
+		if (h != null())
+		  {
+		    // Start loading the node while the other searches in the
+		    // group are advanced.
+		    prefetch(h);
+		    cur[j] = h;
+		    active[num_left++] = j;
+		  }
+	      }
+
+	    if (read_error())
+	      {
+		for (size i = 0; i < n; ++i)
+		  out[i] = null();
+		return(false);
+	      }
+
+	    num_active = num_left;
+	  }
+      }
+
+    return(true);
+  }
+
+template <class abstractor, unsigned max_depth, class bset>
+inline typename base_avl_tree<abstractor, max_depth, bset>::handle
+  base_avl_tree<abstractor, max_depth, bset>::insert(handle h, iter &hint)
+  {
+    set_lt(h, null());
+    set_gt(h, null());
+    set_bf(h, 0);
+    update(h);
+
+    if (abs.root == null())
+      {
+	set_root(h);
+	hint.tree_ = this;
+	hint.depth = 0;
+	return(h);
+      }
+
+    node_cmp nc = { *this, search_node(abs, h) };
+    int cmp = climb(hint, nc);
+    if (read_error())
+      {
+	hint.depth = unsigned(~0);
+	return(null());
+      }
+    if (cmp == 0)
+      // Duplicate key.
+      return(*hint);
+
+    // Zero-based depth in tree.
+    unsigned depth = hint.depth, start_depth = depth;
+
+    // Depth of last unbalanced node in path to insertion point.
+    unsigned unbal_depth = unsigned(~0);
+
+    handle hh = hint.path(depth), child;
+
+    // Descend to insertion point, extending the path of the iterator.
+    for ( ; ; )
+      {
+	if (get_bf(hh) != 0)
+	  unbal_depth = depth;
+	hint.branch[depth] = cmp > 0;
+	child = get_ch(hh, cmp > 0);
+	if (read_error())
+	  {
+	    hint.depth = unsigned(~0);
+	    return(null());
+	  }
+	if (child == null())
+	  break;
+	hh = child;
+	hint.path_h[depth++] = hh;
+	cmp = nc(hh);
+	if (cmp == 0)
+	  {
+	    // Duplicate key.
+	    hint.depth = depth;
+	    return(hh);
+	  }
+      }
+
+    //  Add node to insert as leaf of tree.
+    set_ch(hh, cmp > 0, h);
+    hint.path_h[depth++] = h;
+    hint.depth = depth;
+
+    if (unbal_depth == unsigned(~0))
+      // Look for last unbalanced node in the part of the path above
+      // where the descent started.
+      for (unsigned d = start_depth; d-- > 0; )
+	if (get_bf(hint.path(d)) != 0)
+	  {
+	    unbal_depth = d;
+	    break;
+	  }
+
+    if (store_aug)
+      for (unsigned d = depth; d-- > 0; )
+	update(hint.path(d));
+
+    unsigned d = 0;
+    bool rebalance = false;
+
+    if (unbal_depth != unsigned(~0))
+      {
+	handle unbal = hint.path(unbal_depth);
+	int unbal_bf = get_bf(unbal) + (hint.branch[unbal_depth] ? 1 : -1);
+	if ((unbal_bf != -2) && (unbal_bf != 2))
+	  // No rebalancing of tree is necessary.
+	  set_bf(unbal, unbal_bf);
+	else
+	  rebalance = true;
+	d = unbal_depth + 1;
+      }
+
+    for ( ; d < depth; d++)
+      set_bf(hint.path(d), hint.branch[d] ? 1 : -1);
+
+    if (rebalance)
+      {
+	hh = balance(hint.path(unbal_depth));
+	if (read_error())
+	  {
+	    hint.depth = unsigned(~0);
+	    return(null());
 	  }
+	d = unbal_depth;
+	if (d == 0)
+	  set_root(hh);
+	else
+	  set_ch(hint.path(d - 1), hint.branch[d - 1], hh);
 
-	if (hh != null())
-	  while (h != hh)
-	    {
-	      cmp = branch[depth++] ? 1 : -1;
-	      if (cmp < 0)
-		{
-		  set_bf(hh, -1);
-		  hh = get_lt(hh);
-		}
-	      else // cmp > 0
-		{
-		  set_bf(hh, 1);
-		  hh = get_gt(hh);
-		}
-	      if (read_error())
-		return(null());
-	    }
-
-	if (unbal != null())
+	// Redo the part of the iterator's path that was changed by the
+	// rotation.
+	while (hh != h)
 	  {
-	    unbal = balance(unbal);
+	    if (d > 0)
+	      hint.path_h[d - 1] = hh;
+	    cmp = nc(hh);
+	    hint.branch[d++] = cmp > 0;
+	    hh = get_ch(hh, cmp > 0);
 	    if (read_error())
-	      return(null());
-	    if (parent_unbal == null())
-	      abs.root = unbal;
-	    else
 	      {
-		depth = unbal_depth - 1;
-		cmp = branch[depth] ? 1 : -1;
-		if (cmp < 0)
-		  set_lt(parent_unbal, unbal);
-		else  // cmp > 0
-		  set_gt(parent_unbal, unbal);
+		hint.depth = unsigned(~0);
+		return(null());
 	      }
 	  }
-
+	if (d > 0)
+	  hint.path_h[d - 1] = h;
+	hint.depth = d;
       }
 
     return(h);
@@ -805,46 +2796,43 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 
 template <class abstractor, unsigned max_depth, class bset>
 inline typename base_avl_tree<abstractor, max_depth, bset>::handle
-  base_avl_tree<abstractor, max_depth, bset>::search(key k, search_type st)
+  base_avl_tree<abstractor, max_depth, bset>::search(key k, iter &hint)
   {
-    const int MASK_HIGH_BIT = (int) ~ ((~ (unsigned) 0) >> 1);
+    if (abs.root == null())
+      {
+	hint.depth = unsigned(~0);
+	return(null());
+      }
 
-    int cmp, target_cmp;
-    handle match_h = null();
-    handle h = abs.root;
+    key_cmp kc = { *this, search_key(abs, k) };
+    int cmp = climb(hint, kc);
+    if (read_error())
+      {
+	hint.depth = unsigned(~0);
+	return(null());
+      }
 
-    if (st & LESS)
-      target_cmp = 1;
-    else if (st & GREATER)
-      target_cmp = -1;
-    else
-      target_cmp = 0;
+    unsigned depth = hint.depth;
+    handle h = hint.path(depth), child;
 
-    while (h != null())
+    while (cmp != 0)
       {
-	cmp = cmp_k_n(k, h);
-	if (cmp == 0)
-	  {
-	    if (st & EQUAL)
-	      {
-		match_h = h;
-		break;
-	      }
-	    cmp = -target_cmp;
-	  }
-	else if (target_cmp != 0)
-	  if (!((cmp ^ target_cmp) & MASK_HIGH_BIT))
-	    // cmp and target_cmp are both positive or both negative.
-	    match_h = h;
-	h = cmp < 0 ? get_lt(h) : get_gt(h);
+	child = get_ch(h, cmp > 0);
 	if (read_error())
 	  {
-	    match_h = null();
-	    break;
+	    hint.depth = unsigned(~0);
+	    return(null());
 	  }
+	if (child == null())
+	  return(null());
+	hint.branch[depth] = cmp > 0;
+	hint.path_h[depth++] = child;
+	hint.depth = depth;
+	h = child;
+	cmp = kc(h);
       }
 
-    return(match_h);
+    return(h);
   }
 
 template <class abstractor, unsigned max_depth, class bset>
@@ -902,14 +2890,15 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 
     handle h = abs.root;
     handle parent = null(), child;
-    int cmp, cmp_shortened_sub_with_path;
+    int cmp, cmp_shortened_sub_with_path = 0;
+    search_key sk(abs, k);
 
     for ( ; ; )
       {
 	if (h == null())
 	  // No node in tree with given key.
 	  return(null());
-	cmp = cmp_k_n(k, h);
+	cmp = cmp_k_n(sk, h);
 	if (cmp == 0)
 	  // Found node to remove.
 	  break;
@@ -983,7 +2972,7 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 
     if (parent == null())
       // There were only 1 or 2 nodes in this tree.
-      abs.root = child;
+      set_root(child);
     else if (cmp_shortened_sub_with_path < 0)
       set_lt(parent, child);
     else
@@ -1002,7 +2991,7 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 	set_gt(h, get_gt(rm, false));
 	set_bf(h, get_bf(rm));
 	if (parent_rm == null())
-	  abs.root = h;
+	  set_root(h);
 	else
 	  {
 	    depth = rm_depth - 1;
@@ -1045,6 +3034,7 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 	cmp = cmp_shortened_sub_with_path;
 	for ( ; ; )
 	  {
+	    update(h);
 	    if (reduced_depth)
 	      {
 		bf = get_bf(h);
@@ -1081,7 +3071,123 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 	    if (read_error())
 	      return(null());
 	  }
-	abs.root = h;
+	set_root(h);
+      }
+
+    return(rm);
+  }
+
+template <class abstractor, unsigned max_depth, class bset>
+inline typename base_avl_tree<abstractor, max_depth, bset>::handle
+  base_avl_tree<abstractor, max_depth, bset>::remove_node(handle rm)
+  {
+    handle parent_rm = abs.get_parent(rm);
+    handle lh = get_lt(rm), gh = get_gt(rm);
+    int bf = get_bf(rm);
+    if (read_error())
+      return(null());
+
+    // True if the node to remove is the greater child of its parent.
+    bool rm_greater = false;
+    if (parent_rm != null())
+      {
+	rm_greater = get_gt(parent_rm) == rm;
+	if (read_error())
+	  return(null());
+      }
+
+    // The node to put in the place of the node to remove.
+    handle h;
+
+    // The node whose subtree (the greater one if greater is true) has
+    // been reduced in depth.
+    handle path;
+    bool greater;
+
+    if ((lh == null()) || (gh == null()))
+      {
+	// The node to remove has at most one child, which takes its place.
+	h = lh == null() ? gh : lh;
+	path = parent_rm;
+	greater = rm_greater;
+      }
+    else
+      {
+	// As in remove(), the replacement is the greatest node in the less
+	// subtree, or the least node in the greater subtree, whichever
+	// subtree is deeper.
+	bool from_gt = bf >= 0;
+	handle child = from_gt ? gh : lh;
+	do
+	  {
+	    h = child;
+	    child = get_ch(h, !from_gt);
+	    if (read_error())
+	      return(null());
+	  }
+	while (child != null());
+
+	if (h == (from_gt ? gh : lh))
+	  {
+	    // The replacement is a child of the node to remove, and keeps
+	    // its own subtree.
+	    path = h;
+	    greater = from_gt;
+	  }
+	else
+	  {
+	    path = abs.get_parent(h);
+	    child = get_ch(h, from_gt);
+	    if (read_error())
+	      return(null());
+	    set_ch(path, !from_gt, child);
+	    set_ch(h, from_gt, from_gt ? gh : lh);
+	    greater = !from_gt;
+	  }
+	set_ch(h, !from_gt, from_gt ? lh : gh);
+	set_bf(h, bf);
+      }
+
+    if (parent_rm == null())
+      set_root(h);
+    else
+      set_ch(parent_rm, rm_greater, h);
+
+    // Climb to the root using the parent links, rebalancing as necessary.
+    bool reduced_depth = true, path_greater;
+    handle parent;
+    while (path != null())
+      {
+	parent = abs.get_parent(path);
+	path_greater = false;
+	if (parent != null())
+	  path_greater = get_gt(parent) == path;
+	if (read_error())
+	  return(null());
+	update(path);
+	if (reduced_depth)
+	  {
+	    bf = get_bf(path) + (greater ? -1 : 1);
+	    if ((bf == -2) || (bf == 2))
+	      {
+		h = balance(path);
+		if (read_error())
+		  return(null());
+		bf = get_bf(h);
+		if (parent == null())
+		  set_root(h);
+		else
+		  set_ch(parent, path_greater, h);
+	      }
+	    else
+	      set_bf(path, bf);
+	    reduced_depth = (bf == 0);
+	  }
+	else if (!store_aug)
+	  // Nothing more to do.
+	  break;
+	path = parent;
+	greater = path_greater;
       }
 
     return(rm);
@@ -1095,18 +3201,24 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
     handle parent = null();
     int cmp, last_cmp;
 
+    /* Nodes above the substituted one, if store_node_aug is true. */
+    impl::avl_path<handle, max_depth, store_node_aug> path_h;
+    unsigned depth = 0;
+    search_node sn(abs, new_node);
+
     /* Search for node already in tree with same key. */
     for ( ; ; )
       {
 	if (h == null())
 	  /* No node in tree with same key as new node. */
 	  return(null());
-	cmp = cmp_n_n(new_node, h);
+	cmp = cmp_n_n(sn, h);
 	if (cmp == 0)
 	  /* Found the node to substitute new one for. */
 	  break;
 	last_cmp = cmp;
 	parent = h;
+	path_h.set(depth++, h);
 	h = cmp < 0 ? get_lt(h) : get_gt(h);
 	if (read_error())
 	  return(null());
@@ -1116,10 +3228,11 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
     set_lt(new_node, get_lt(h, false));
     set_gt(new_node, get_gt(h, false));
     set_bf(new_node, get_bf(h));
+    update(new_node);
 
     if (parent == null())
       /* New node is also new root. */
-      abs.root = new_node;
+      set_root(new_node);
     else
       {
 	/* Make parent point to new node. */
@@ -1129,21 +3242,243 @@ inline typename base_avl_tree<abstractor, max_depth, bset>::handle
 	  set_gt(parent, new_node);
       }
 
+    /* The new node's end or aggregate may differ from the old one's. */
+    update_path(path_h, depth);
+
+    return(h);
+  }
+
+template <class abstractor, unsigned max_depth, class bset>
+inline bool base_avl_tree<abstractor, max_depth, bset>::split(
+  key k, search_type st, base_avl_tree &rest)
+  {
+    sub_tree t, lt, gt, keep, other;
+    handle mid;
+    key_cmp cmp = { *this, search_key(abs, k) };
+
+    t.root = abs.root;
+    t.depth = calc_depth(t.root);
+    if (read_error())
+      return(false);
+
+    if (!split_sub(t, cmp, lt, mid, gt))
+      return(false);
+
+    if (st == EQUAL)
+      {
+	keep = empty_sub();
+	if (mid != null())
+	  keep = join_sub(keep, mid, keep);
+	other = join_sub(lt, gt);
+      }
+    else
+      {
+	if (mid != null())
+	  {
+	    // The node with key equal to k goes with the nodes less than
+	    // k for LESS_EQUAL and GREATER, with the nodes greater than
+	    // k for GREATER_EQUAL and LESS.
+	    if (!(st & LESS) == !(st & EQUAL))
+	      lt = join_sub(lt, mid, empty_sub());
+	    else
+	      gt = join_sub(empty_sub(), mid, gt);
+	  }
+	if (st & LESS)
+	  {
+	    keep = lt;
+	    other = gt;
+	  }
+	else
+	  {
+	    keep = gt;
+	    other = lt;
+	  }
+      }
+
+    if (read_error())
+      return(false);
+
+    set_root(keep.root);
+    rest.set_root(other.root);
+
+    return(true);
+  }
+
+template <class abstractor, unsigned max_depth, class bset>
+inline bool base_avl_tree<abstractor, max_depth, bset>::join(
+  base_avl_tree &tree_lt, base_avl_tree &tree_gt)
+  {
+    sub_tree lt, gt;
+
+    lt.root = tree_lt.abs.root;
+    lt.depth = calc_depth(lt.root);
+    gt.root = tree_gt.abs.root;
+    gt.depth = calc_depth(gt.root);
+    if (read_error())
+      return(false);
+
+    tree_lt.abs.root = null();
+    tree_gt.abs.root = null();
+
+    lt = join_sub(lt, gt);
+    if (read_error())
+      return(false);
+
+    set_root(lt.root);
+
+    return(true);
+  }
+
+template <class abstractor, unsigned max_depth, class bset>
+inline typename base_avl_tree<abstractor, max_depth, bset>::handle
+  base_avl_tree<abstractor, max_depth, bset>::select(size k)
+  {
+    handle h = abs.root;
+    size lt_size;
+
+    while (h != null())
+      {
+	lt_size = get_size(get_lt(h));
+	if (read_error())
+	  return(null());
+	if (k == lt_size)
+	  break;
+	if (k < lt_size)
+	  h = get_lt(h);
+	else
+	  {
+	    k -= lt_size + 1;
+	    h = get_gt(h);
+	  }
+	if (read_error())
+	  return(null());
+      }
+
     return(h);
   }
 
+template <class abstractor, unsigned max_depth, class bset>
+inline typename base_avl_tree<abstractor, max_depth, bset>::size
+  base_avl_tree<abstractor, max_depth, bset>::rank(key k, search_type st)
+  {
+    // Number of nodes with keys less than k, and number with key equal
+    // to k.
+    size num_lt = 0, num_eq = 0;
+
+    handle h = abs.root;
+    int cmp;
+    search_key sk(abs, k);
+
+    while (h != null())
+      {
+	cmp = cmp_k_n(sk, h);
+	if (cmp < 0)
+	  h = get_lt(h);
+	else
+	  {
+	    num_lt += get_size(get_lt(h));
+	    if (cmp == 0)
+	      {
+		num_eq = 1;
+		break;
+	      }
+	    num_lt++;
+	    h = get_gt(h);
+	  }
+	if (read_error())
+	  return(0);
+      }
+
+    if (st == EQUAL)
+      return(num_eq);
+
+    if (st & LESS)
+      return(num_lt + ((st & EQUAL) ? num_eq : 0));
+
+    return(num_nodes() - num_lt - ((st & EQUAL) ? 0 : num_eq));
+  }
+
+// A class for the bset template parameter of base_avl_tree that keeps
+// the bits in a single unsigned integer.  num_bits must not be more
+// than 64.  Bits are read and written with a shift and a mask, which
+// is faster than std::bitset with some compilers.
+//
+template <unsigned num_bits>
+class word_bset
+  {
+  public:
+
+    typedef typename impl::avl_bset_word<num_bits>::type word;
+
+    class bitref
+      {
+      public:
+
+	bitref(word &w_, word mask_) : w(w_), mask(mask_) { }
+
+	operator bool () const { return((w & mask) != 0); }
+
+	bitref & operator = (bool b)
+	  {
+	    // Branchless, -word(b) is all ones if b is true.
+	    w = (w & ~mask) | (-word(b) & mask);
+	    return(*this);
+	  }
+
+	bitref & operator = (const bitref &br)
+	  { return(*this = bool(br)); }
+
+      private:
+
+	word &w;
+	word mask;
+      };
+
+    // Initializing the bits costs next to nothing, and avoids warnings
+    // about use of an uninitialized value when a single bit is set.
+    word_bset() : bits(0) { }
+
+    bitref operator [] (unsigned index)
+      { return(bitref(bits, word(1) << index)); }
+
+    void set() { bits = ~word(0); }
+
+    void reset() { bits = 0; }
+
+  private:
+
+    word bits;
+  };
+
+namespace impl
+{
+
+// The default bset for avl_tree.
+//
+template <unsigned max_depth, bool fits_word = (max_depth <= 64)>
+struct avl_bset { typedef word_bset<max_depth> type; };
+
+template <unsigned max_depth>
+struct avl_bset<max_depth, false> { typedef std::bitset<max_depth> type; };
+
+} // end namespace impl
+
 // I tried to avoid having a separate base_avl_tree template by having
 // bitset<max_depth> be the default for the bset template, but Visual
-// C++ would not permit this.  It may possibly be desirable to use
-// base_avl_tree directly with an optimized version of bset.
+// C++ would not permit this.  avl_tree uses word_bset for the bset if
+// max_depth is 64 or less, otherwise std::bitset<max_depth>.  It may
+// possibly be desirable to use base_avl_tree directly with another
+// version of bset.
 //
 template <class abstractor, unsigned max_depth = 32>
 class avl_tree
-  : public base_avl_tree<abstractor, max_depth, std::bitset<max_depth> >
+  : public base_avl_tree<
+      abstractor, max_depth, typename impl::avl_bset<max_depth>::type>
   {
   public:
 
-    typedef base_avl_tree<abstractor, max_depth, std::bitset<max_depth> >
+    typedef base_avl_tree<
+	      abstractor, max_depth, typename impl::avl_bset<max_depth>::type>
       base;
 
     #if __cplusplus >= 201100
@@ -156,6 +156,12 @@ class bidir_list : public abstractor
           link(r, f, forward);
       }
 
+    // Removes the element after the element in_list (which must be in the
+    // list, and not the last element) in the given direction.
+    //
+    void remove_forward(handle in_list, bool is_forward = true)
+      { remove(link(in_list, is_forward)); }
+
     // FUTURE
     // void remove(handle first_in_list, handle last_in_list))
 
@@ -0,0 +1,1082 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_CONC_AVL_H_
+#define ABSTRACT_CONTAINER_CONC_AVL_H_
+
+// Concurrent AVL Tree, with Optimistic Lock-Free Searches.
+//
+// This is the relaxed-balance concurrent AVL tree of Bronson, Casper,
+// Chafi and Olukotun ("A Practical Concurrent Binary Search Tree", PPoPP
+// 2010), for intrusive nodes.  Any number of threads can search, insert
+// and remove concurrently.
+//
+// Searches take no locks.  Each node has a version number, which is
+// changed whenever a rotation could move keys out of the node's subtree
+// (a "shrink"), or the node is unlinked.  A search reads the version of
+// each node before following its child link, and validates it again
+// before going further down (hand-over-hand optimistic validation).  If
+// the validation fails, the search goes back up one level and retries.
+//
+// Writers lock only the nodes they change (always locking a parent before
+// its child).  Rebalancing is relaxed:  heights are repaired, and
+// rotations done, after an insert or remove, one node at a time, climbing
+// the parent links.  So the tree may briefly be out of balance.  A node
+// with two children that is removed is left in the tree as a "routing"
+// node (not present), until later changes let it be unlinked.
+//
+// Unlinked nodes may still be being read by other threads, so they are
+// passed to the abstractor's release() function only after every thread
+// has finished the operations that could have reached them (using
+// epoch-based reclamation, as in persist_avl.h).  Each thread keeps its
+// own lists of the nodes it unlinked, and releases them itself, so
+// removes do not contend on a shared lock.  Each thread using the tree
+// needs a thread_ctx instance.
+//
+// Requires C++11 or later.
+//
+// The abstractor class must have these public members, or equivalents:
+//
+//   // Types.
+//   handle -- a copyable type that can be stored in a std::atomic.
+//   key -- a copyable type.
+//
+//   // Returns the hook (links and other tree state) of the node h.
+//   conc_avl_hook<handle> & get_hook(handle h);
+//
+//   // Compare a key to the key of a node, or the keys of two nodes,
+//   // returning a negative, zero or positive value.
+//   int compare_key_node(key k, handle h);
+//   int compare_node_node(handle h1, handle h2);
+//
+//   // Returns the handle value that is never the handle of a node.
+//   handle null();
+//
+//   // Called when the node h (returned by remove()) is no longer
+//   // reachable by any thread, so its storage can be freed or reused.
+//   void release(handle h);
+//
+// The abstractor member functions are called concurrently from multiple
+// threads.
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <stdint.h>
+
+namespace abstract_container
+{
+
+// The part of each node used by conc_avl_tree.  Its members are only for
+// use by conc_avl_tree.
+template <typename handle>
+struct conc_avl_hook
+  {
+    std::atomic<handle> less, greater, parent;
+
+    std::atomic<uint64_t> version;
+
+    std::atomic<int> height;
+
+    // False if the node has been removed, but is still in the tree as a
+    // routing node.
+    std::atomic<bool> present;
+
+    std::atomic<bool> locked;
+
+    // Link in lists of unlinked nodes waiting to be released.
+    handle retired_next;
+  };
+
+template <class abstractor, unsigned max_threads = 64>
+class conc_avl_tree
+  {
+  public:
+
+    typedef typename abstractor::key key;
+    typedef typename abstractor::handle handle;
+    typedef conc_avl_hook<handle> hook;
+
+    // holder is the handle of a node that is not used for any key.  It
+    // holds the link to the root node.
+    explicit conc_avl_tree(handle holder_) : holder(holder_), epoch(0)
+      {
+	init(holder);
+	hk(holder).present.store(false);
+
+	for (unsigned i = 0; i < max_threads; ++i)
+	  {
+	    slot[i].store(0);
+	    slot_used[i].store(false);
+	    retired[i].count = 0;
+	    for (unsigned j = 0; j < 3; ++j)
+	      {
+		retired[i].list[j] = null();
+		retired[i].list_epoch[j] = 0;
+	      }
+	  }
+	for (unsigned i = 0; i < 3; ++i)
+	  limbo[i] = null();
+      }
+
+    // Releases the retired nodes, and the routing nodes still in the
+    // tree.  No other thread may be using the tree.
+    ~conc_avl_tree()
+      {
+	for (unsigned i = 0; i < 3; ++i)
+	  {
+	    release_list(limbo[i]);
+	    for (unsigned j = 0; j < max_threads; ++j)
+	      release_list(retired[j].list[i]);
+	  }
+	release_routing(ch(holder, true).load());
+      }
+
+    conc_avl_tree(const conc_avl_tree &) = delete;
+    conc_avl_tree & operator = (const conc_avl_tree &) = delete;
+
+    // Each thread using the tree must use its own instance of this
+    // class.  Each instance takes one of max_threads slots in the tree
+    // while it exists.
+    class thread_ctx
+      {
+      public:
+
+	explicit thread_ctx(conc_avl_tree &t)
+	  : tree(t), idx(max_threads), pin_count(0)
+	  {
+	    for (unsigned i = 0; i < max_threads; ++i)
+	      {
+		bool expected = false;
+		if (t.slot_used[i].compare_exchange_strong(expected, true))
+		  {
+		    idx = i;
+		    break;
+		  }
+	      }
+	  }
+
+	~thread_ctx()
+	  {
+	    if (valid())
+	      {
+		tree.orphan_retired(idx);
+		tree.slot[idx].store(0);
+		tree.slot_used[idx].store(false);
+	      }
+	  }
+
+	thread_ctx(const thread_ctx &) = delete;
+	thread_ctx & operator = (const thread_ctx &) = delete;
+
+	// Returns false if all the slots were taken when the instance was
+	// created.
+	bool valid() const { return(idx < max_threads); }
+
+	// While pinned, no node that the thread could reach is released.
+	// Each tree operation pins during the operation.  The thread must
+	// also pin around an operation (and its use of the handle the
+	// operation returns) to be sure the node is not released.  Calls
+	// can be nested.
+	void pin()
+	  {
+	    if (pin_count++ == 0)
+	      tree.slot[idx].store(tree.epoch.load() + 1);
+	  }
+
+	void unpin()
+	  {
+	    if (--pin_count == 0)
+	      tree.slot[idx].store(0);
+	  }
+
+      private:
+
+	friend class conc_avl_tree;
+
+	conc_avl_tree &tree;
+	unsigned idx, pin_count;
+      };
+
+    // Returns the handle of the node with key k, or null if there is no
+    // such node.
+    handle search(thread_ctx &ctx, key k)
+      {
+	handle res;
+
+	ctx.pin();
+	while (!attempt_search(k, holder, true, ver(holder).load(), res))
+	  ;
+	ctx.unpin();
+
+	return(res);
+      }
+
+    // Inserts the node h.  Returns h, or, if the tree already has a node
+    // with the same key, the handle of that node (and h is not inserted).
+    handle insert(thread_ctx &ctx, handle h)
+      {
+	handle res;
+
+	init(h);
+
+	ctx.pin();
+	while (!attempt_insert(ctx, h, holder, true, ver(holder).load(),
+			       res))
+	  ;
+	ctx.unpin();
+
+	return(res);
+      }
+
+    // Removes the node with key k, and returns its handle, or null if
+    // there is no such node.  The node may still be accessed by other
+    // threads, so it must only be freed by release().
+    handle remove(thread_ctx &ctx, key k)
+      {
+	handle res;
+
+	ctx.pin();
+	while (!attempt_remove(ctx, k, holder, true, ver(holder).load(),
+			       res))
+	  ;
+	ctx.unpin();
+
+	return(res);
+      }
+
+    // Tries to release all removed nodes that have been unlinked from the
+    // tree, by this thread or by threads whose thread_ctx no longer
+    // exists.  (Other threads release the nodes they unlinked as they
+    // continue to remove.)  Returns false if some could not be released,
+    // because some threads are pinned.  ctx must not be pinned.
+    bool reclaim(thread_ctx &ctx)
+      {
+	retired_t &rt = retired[ctx.idx];
+	bool res = true;
+	unsigned i;
+
+	{
+	  std::lock_guard<std::mutex> lg(reclaim_mtx);
+
+	  for (i = 0; i < 3; ++i)
+	    if (!try_advance())
+	      break;
+
+	  for (i = 0; i < 3; ++i)
+	    if (limbo[i] != null())
+	      res = false;
+	}
+
+	unsigned long long e = epoch.load();
+
+	for (i = 0; i < 3; ++i)
+	  if (rt.list[i] != null())
+	    {
+	      if ((rt.list_epoch[i] + 3) <= e)
+		release_list(rt.list[i]);
+	      else
+		res = false;
+	    }
+
+	return(res);
+      }
+
+    handle null() { return(abs.null()); }
+
+  protected:
+
+    abstractor abs;
+
+    handle holder;
+
+    // Version bits.  The rest of the version is a count of the shrinks.
+    static const uint64_t unlinked = 1, shrinking = 2, shrink_incr = 4;
+
+    // Returns of node_condition(), besides a new height.
+    enum { unlink_required = -1, rebalance_required = -2,
+	   nothing_required = -3 };
+
+    std::atomic<unsigned long long> epoch;
+
+    // For each thread slot, zero if the thread is not pinned, otherwise
+    // one more than the epoch when it pinned.
+    std::atomic<unsigned long long> slot[max_threads];
+
+    std::atomic<bool> slot_used[max_threads];
+
+    // Number of nodes a thread unlinks between its tries to advance
+    // the epoch.
+    static const unsigned advance_interval = 64;
+
+    // Lists of the nodes unlinked by the thread in a slot, linked with
+    // retired_next.  Only accessed by that thread.  The nodes unlinked in
+    // epoch e are in list[e % 3], and list_epoch[e % 3] is e.  A list can
+    // be released once the epoch is at least 3 more than its list_epoch.
+    struct retired_t
+      {
+	handle list[3];
+	unsigned long long list_epoch[3];
+	unsigned count;
+      };
+
+    retired_t retired[max_threads];
+
+    // Protects limbo and the advancing of epoch.
+    std::mutex reclaim_mtx;
+
+    // Lists of unlinked nodes, linked with retired_next, left by threads
+    // whose thread_ctx was destroyed.  The nodes unlinked in epoch e are
+    // in limbo[e % 3].
+    handle limbo[3];
+
+    hook & hk(handle h) { return(abs.get_hook(h)); }
+
+    std::atomic<handle> & ch(handle h, bool greater)
+      { return(greater ? hk(h).greater : hk(h).less); }
+
+    std::atomic<handle> & parent(handle h) { return(hk(h).parent); }
+
+    std::atomic<uint64_t> & ver(handle h) { return(hk(h).version); }
+
+    int height(handle h) { return(h == null() ? 0 : hk(h).height.load()); }
+
+    bool present(handle h) { return(hk(h).present.load()); }
+
+    void lock(handle h)
+      {
+	std::atomic<bool> &l = hk(h).locked;
+
+	while (l.exchange(true, std::memory_order_acquire))
+	  while (l.load(std::memory_order_relaxed))
+	    std::this_thread::yield();
+      }
+
+    void unlock(handle h)
+      { hk(h).locked.store(false, std::memory_order_release); }
+
+    void init(handle h)
+      {
+	hook &k = hk(h);
+
+	k.less.store(null());
+	k.greater.store(null());
+	k.parent.store(null());
+	k.version.store(0);
+	k.height.store(1);
+	k.present.store(true);
+	k.locked.store(false);
+      }
+
+    static int max(int a, int b) { return(a > b ? a : b); }
+
+    // Wait for a rotation that is shrinking the node h to finish.
+    void wait_not_shrinking(handle h)
+      {
+	while (ver(h).load() & shrinking)
+	  std::this_thread::yield();
+      }
+
+    // Searches for key k in the dir child subtree of node, whose version
+    // was node_ovl when the link from its parent to it was validated.
+    // Returns false if node has changed, so the search must be retried
+    // from its parent.  Otherwise res is set to the result.
+    bool attempt_search(key k, handle node, bool dir, uint64_t node_ovl,
+			handle &res)
+      {
+	handle child;
+	uint64_t child_ovl;
+	int c;
+
+	for ( ; ; )
+	  {
+	    child = ch(node, dir).load();
+	    if (ver(node).load() != node_ovl)
+	      return(false);
+	    if (child == null())
+	      {
+		res = null();
+		return(true);
+	      }
+	    c = abs.compare_key_node(k, child);
+	    if (c == 0)
+	      {
+		res = present(child) ? child : null();
+		return(true);
+	      }
+	    child_ovl = ver(child).load();
+	    if (child_ovl & shrinking)
+	      wait_not_shrinking(child);
+	    else if (!(child_ovl & unlinked) &&
+		     (ch(node, dir).load() == child))
+	      {
+		if (ver(node).load() != node_ovl)
+		  return(false);
+		if (attempt_search(k, child, c > 0, child_ovl, res))
+		  return(true);
+	      }
+	  }
+      }
+
+    // Same as attempt_search(), but inserts h.
+    bool attempt_insert(thread_ctx &ctx, handle h, handle node, bool dir,
+			uint64_t node_ovl, handle &res)
+      {
+	handle child, damaged;
+	uint64_t child_ovl;
+	int c;
+	bool done;
+
+	for ( ; ; )
+	  {
+	    child = ch(node, dir).load();
+	    if (ver(node).load() != node_ovl)
+	      return(false);
+	    if (child == null())
+	      {
+		lock(node);
+		if (ver(node).load() != node_ovl)
+		  {
+		    unlock(node);
+		    return(false);
+		  }
+		done = ch(node, dir).load() == null();
+		if (done)
+		  {
+		    parent(h).store(node);
+		    ch(node, dir).store(h);
+		    damaged = fix_height_nl(node);
+		  }
+		unlock(node);
+		if (done)
+		  {
+		    fix_height_and_rebalance(ctx, damaged);
+		    res = h;
+		    return(true);
+		  }
+		continue;
+	      }
+	    c = abs.compare_node_node(h, child);
+	    if (c == 0)
+	      {
+		if (present(child))
+		  {
+		    res = child;
+		    return(true);
+		  }
+		c = replace_routing(ctx, node, dir, node_ovl, child, h);
+		if (c < 0)
+		  return(false);
+		if (c > 0)
+		  {
+		    // Any repair that was pending at the routing node is
+		    // now pending at h.
+		    fix_height_and_rebalance(ctx, h);
+		    res = h;
+		    return(true);
+		  }
+		continue;
+	      }
+	    child_ovl = ver(child).load();
+	    if (child_ovl & shrinking)
+	      wait_not_shrinking(child);
+	    else if (!(child_ovl & unlinked) &&
+		     (ch(node, dir).load() == child))
+	      {
+		if (ver(node).load() != node_ovl)
+		  return(false);
+		if (attempt_insert(ctx, h, child, c > 0, child_ovl, res))
+		  return(true);
+	      }
+	  }
+      }
+
+    // Puts h in the place of the routing node child (the dir child of
+    // node) that has the same key.  Returns a negative value if node has
+    // changed, zero if this should be retried at node, or a positive
+    // value if h was inserted.
+    int replace_routing(
+      thread_ctx &ctx, handle node, bool dir, uint64_t node_ovl,
+      handle child, handle h)
+      {
+	handle gch;
+
+	lock(node);
+	if (ver(node).load() != node_ovl)
+	  {
+	    unlock(node);
+	    return(-1);
+	  }
+	if (ch(node, dir).load() != child)
+	  {
+	    unlock(node);
+	    return(0);
+	  }
+	lock(child);
+
+	// h must be locked before it is reachable through the parent links
+	// of the children, so that no rebalance under h is done until child
+	// is unlinked.
+	lock(h);
+
+	// child cannot be unlinked or shrunk (by a rotation) while node
+	// is locked.
+	gch = ch(child, false).load();
+	ch(h, false).store(gch);
+	if (gch != null())
+	  parent(gch).store(h);
+	gch = ch(child, true).load();
+	ch(h, true).store(gch);
+	if (gch != null())
+	  parent(gch).store(h);
+	hk(h).height.store(hk(child).height.load());
+	parent(h).store(node);
+	ch(node, dir).store(h);
+	ver(child).store(unlinked);
+
+	unlock(h);
+	unlock(child);
+	unlock(node);
+
+	retire(ctx, child);
+
+	return(1);
+      }
+
+    // Same as attempt_search(), but removes the node with key k.
+    bool attempt_remove(thread_ctx &ctx, key k, handle node, bool dir,
+			uint64_t node_ovl, handle &res)
+      {
+	handle child;
+	uint64_t child_ovl;
+	int c;
+
+	for ( ; ; )
+	  {
+	    child = ch(node, dir).load();
+	    if (ver(node).load() != node_ovl)
+	      return(false);
+	    if (child == null())
+	      {
+		res = null();
+		return(true);
+	      }
+	    c = abs.compare_key_node(k, child);
+	    if (c == 0)
+	      {
+		c = remove_node(ctx, node, dir, node_ovl, child);
+		if (c < 0)
+		  return(false);
+		if (c > 0)
+		  {
+		    res = c == 1 ? child : null();
+		    return(true);
+		  }
+		continue;
+	      }
+	    child_ovl = ver(child).load();
+	    if (child_ovl & shrinking)
+	      wait_not_shrinking(child);
+	    else if (!(child_ovl & unlinked) &&
+		     (ch(node, dir).load() == child))
+	      {
+		if (ver(node).load() != node_ovl)
+		  return(false);
+		if (attempt_remove(ctx, k, child, c > 0, child_ovl, res))
+		  return(true);
+	      }
+	  }
+      }
+
+    // Removes child, the dir child of node.  Returns a negative value if
+    // node has changed, zero if this should be retried at node, 1 if
+    // child was removed, or 2 if child was not present.
+    int remove_node(
+      thread_ctx &ctx, handle node, bool dir, uint64_t node_ovl,
+      handle child)
+      {
+	if (!present(child))
+	  return(2);
+
+	int res;
+
+	if ((ch(child, false).load() == null()) ||
+	    (ch(child, true).load() == null()))
+	  {
+	    // Unlink child.
+	    handle damaged = null();
+	    lock(node);
+	    if (ver(node).load() != node_ovl)
+	      res = -1;
+	    else if (ch(node, dir).load() != child)
+	      res = 0;
+	    else
+	      {
+		lock(child);
+		if (!present(child))
+		  res = 2;
+		else if (!attempt_unlink_nl(node, child))
+		  // It has two children now.
+		  res = 0;
+		else
+		  {
+		    damaged = fix_height_nl(node);
+		    res = 1;
+		  }
+		unlock(child);
+	      }
+	    unlock(node);
+	    if (res == 1)
+	      {
+		retire(ctx, child);
+		fix_height_and_rebalance(ctx, damaged);
+	      }
+	  }
+	else
+	  {
+	    // Make child a routing node.  Only child need be locked, since
+	    // child cannot be unlinked without locking it.
+	    lock(child);
+	    if (ver(child).load() & unlinked)
+	      res = 0;
+	    else if (!present(child))
+	      res = 2;
+	    else if ((ch(child, false).load() == null()) ||
+		     (ch(child, true).load() == null()))
+	      res = 0;
+	    else
+	      {
+		hk(child).present.store(false);
+		res = 1;
+	      }
+	    unlock(child);
+	  }
+
+	return(res);
+      }
+
+    // Unlinks the node n, which has no more than one child, from its
+    // parent.  Returns false if n is no longer a child of parent, or has
+    // two children.  parent and n must be locked.
+    bool attempt_unlink_nl(handle par, handle n)
+      {
+	handle par_lt = ch(par, false).load(), par_gt = ch(par, true).load();
+
+	if ((par_lt != n) && (par_gt != n))
+	  return(false);
+
+	handle lt = ch(n, false).load(), gt = ch(n, true).load();
+
+	if ((lt != null()) && (gt != null()))
+	  return(false);
+
+	handle splice = lt != null() ? lt : gt;
+
+	ch(par, par_lt != n).store(splice);
+	if (splice != null())
+	  parent(splice).store(par);
+
+	ver(n).store(unlinked);
+	hk(n).present.store(false);
+
+	return(true);
+      }
+
+    // Returns the height the node should have, or unlink_required,
+    // rebalance_required or nothing_required.
+    int node_condition(handle node)
+      {
+	handle lt = ch(node, false).load(), gt = ch(node, true).load();
+
+	if (((lt == null()) || (gt == null())) && !present(node))
+	  return(unlink_required);
+
+	int h_n = hk(node).height.load(), h_lt = height(lt),
+	    h_gt = height(gt), h_repl = 1 + max(h_lt, h_gt),
+	    bal = h_lt - h_gt;
+
+	if ((bal < -1) || (bal > 1))
+	  return(rebalance_required);
+
+	return(h_n != h_repl ? h_repl : int(nothing_required));
+      }
+
+    // Repairs the height of the locked node.  Returns the next node that
+    // may need repair, or null.
+    handle fix_height_nl(handle node)
+      {
+	int c = node_condition(node);
+
+	switch (c)
+	  {
+	  case rebalance_required:
+	  case unlink_required:
+	    return(node);
+
+	  case nothing_required:
+	    return(null());
+
+	  default:
+	    hk(node).height.store(c);
+	    return(parent(node).load());
+	  }
+      }
+
+    // Climb from the node, repairing heights, rebalancing and unlinking
+    // routing nodes, until no more repair is needed.
+    void fix_height_and_rebalance(thread_ctx &ctx, handle node)
+      {
+	handle n_parent, next, gone;
+	int c;
+	bool rotated;
+
+	while ((node != null()) && (parent(node).load() != null()))
+	  {
+	    c = node_condition(node);
+	    if ((c == nothing_required) || (ver(node).load() & unlinked))
+	      return;
+	    if ((c != unlink_required) && (c != rebalance_required))
+	      {
+		lock(node);
+		next = fix_height_nl(node);
+		unlock(node);
+		node = next;
+	      }
+	    else
+	      {
+		n_parent = parent(node).load();
+		gone = null();
+		next = node;
+		rotated = false;
+		lock(n_parent);
+		// The parent link of a node that was unlinked (or replaced,
+		// if it was a routing node) is not changed, so also check
+		// that node is still a child of n_parent.
+		if (!(ver(n_parent).load() & unlinked) &&
+		    (parent(node).load() == n_parent) &&
+		    ((ch(n_parent, false).load() == node) ||
+		     (ch(n_parent, true).load() == node)))
+		  {
+		    lock(node);
+		    next = rebalance_nl(n_parent, node, gone);
+		    unlock(node);
+		    rotated = (gone == null()) &&
+			      (ch(n_parent, false).load() != node) &&
+			      (ch(n_parent, true).load() != node);
+		  }
+		unlock(n_parent);
+		if (gone != null())
+		  retire(ctx, gone);
+		if (rotated && (next != null()) && (next != n_parent))
+		  {
+		    // A node below n_parent still needs repair.  The height
+		    // of n_parent was not repaired after the rotation, so
+		    // continue with it afterward.
+		    fix_height_and_rebalance(ctx, next);
+		    next = n_parent;
+		  }
+		node = next;
+	      }
+	  }
+      }
+
+    // n_parent and n are locked.  Returns the next node needing repair,
+    // or null.  If n is unlinked, gone is set to it.
+    handle rebalance_nl(handle n_parent, handle n, handle &gone)
+      {
+	handle lt = ch(n, false).load(), gt = ch(n, true).load();
+
+	if (((lt == null()) || (gt == null())) && !present(n))
+	  {
+	    if (attempt_unlink_nl(n_parent, n))
+	      {
+		gone = n;
+		return(fix_height_nl(n_parent));
+	      }
+	    return(n);
+	  }
+
+	int h_n = hk(n).height.load(), h_lt = height(lt),
+	    h_gt = height(gt), h_repl = 1 + max(h_lt, h_gt),
+	    bal = h_lt - h_gt;
+
+	if (bal > 1)
+	  return(rebalance_to(n_parent, n, false, lt, h_gt));
+	if (bal < -1)
+	  return(rebalance_to(n_parent, n, true, gt, h_lt));
+	if (h_repl != h_n)
+	  {
+	    hk(n).height.store(h_repl);
+	    return(fix_height_nl(n_parent));
+	  }
+	return(null());
+      }
+
+    // In these functions, the d side of the node n is deeper.  nd is
+    // the d child of n.  In names of nodes and heights, "d" refers to
+    // the d side, and "o" the other side.  n_parent and n are locked.
+
+    // Rebalances n, whose o subtree has height h_o.
+    handle rebalance_to(
+      handle n_parent, handle n, bool d, handle nd, int h_o)
+      {
+	handle res, ndo;
+	int h_dd, h_do;
+	bool nested = false;
+
+	lock(nd);
+	if ((hk(nd).height.load() - h_o) <= 1)
+	  // Retry.
+	  res = n;
+	else
+	  {
+	    ndo = ch(nd, !d).load();
+	    h_dd = height(ch(nd, d).load());
+	    h_do = height(ndo);
+	    if (h_dd >= h_do)
+	      res = rotate_nl(n_parent, n, d, nd, h_o, h_dd, ndo, h_do);
+	    else
+	      {
+		lock(ndo);
+		h_do = hk(ndo).height.load();
+		if (h_dd >= h_do)
+		  res = rotate_nl(n_parent, n, d, nd, h_o, h_dd, ndo, h_do);
+		else
+		  {
+		    int h_dod = height(ch(ndo, d).load()), b = h_dd - h_dod;
+		    if ((b >= -1) && (b <= 1))
+		      res = rotate_double_nl(
+			      n_parent, n, d, nd, h_o, h_dd, ndo, h_dod);
+		    else
+		      nested = true;
+		  }
+		unlock(ndo);
+		if (nested)
+		  // Rebalance nd first.  If necessary, n will be rebalanced
+		  // later.
+		  res = rebalance_to(n, nd, !d, ndo, h_dd);
+	      }
+	  }
+	unlock(nd);
+
+	return(res);
+      }
+
+    // Single rotation of nd up into the place of n.  nd is locked.
+    handle rotate_nl(
+      handle n_parent, handle n, bool d, handle nd, int h_o, int h_dd,
+      handle ndo, int h_do)
+      {
+	uint64_t n_ovl = ver(n).load();
+	bool par_dir = ch(n_parent, false).load() != n;
+
+	ver(n).store(n_ovl | shrinking);
+
+	ch(n, d).store(ndo);
+	if (ndo != null())
+	  parent(ndo).store(n);
+	ch(nd, !d).store(n);
+	parent(n).store(nd);
+	ch(n_parent, par_dir).store(nd);
+	parent(nd).store(n_parent);
+
+	int h_n_repl = 1 + max(h_do, h_o);
+	hk(n).height.store(h_n_repl);
+	hk(nd).height.store(1 + max(h_dd, h_n_repl));
+
+	ver(n).store(n_ovl + shrink_incr);
+
+	int bal_n = h_do - h_o;
+	if ((bal_n < -1) || (bal_n > 1))
+	  return(n);
+	if (((ndo == null()) || (h_o == 0)) && !present(n))
+	  return(n);
+	int bal_d = h_dd - h_n_repl;
+	if ((bal_d < -1) || (bal_d > 1))
+	  return(nd);
+	if ((h_dd == 0) && !present(nd))
+	  return(nd);
+	return(fix_height_nl(n_parent));
+      }
+
+    // Double rotation of ndo up into the place of n.  nd and ndo are
+    // locked.
+    handle rotate_double_nl(
+      handle n_parent, handle n, bool d, handle nd, int h_o, int h_dd,
+      handle ndo, int h_dod)
+      {
+	uint64_t n_ovl = ver(n).load(), nd_ovl = ver(nd).load();
+	bool par_dir = ch(n_parent, false).load() != n;
+	handle ndod = ch(ndo, d).load(), ndoo = ch(ndo, !d).load();
+	int h_doo = height(ndoo);
+
+	ver(n).store(n_ovl | shrinking);
+	ver(nd).store(nd_ovl | shrinking);
+
+	ch(n, d).store(ndoo);
+	if (ndoo != null())
+	  parent(ndoo).store(n);
+	ch(nd, !d).store(ndod);
+	if (ndod != null())
+	  parent(ndod).store(nd);
+	ch(ndo, d).store(nd);
+	parent(nd).store(ndo);
+	ch(ndo, !d).store(n);
+	parent(n).store(ndo);
+	ch(n_parent, par_dir).store(ndo);
+	parent(ndo).store(n_parent);
+
+	int h_n_repl = 1 + max(h_doo, h_o);
+	hk(n).height.store(h_n_repl);
+	int h_d_repl = 1 + max(h_dd, h_dod);
+	hk(nd).height.store(h_d_repl);
+	hk(ndo).height.store(1 + max(h_d_repl, h_n_repl));
+
+	ver(nd).store(nd_ovl + shrink_incr);
+	ver(n).store(n_ovl + shrink_incr);
+
+	int bal_n = h_doo - h_o;
+	if ((bal_n < -1) || (bal_n > 1))
+	  return(n);
+	if (((ndoo == null()) || (h_o == 0)) && !present(n))
+	  return(n);
+	// Unlike Bronson et al., the double rotation is done even if it
+	// leaves nd as a routing node with only one child, so that n is not
+	// left unbalanced.  nd is then unlinked.
+	if (((h_dd == 0) || (h_dod == 0)) && !present(nd))
+	  return(nd);
+	int bal_do = h_d_repl - h_n_repl;
+	if ((bal_do < -1) || (bal_do > 1))
+	  return(ndo);
+	return(fix_height_nl(n_parent));
+      }
+
+    // No lock is taken, except (if it is free) reclaim_mtx once every
+    // advance_interval calls, to try to advance the epoch.
+    void retire(thread_ctx &ctx, handle h)
+      {
+	retired_t &rt = retired[ctx.idx];
+	unsigned long long e = epoch.load();
+	unsigned i = unsigned(e % 3);
+
+	if (rt.list_epoch[i] != e)
+	  {
+	    // The list is from 3 or more epochs ago.
+	    release_list(rt.list[i]);
+	    rt.list_epoch[i] = e;
+	  }
+
+	hk(h).retired_next = rt.list[i];
+	rt.list[i] = h;
+
+	if (++rt.count == advance_interval)
+	  {
+	    rt.count = 0;
+	    if (reclaim_mtx.try_lock())
+	      {
+		try_advance();
+		reclaim_mtx.unlock();
+	      }
+	  }
+      }
+
+    // Moves the retired lists of a slot whose thread_ctx is being
+    // destroyed to limbo.
+    void orphan_retired(unsigned idx)
+      {
+	retired_t &rt = retired[idx];
+	std::lock_guard<std::mutex> lg(reclaim_mtx);
+	unsigned long long e = epoch.load();
+
+	for (unsigned i = 0; i < 3; ++i)
+	  {
+	    handle h = rt.list[i];
+
+	    if (h == null())
+	      continue;
+	    if ((rt.list_epoch[i] + 3) <= e)
+	      {
+		release_list(rt.list[i]);
+		continue;
+	      }
+	    while (hk(h).retired_next != null())
+	      h = hk(h).retired_next;
+
+	    // list_epoch[i] % 3 is i.
+	    hk(h).retired_next = limbo[i];
+	    limbo[i] = rt.list[i];
+	    rt.list[i] = null();
+	  }
+      }
+
+    // Releases the nodes in a list, and makes it empty.
+    void release_list(handle &list)
+      {
+	handle h = list, next;
+
+	list = null();
+	while (h != null())
+	  {
+	    next = hk(h).retired_next;
+	    abs.release(h);
+	    h = next;
+	  }
+      }
+
+    void release_routing(handle h)
+      {
+	if (h == null())
+	  return;
+
+	handle lt = ch(h, false).load(), gt = ch(h, true).load();
+
+	release_routing(lt);
+	release_routing(gt);
+	if (!present(h))
+	  abs.release(h);
+      }
+
+    // Advances the epoch, if every pinned thread pinned in the current
+    // epoch, and releases the nodes in limbo unlinked two epochs before
+    // the current one (see persist_avl.h).  reclaim_mtx must be locked.
+    // Returns false if the epoch could not be advanced.
+    bool try_advance()
+      {
+	unsigned long long e = epoch.load(), v;
+
+	for (unsigned i = 0; i < max_threads; ++i)
+	  {
+	    v = slot[i].load();
+	    if (v && (v != (e + 1)))
+	      return(false);
+	  }
+
+	epoch.store(e + 1);
+
+	release_list(limbo[(e + 1) % 3]);
+
+	return(true);
+      }
+  };
+
+} // end namespace abstract_container
+
+#endif /* Include once */
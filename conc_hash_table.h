@@ -0,0 +1,229 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_CONC_HASH_TABLE_H_
+#define ABSTRACT_CONTAINER_CONC_HASH_TABLE_H_
+
+// Concurrent Hash Table, with Lock Striping.
+//
+// A base_hash_table that any number of threads can search and change
+// concurrently.  The buckets are divided into stripes (bucket b is in
+// stripe b % num_stripes), each with its own lock.  search() takes a
+// shared lock of the stripe of the key's bucket, and insert(), remove()
+// and remove_key() take an exclusive lock.  So operations on buckets in
+// different stripes never wait for each other.  Each lock is in its own
+// cache line, so threads locking different stripes do not thrash the same
+// line.
+//
+// The lock_t parameter is the type of the stripe locks.  It must have
+// the members lock(), unlock(), lock_shared() and unlock_shared().  It
+// is normally conc_hash_spinlock (best when the table is not heavily
+// contended, as operations hold the lock very briefly), or
+// std::shared_mutex (lets searches of the same stripe run in parallel,
+// but is slower to lock).
+//
+// The abstractor has the same requirements as for base_hash_table.  Its
+// hash_key() and hash_elem() member functions are called without a lock
+// held, and so may be called concurrently.  is_key() and the list
+// operations are only called with the stripe lock held.
+//
+// The table does not control the lifetime of the elements.  A handle
+// returned by search() may refer to an element that another thread is
+// removing, so the threads must agree (for example, by only allowing the
+// thread that inserted an element to remove it) on when an element may
+// be reused.
+//
+// Requires C++17 or later.
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "hash_table.h"
+
+namespace abstract_container
+{
+
+// A spinlock, for use as the lock_t parameter of base_conc_hash_table.
+// Shared locks are exclusive.
+class conc_hash_spinlock
+  {
+  public:
+
+    conc_hash_spinlock() : locked(false) { }
+
+    conc_hash_spinlock(const conc_hash_spinlock &) = delete;
+
+    conc_hash_spinlock & operator = (const conc_hash_spinlock &) = delete;
+
+    void lock()
+      {
+        while (locked.exchange(true, std::memory_order_acquire))
+          while (locked.load(std::memory_order_relaxed))
+            std::this_thread::yield();
+      }
+
+    void unlock() { locked.store(false, std::memory_order_release); }
+
+    void lock_shared() { lock(); }
+
+    void unlock_shared() { unlock(); }
+
+  private:
+
+    std::atomic<bool> locked;
+  };
+
+template <class abstractor, class lock_t = conc_hash_spinlock,
+          unsigned num_stripes = 64>
+class base_conc_hash_table : protected base_hash_table<abstractor>
+  {
+  private:
+
+    typedef base_hash_table<abstractor> table;
+
+  protected:
+
+    typedef typename table::index index;
+
+  public:
+
+    typedef typename table::key key;
+    typedef typename table::handle handle;
+
+    template<typename ... args_t>
+    base_conc_hash_table(args_t && ... args)
+      : table(std::forward<args_t>(args)...) { }
+
+    base_conc_hash_table(const base_conc_hash_table &) = delete;
+
+    base_conc_hash_table & operator = (const base_conc_hash_table &) =
+      delete;
+
+    index hash_key(key k) { return(table::hash_key(k)); }
+
+    index hash_elem(handle h) { return(table::hash_elem(h)); }
+
+    void insert(handle h, index hash_value)
+      {
+        std::unique_lock<lock_t> ul(stripe_lock(hash_value));
+
+        table::insert(h, hash_value);
+      }
+
+    void insert(handle h) { insert(h, hash_elem(h)); }
+
+    // Returns null() if no element has key k.
+    handle search(key k, index hash_value)
+      {
+        std::shared_lock<lock_t> sl(stripe_lock(hash_value));
+
+        return(table::search(k, hash_value));
+      }
+
+    handle search(key k) { return(search(k, hash_key(k))); }
+
+    // Returns the handle of the removed element, or null() is no element
+    // has key k.
+    handle remove_key(key k, index hash_value)
+      {
+        std::unique_lock<lock_t> ul(stripe_lock(hash_value));
+
+        return(table::remove_key(k, hash_value));
+      }
+
+    handle remove_key(key k) { return(remove_key(k, hash_key(k))); }
+
+    // hash_value must be the hash value of the element.
+    void remove(handle h, index hash_value)
+      {
+        std::unique_lock<lock_t> ul(stripe_lock(hash_value));
+
+        table::remove(h, hash_value);
+      }
+
+    void remove(handle h)
+      { remove(h, table::stored_hash(h)); }
+
+    // Make the hash table empty.  Locks all the stripes.
+    void purge()
+      {
+        unsigned i;
+
+        for (i = 0; i < num_stripes; ++i)
+          stripe[i].lck.lock();
+
+        table::purge();
+
+        for (i = 0; i < num_stripes; ++i)
+          stripe[i].lck.unlock();
+      }
+
+    static handle null() { return(table::null()); }
+
+  protected:
+
+    // std::hardware_destructive_interference_size is not used, because it
+    // can vary with compiler tuning flags, and so would the layout of the
+    // table.
+
+    #if defined(DESTRUCTIVE_INTERFERENCE_SIZE)
+
+    // Allow for definition on command line.
+    static const std::size_t line_size = DESTRUCTIVE_INTERFERENCE_SIZE;
+
+    #else
+
+    // Guess, too big is better than too small.
+    static const std::size_t line_size = 128;
+
+    #endif
+
+    struct alignas(line_size) stripe_t
+      {
+        lock_t lck;
+      };
+
+    stripe_t stripe[num_stripes];
+
+    // Returns the lock for the stripe of the bucket for a hash value.
+    lock_t & stripe_lock(index hash_value)
+      {
+        if (table::store_hash)
+          hash_value %= table::num_hash_values;
+
+        return(stripe[hash_value % num_stripes].lck);
+      }
+  };
+
+// Abstractor parameter has same requirements as for the hash_table
+// template.
+//
+template <class abstractor, class lock_t = conc_hash_spinlock,
+          unsigned num_stripes = 64>
+using conc_hash_table =
+  base_conc_hash_table<impl::hash_table_abs<abstractor>, lock_t,
+                       num_stripes>;
+
+} // end namespace abstract_container
+
+#endif /* Include once */
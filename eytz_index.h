@@ -0,0 +1,303 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_EYTZ_INDEX_H_
+#define ABSTRACT_CONTAINER_EYTZ_INDEX_H_
+
+#include <utility>
+
+namespace abstract_container
+{
+
+#ifndef ABSTRACT_CONTAINER_SEARCH_TYPE_
+#define ABSTRACT_CONTAINER_SEARCH_TYPE_
+
+enum search_type
+  {
+    EQUAL = 1,
+    equal = 1,
+    LESS = 2,
+    less = 2,
+    GREATER = 4,
+    greater = 4,
+    LESS_EQUAL = equal | less,
+    less_equal = equal | less,
+    GREATER_EQUAL = equal | greater,
+    greater_equal = equal | greater
+  };
+
+#endif
+
+// Frozen (read-only) search index template, using the Eytzinger layout.
+//
+// The keys of a sorted sequence of nodes (such as the nodes of an AVL tree,
+// or any sequence that could be passed to the build() member function of
+// avl_tree) are copied into an array, in the order of a breadth-first
+// traversal of a complete binary search tree.  The first element of the
+// array is unused, and the children of the element at index i are at
+// indexes 2i and 2i + 1.  This layout makes the top levels of the tree
+// share cache lines, and allows the descendants of a node four levels
+// down to be prefetched (when the keys are 4 bytes) with a single cache
+// line fetch.  The search loop has no data-dependent branches.
+//
+// The caller provides the storage for the index, so there is no use of
+// new/delete.  The index is not changed by changes to the nodes it was
+// built from, it must be rebuilt.
+//
+// abstractor parameter class must have these public members, or
+// equivalents:
+//
+// Types:
+//
+// key -- a copyable type.  The index stores a copy of the key of each node.
+// handle -- a copyable type.
+// size -- an unsigned integral type.  It must be able to hold a value
+//   somewhat more than twice the maximum number of nodes in the index.
+//
+// Member functions:
+//
+// key get_key(handle) -- returns the key of the node with the given
+//   handle.  Only called when the index is built.
+// int compare_key_key(key k1, key k2) -- returns a negative, zero or
+//   positive value if k1 is less than, equal to or greater than k2.
+// handle null() -- returns the null handle value.
+//
+// If the template parameter use_prefetch is true, the search loop (when
+// compiled with GCC or Clang) prefetches the descendants of each node.
+//
+template <class abstractor, bool use_prefetch = true>
+class eytz_index
+  {
+  public:
+
+    typedef typename abstractor::key key;
+    typedef typename abstractor::handle handle;
+    typedef typename abstractor::size size;
+
+    #if __cplusplus >= 201100
+    template<typename ... args_t>
+    eytz_index(args_t && ... args) : abs(std::forward<args_t>(args)...)
+      { clear(); }
+    #else
+    eytz_index() { clear(); }
+    #endif
+
+    #if __cplusplus >= 201100
+
+    eytz_index(const eytz_index &) = delete;
+
+    eytz_index & operator = (const eytz_index &) = delete;
+
+    #endif
+
+    // Builds the index from the handles of num_nodes nodes, in ascending
+    // key order, by incrementing p.  keys and handles must point to
+    // arrays of at least num_nodes + 1 elements, that the index uses until
+    // it is rebuilt or cleared.
+    template<typename fwd_iter>
+    void build(key *keys, handle *handles, fwd_iter p, size num_nodes)
+      {
+	abs.keys = keys;
+	abs.handles = handles;
+	abs.num = num_nodes;
+
+	if (num_nodes == 0)
+	  return;
+
+	// Visit the elements of the array in the order of an in-order
+	// traversal of the implied tree, starting with the leftmost.
+	size i = 1;
+	while ((2 * i) <= num_nodes)
+	  i *= 2;
+
+	for (size j = 0; j < num_nodes; ++j)
+	  {
+	    handle h = *p;
+	    p++;
+	    keys[i] = abs.get_key(h);
+	    handles[i] = h;
+
+	    if (((2 * i) + 1) <= num_nodes)
+	      {
+		// Go to leftmost node of greater subtree.
+		i = (2 * i) + 1;
+		while ((2 * i) <= num_nodes)
+		  i *= 2;
+	      }
+	    else
+	      {
+		// Climb up from greater children, then up one more.
+		while (i & 1)
+		  i >>= 1;
+		i >>= 1;
+	      }
+	  }
+      }
+
+    // Builds the index from all the nodes in an AVL tree (or any class
+    // with a compatible iter member class).  Returns false if there was
+    // a read error, or the tree has more than max_nodes nodes.
+    template <class tree_t>
+    bool build_from_tree(
+      tree_t &tree, key *keys, handle *handles, size max_nodes)
+      {
+	typename tree_t::iter it;
+	size n = 0;
+
+	clear();
+
+	for (it.start_iter_least(tree); *it != abs.null(); it++)
+	  if (++n > max_nodes)
+	    return(false);
+	if (tree.read_error())
+	  return(false);
+
+	it.start_iter_least(tree);
+	build(keys, handles, it, n);
+
+	if (tree.read_error())
+	  {
+	    clear();
+	    return(false);
+	  }
+
+	return(true);
+      }
+
+    // Returns the handle of the node whose key is the best match for
+    // the given key and search type, or null if there is no such node.
+    // Uses the same search type semantics as avl_tree::search().
+    handle search(key k, search_type st = EQUAL)
+      {
+	// For LESS and GREATER_EQUAL, the search branches greater at nodes
+	// whose keys are less than k.  For LESS_EQUAL and GREATER, it
+	// branches greater at nodes whose keys are less than or equal to k.
+	// (EQUAL is done like GREATER_EQUAL, followed by a check that the
+	// key is equal.)
+	// (The two cases have separate loops, each comparing so that the
+	// result only depends on one relation between the keys, otherwise
+	// the compiler may generate a branch in the loop.)
+	size i = 1;
+
+	if ((st == LESS_EQUAL) || (st == GREATER))
+	  while (i <= abs.num)
+	    {
+	      prefetch(i);
+	      i = (2 * i) + (abs.compare_key_key(k, abs.keys[i]) >= 0);
+	    }
+	else
+	  while (i <= abs.num)
+	    {
+	      prefetch(i);
+	      i = (2 * i) + (abs.compare_key_key(abs.keys[i], k) < 0);
+	    }
+
+	// The bits of i now give the branches taken, the last in the low
+	// bit.  For LESS and LESS_EQUAL, the result is the last node where
+	// the greater branch was taken, otherwise the last node where the
+	// less branch was taken.
+	i = strip(i, (st & LESS) ? 1 : 0);
+
+	if (i == 0)
+	  return(abs.null());
+
+	if ((st == EQUAL) && (abs.compare_key_key(abs.keys[i], k) != 0))
+	  return(abs.null());
+
+	return(abs.handles[i]);
+      }
+
+    size num_nodes() { return(abs.num); }
+
+    bool is_empty() { return(abs.num == 0); }
+
+    void clear()
+      {
+	abs.keys = 0;
+	abs.handles = 0;
+	abs.num = 0;
+      }
+
+  protected:
+
+    // Create a class whose sole purpose is to take advantage of
+    // the "empty member" optimization.
+    struct abs_plus_data : public abstractor
+      {
+	// Arrays of keys and handles, in Eytzinger order, starting at
+	// index 1.
+	key *keys;
+	handle *handles;
+
+	// Number of nodes in the index.
+	size num;
+      };
+
+    abs_plus_data abs;
+
+    // Number of keys in a 64-byte cache line (as a power of 2).
+    static const size keys_per_line =
+      sizeof(key) > 32 ? 1 :
+      sizeof(key) > 16 ? 2 :
+      sizeof(key) > 8 ? 4 :
+      sizeof(key) > 4 ? 8 :
+      sizeof(key) > 2 ? 16 :
+      sizeof(key) > 1 ? 32 : 64;
+
+    // Prefetch the first descendant of node i, at the depth where the
+    // descendants fill a cache line.  The address may be past the end of
+    // the keys array, which is harmless for a prefetch.
+    void prefetch(size i)
+      {
+	#if defined(__GNUC__)
+	if (use_prefetch)
+	  __builtin_prefetch(abs.keys + (i * keys_per_line));
+	#else
+	(void) i;
+	#endif
+      }
+
+    // Shift bits off the bottom of i until the bit shifted off is 'bit'.
+    // (The high 1 bit of i, from the starting index of 1, guarantees
+    // this ends.)
+    static size strip(size i, unsigned bit)
+      {
+	#if defined(__GNUC__) && (__cplusplus >= 201100)
+	unsigned long long u = i;
+	if (bit == 0)
+	  u = ~u;
+	if (u == 0)
+	  return(0);
+	return(size(i >> (__builtin_ctzll(u) + 1)));
+	#else
+	while ((i & 1) != bit)
+	  {
+	    if (i == 0)
+	      return(0);
+	    i >>= 1;
+	  }
+	return(i >> 1);
+	#endif
+      }
+  };
+
+} // end namespace abstract_container
+
+#endif
@@ -24,10 +24,108 @@ SOFTWARE.
 #include <utility>
 
 #include "list.h"
+#include "bidir_list.h"
 
 namespace abstract_container
 {
 
+namespace impl
+{
+
+template <bool>
+struct hash_table_bool { };
+
+// value is true if the abstractor has get_hash and set_hash members.
+// They may be protected, so the check is done in a derived class.
+template <class abstractor>
+class hash_table_store_hash
+  {
+  private:
+
+    typedef char yes[1];
+    typedef char no[2];
+
+    template <unsigned> struct sfinae { };
+
+    struct probe : public abstractor
+      {
+        template <class a>
+        static yes & test(
+          sfinae<sizeof(&a::get_hash) + sizeof(&a::set_hash)> *);
+
+        template <class a>
+        static no & test(...);
+
+        static const bool value = sizeof(test<probe>(0)) == sizeof(yes);
+      };
+
+  public:
+
+    static const bool value = probe::value;
+  };
+
+// Base class of the hash table templates (derived from the abstractor).
+// Stores the hash value of each element, and checks it before calling
+// is_key(), if store_hash is true.  Otherwise, does not store the hash
+// value, and recomputes it when it is needed.
+template <class abstractor,
+          bool store_hash = hash_table_store_hash<abstractor>::value>
+class hash_table_hash : public abstractor
+  {
+  public:
+
+    #if __cplusplus >= 201100
+
+    template<typename ... args_t>
+    hash_table_hash(args_t && ... args)
+      : abstractor(std::forward<args_t>(args)...) { }
+
+    #endif
+
+  protected:
+
+    typedef typename abstractor::index index;
+    typedef typename abstractor::key key;
+    typedef typename abstractor::list::handle handle;
+
+    typedef hash_table_bool<store_hash> store_hash_tag;
+
+    bool is_key(key k, handle h) { return(abstractor::is_key(k, h)); }
+
+    // Checks the stored hash value (if any) before calling is_key().
+    bool is_key(key k, index hash_value, handle h)
+      {
+        return(same_hash(h, hash_value, store_hash_tag()) and is_key(k, h));
+      }
+
+    void set_hash(handle h, index hash_value)
+      { put_hash(h, hash_value, store_hash_tag()); }
+
+    // Returns the hash value of an element.
+    index stored_hash(handle h) { return(elem_hash(h, store_hash_tag())); }
+
+  private:
+
+    void put_hash(handle h, index hash_value, hash_table_bool<true>)
+      { abstractor::set_hash(h, hash_value); }
+
+    void put_hash(handle, index, hash_table_bool<false>) { }
+
+    index elem_hash(handle h, hash_table_bool<true>)
+      { return(abstractor::get_hash(h)); }
+
+    index elem_hash(handle h, hash_table_bool<false>)
+      { return(abstractor::hash_elem(h)); }
+
+    bool same_hash(handle h, index hash_value, hash_table_bool<true>)
+      { return(abstractor::get_hash(h) == hash_value); }
+
+    bool same_hash(handle, index, hash_table_bool<false>)
+      { return(true); }
+  };
+
+} // end namespace impl
+
 // Base abstract hash table template.
 //
 // abstractor parameter class must have these public members, or equivalents:
@@ -35,7 +133,11 @@ namespace abstract_container
 // Types:
 //
 // list -- normally an instantiation of the abstract_container::list type.
-//   Must have the members handle, start, push, remove, link, null, purge.
+//   Must have the members handle, start, push, pop, remove, remove_forward,
+//   link, null, purge.  With list, remove(handle) is linear in the length
+//   of the bucket.  With an instantiation of bidir_list (which needs an
+//   additional link in each element), it is constant time.  (See the
+//   bidir_hash_table template below.)
 // index -- an integral type.
 // key -- some copyable type.
 //
@@ -58,11 +160,28 @@ namespace abstract_container
 // static const index num_hash_values -- the maximum number of hash values
 //   of keys (with zero being the minimum).
 //
+// Optionally, the abstractor may store the hash value of each element in
+// the element, by having these members:
+//
+// void set_hash(handle, index) -- stores a hash value in an element.
+// index get_hash(handle) -- returns the hash value stored in an element.
+//
+// In this case, hash_key() and hash_elem() may return any value of type
+// index (the bucket used is the hash value modulo num_hash_values).  The
+// hash value is stored in each element when it is inserted.  search()
+// and remove_key() only call is_key() for elements with the same hash
+// value as the key, and remove(handle) does not call hash_elem().  This
+// is worthwhile when keys are long, so that comparing and hashing them
+// is expensive.  With bidir_list buckets as well, remove(handle) does
+// no hashing or searching.
+//
 template <class abstractor>
-class base_hash_table : public abstractor
+class base_hash_table : public impl::hash_table_hash<abstractor>
   {
   protected:
 
+    typedef impl::hash_table_hash<abstractor> hash_store;
+
     typedef typename abstractor::list list;
     typedef typename abstractor::index index;
 
@@ -75,7 +194,7 @@ class base_hash_table : public abstractor
 
     template<typename ... args_t>
     base_hash_table(args_t && ... args)
-      : abstractor(std::forward<args_t>(args)...) { }
+      : hash_store(std::forward<args_t>(args)...) { }
 
     base_hash_table(const base_hash_table &) = delete;
 
@@ -94,17 +213,21 @@ class base_hash_table : public abstractor
     index hash_elem(handle h) { return(abstractor::hash_elem(h)); }
 
     void insert(handle h, index hash_value)
-      { bucket(hash_value).push(h); }
+      {
+        set_hash(h, hash_value);
+
+        hv_bucket(hash_value).push(h);
+      }
 
     void insert(handle h) { insert(h, hash_elem(h)); }
 
     // Returns null() if no element has key k.
     handle search(key k, index hash_value)
       {
-        list &b = bucket(hash_value);
+        list &b = hv_bucket(hash_value);
         handle h = b.start();
 
-        while ((h != null()) and !is_key(k, h))
+        while ((h != null()) and !is_key(k, hash_value, h))
           h = b.link(h);
 
         return(h);
@@ -114,13 +237,13 @@ class base_hash_table : public abstractor
 
     // Returns the handle of the removed element, or null() is no element
     // has key k.
-    handle remove_key(key k)
+    handle remove_key(key k, index hash_value)
       {
-        list &b = bucket(hash_key(k));
+        list &b = hv_bucket(hash_value);
         handle h = b.start();
         handle h_last = null();
 
-        while ((h != null()) and !is_key(k, h))
+        while ((h != null()) and !is_key(k, hash_value, h))
           {
             h_last = h;
             h = b.link(h);
@@ -137,7 +260,13 @@ class base_hash_table : public abstractor
         return(h);
       }
 
-    void remove(handle h) { bucket(hash_elem(h)).remove(h); }
+    handle remove_key(key k) { return(remove_key(k, hash_key(k))); }
+
+    // hash_value must be the hash value of the element.
+    void remove(handle h, index hash_value)
+      { hv_bucket(hash_value).remove(h); }
+
+    void remove(handle h) { remove(h, stored_hash(h)); }
 
     // Make the hash table empty.
     void purge()
@@ -210,9 +339,25 @@ class base_hash_table : public abstractor
 
     static const index num_hash_values = abstractor::num_hash_values;
 
+    static const bool store_hash =
+      impl::hash_table_store_hash<abstractor>::value;
+
+    using hash_store::is_key;
+    using hash_store::set_hash;
+    using hash_store::stored_hash;
+
     list & bucket(index hash_value) { return(abstractor::bucket(hash_value)); }
 
-    bool is_key(key k, handle h) { return(abstractor::is_key(k, h)); }
+    // Returns the bucket for a hash value (which is not reduced if hash
+    // values are not stored).
+    list & hv_bucket(index hash_value)
+      {
+        if (store_hash)
+          hash_value %= num_hash_values;
+
+        return(bucket(hash_value));
+      }
+
   };
 
 namespace impl
@@ -247,6 +392,61 @@ class hash_table : public base_hash_table<impl::hash_table_abs<abstractor> >
   { };
 #endif
 
+namespace impl
+{
+
+template <class abstractor>
+class bidir_hash_table_abs : public abstractor
+  {
+  private:
+
+    struct list_abs
+      {
+        typedef typename abstractor::handle handle;
+
+        static handle null() { return(abstractor::null()); }
+
+        static handle link(handle h, bool is_forward)
+          { return(bidir_hash_table_abs::link(h, is_forward)); }
+
+        static void link(handle h, handle link_h, bool is_forward)
+          { bidir_hash_table_abs::link(h, link_h, is_forward); }
+      };
+
+  protected:
+
+    typedef bidir_list<list_abs> list;
+  };
+
+}
+
+// Hash table with bidir_list buckets, so that remove(handle) takes
+// constant time (if hash values are stored in the elements, or
+// hash_elem() takes constant time).  The abstractor parameter has the
+// same requirements as for the hash_table template, except that it has
+// no list member type.  Instead, it has the members that the abstractor
+// parameter of bidir_list must have (with null() and both link()
+// members static):
+//
+// type handle
+// static handle null()
+// static handle link(handle h, bool is_forward)
+// static void link(handle h, handle link_h, bool is_forward)
+//
+// It may also have get_hash() and set_hash() members, to store the hash
+// value in each element.
+//
+#if __cplusplus >= 201100
+template <class abstractor>
+using bidir_hash_table =
+  hash_table<impl::bidir_hash_table_abs<abstractor> >;
+#else
+template <class abstractor>
+class bidir_hash_table :
+  public hash_table<impl::bidir_hash_table_abs<abstractor> >
+  { };
+#endif
+
 } // end namespace abstract_container
 
 #endif /* Include once */
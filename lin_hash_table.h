@@ -0,0 +1,459 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_LIN_HASH_TABLE_H_
+#define ABSTRACT_CONTAINER_LIN_HASH_TABLE_H_
+
+#include <utility>
+
+#include "list.h"
+#include "hash_table.h"
+
+namespace abstract_container
+{
+
+namespace impl
+{
+
+// Returns the floor of the base 2 log of x, which must not be zero.
+template <typename index>
+inline unsigned lin_hash_log2(index x)
+  {
+    #if defined(__GNUC__) && (__cplusplus >= 201100)
+
+    return(unsigned(63 - __builtin_clzll((unsigned long long)(x))));
+
+    #else
+
+    unsigned result = 0;
+
+    while (x >>= 1)
+      ++result;
+
+    return(result);
+
+    #endif
+  }
+
+} // end namespace impl
+
+// Growable hash table, using linear hashing.
+//
+// The number of buckets grows (and shrinks) one bucket at a time.  When
+// the average number of elements per bucket exceeds the load factor, one
+// bucket is split into two, moving about half its elements into a new
+// bucket at the end of the table.  So each insert or remove does (on
+// average) a small, bounded amount of rehashing, rather than rehashing the
+// whole table at once.  The buckets are kept in segments, each twice the
+// size of the previous one, so existing buckets are never moved.
+//
+// abstractor parameter class must have these public members, or equivalents:
+//
+// Types:
+//
+// list -- normally an instantiation of the abstract_container::list type.
+//   Must have the members handle, start, push, pop, remove,
+//   remove_forward, link, null, purge, empty.  remove(handle) is constant
+//   time if it is an instantiation of bidir_list (see base_hash_table).
+// index -- an unsigned integral type.
+// key -- some copyable type.
+//
+// Member functions:
+//
+// index hash_key(key) -- returns the hash value of the given key.  All
+//   the bits of the hash value are used (as the table grows), so it should
+//   not be reduced modulo some table size.
+// index hash_elem(handle) -- returns hash value of the key of the list
+//   element associated with the given handle.  Each list element placed into
+//   the hash table must be associated with a unique handle value, and a
+//   unique key value.
+// bool is_key(key, handle) -- returns true if the first parameter is
+//   the key of the element whose handle is the second parameter.
+// list * alloc_buckets(index n) -- returns a pointer to an array of n
+//   lists, which need not be in the empty state.  Returns 0 if the array
+//   cannot be allocated (in which case the table does not grow, and its
+//   chains get longer).
+// void free_buckets(list *b, index n) -- frees an array of n lists returned
+//   by alloc_buckets().
+//
+// Optionally, as for base_hash_table:
+//
+// void set_hash(handle, index) -- stores a hash value in an element.
+// index get_hash(handle) -- returns the hash value stored in an element.
+//
+// In which case hash_elem() is not called when splitting or merging
+// buckets, or by remove(handle), and is_key() is only called for elements
+// with the same hash value as the key.
+//
+// Static constants:
+//
+// static const index min_buckets -- the initial (and minimum) number of
+//   buckets, which must be a power of 2.  These buckets are part of the
+//   table object.
+// static const index load_factor -- the maximum average number of elements
+//   per bucket.  Buckets are merged when the average falls below a quarter
+//   of it.  It must be at least 1.
+//
+template <class abstractor>
+class lin_hash_table : public impl::hash_table_hash<abstractor>
+  {
+  protected:
+
+    typedef impl::hash_table_hash<abstractor> hash_store;
+
+    typedef typename abstractor::list list;
+    typedef typename abstractor::index index;
+
+  public:
+
+    typedef typename abstractor::key key;
+    typedef typename list::handle handle;
+
+    #if __cplusplus >= 201100
+
+    template<typename ... args_t>
+    lin_hash_table(args_t && ... args)
+      : hash_store(std::forward<args_t>(args)...) { init(); }
+
+    lin_hash_table(const lin_hash_table &) = delete;
+
+    lin_hash_table & operator = (const lin_hash_table &) = delete;
+
+    #else
+
+    lin_hash_table() { init(); }
+
+    #endif
+
+    ~lin_hash_table() { free_segments(); }
+
+    index hash_key(key k) { return(abstractor::hash_key(k)); }
+
+    index hash_elem(handle h) { return(abstractor::hash_elem(h)); }
+
+    void insert(handle h, index hash_value)
+      {
+        set_hash(h, hash_value);
+
+        bucket(address(hash_value)).push(h);
+
+        if (++num_elems > (load_factor * num_buckets()))
+          split();
+      }
+
+    void insert(handle h) { insert(h, hash_elem(h)); }
+
+    // Returns null() if no element has key k.
+    handle search(key k, index hash_value)
+      {
+        list &b = bucket(address(hash_value));
+        handle h = b.start();
+
+        while ((h != null()) and !is_key(k, hash_value, h))
+          h = b.link(h);
+
+        return(h);
+      }
+
+    handle search(key k) { return(search(k, hash_key(k))); }
+
+    // Returns the handle of the removed element, or null() is no element
+    // has key k.
+    handle remove_key(key k)
+      {
+        index hash_value = hash_key(k);
+        list &b = bucket(address(hash_value));
+        handle h = b.start();
+        handle h_last = null();
+
+        while ((h != null()) and !is_key(k, hash_value, h))
+          {
+            h_last = h;
+            h = b.link(h);
+          }
+
+        if (h != null())
+          {
+            if (h_last == null())
+              b.pop();
+            else
+              b.remove_forward(h_last);
+
+            removed();
+          }
+
+        return(h);
+      }
+
+    void remove(handle h)
+      {
+        bucket(address(stored_hash(h))).remove(h);
+
+        removed();
+      }
+
+    // Make the hash table empty, with the minimum number of buckets.
+    void purge()
+      {
+        free_segments();
+        init();
+      }
+
+    static handle null() { return(list::null()); }
+
+    // Number of elements in the table.
+    index size() { return(num_elems); }
+
+    index num_buckets() { return(round_buckets + split_next); }
+
+    // Note:  inserting or removing an element may split or merge buckets,
+    // which invalidates all iterators.
+    //
+    class iter
+      {
+      public:
+
+        void start_iter(lin_hash_table &ht_)
+          {
+            ht = &ht_;
+
+            hv = index(0) - 1;
+            curr_h = lin_hash_table::null();
+
+            advance();
+          }
+
+        iter(lin_hash_table &ht_) { start_iter(ht_); }
+
+        // Returns handle of element currently referenced by iterator, or
+        // null() if the iterator is past the last element (if any).
+        //
+        handle operator * () { return(curr_h); }
+
+        operator bool () { return(curr_h != lin_hash_table::null()); }
+
+        lin_hash_table & table() { return(*ht); }
+
+        void operator ++ () { advance(); }
+
+        void operator ++ (int) { ++(*this); }
+
+      protected:
+
+        // Hash table being iterated over.
+        lin_hash_table *ht;
+
+        // Index of current bucket.
+        index hv;
+
+        // Handle of current element.
+        handle curr_h;
+
+        void advance()
+          {
+            if (curr_h != lin_hash_table::null())
+              curr_h = ht->bucket(hv).link(curr_h);
+
+            while (curr_h == lin_hash_table::null())
+              {
+                if (++hv >= ht->num_buckets())
+                  break;
+
+                curr_h = ht->bucket(hv).start();
+              }
+          }
+      };
+
+  protected:
+
+    static const index min_buckets = abstractor::min_buckets;
+
+    static const index load_factor = abstractor::load_factor;
+
+    static const unsigned max_segments = 8 * sizeof(index);
+
+    using hash_store::is_key;
+    using hash_store::set_hash;
+    using hash_store::stored_hash;
+
+    // Returns the bucket with the given index.  Segment 0 has min_buckets
+    // buckets.  Segment s (for s > 0) has min_buckets * 2 ** (s - 1).
+    list & bucket(index b)
+      {
+        if (b < min_buckets)
+          return(seg0[b]);
+
+        unsigned s = impl::lin_hash_log2(index(b / min_buckets)) + 1;
+
+        return(segment[s][b - (min_buckets << (s - 1))]);
+      }
+
+    // Returns the index of the bucket for a hash value.
+    index address(index hash_value)
+      {
+        index b = hash_value & (round_buckets - 1);
+
+        if (b < split_next)
+          // Bucket b has already been split in this round.
+          b = hash_value & ((round_buckets << 1) - 1);
+
+        return(b);
+      }
+
+  private:
+
+    list seg0[min_buckets];
+
+    // Segments of buckets after the first min_buckets.  segment[0] is
+    // not used.
+    list *segment[max_segments];
+
+    // Number of segments (including segment 0).
+    unsigned num_segments;
+
+    // Number of buckets at the start of the current round of splits.
+    // Buckets 0 to round_buckets - 1 are split, in order, doubling the
+    // number of buckets by the end of the round.
+    index round_buckets;
+
+    // The next bucket to split.
+    index split_next;
+
+    index num_elems;
+
+    void init()
+      {
+        for (index i = 0; i < min_buckets; ++i)
+          seg0[i].purge();
+
+        num_segments = 1;
+        round_buckets = min_buckets;
+        split_next = 0;
+        num_elems = 0;
+      }
+
+    void free_segments()
+      {
+        while (num_segments > 1)
+          {
+            --num_segments;
+            abstractor::free_buckets(
+              segment[num_segments], min_buckets << (num_segments - 1));
+          }
+      }
+
+    // Split bucket split_next, adding one bucket to the table.
+    void split()
+      {
+        if (split_next == 0)
+          {
+            // Starting a new round, so a new segment is needed, with
+            // round_buckets buckets.
+            if ((num_segments == max_segments) or
+                ((round_buckets << 1) == 0))
+              return;
+
+            list *seg = abstractor::alloc_buckets(round_buckets);
+
+            if (!seg)
+              return;
+
+            segment[num_segments++] = seg;
+          }
+
+        list &from = bucket(split_next);
+        list &to = bucket(split_next + round_buckets);
+        handle h = from.start();
+        handle h_last = null();
+
+        to.purge();
+
+        while (h != null())
+          {
+            handle next = from.link(h);
+
+            if (stored_hash(h) & round_buckets)
+              {
+                if (h_last == null())
+                  from.pop();
+                else
+                  from.remove_forward(h_last);
+
+                to.push(h);
+              }
+            else
+              h_last = h;
+
+            h = next;
+          }
+
+        if (++split_next == round_buckets)
+          {
+            round_buckets <<= 1;
+            split_next = 0;
+          }
+      }
+
+    // Merge the last bucket into the bucket it was split from, removing
+    // one bucket from the table.  Returns false if the table already has
+    // the minimum number of buckets.
+    bool merge()
+      {
+        if (split_next == 0)
+          {
+            if (round_buckets == min_buckets)
+              return(false);
+
+            round_buckets >>= 1;
+            split_next = round_buckets;
+          }
+
+        --split_next;
+
+        list &from = bucket(split_next + round_buckets);
+        list &to = bucket(split_next);
+
+        while (!from.empty())
+          to.push(from.pop());
+
+        if (split_next == 0)
+          {
+            // The last segment is now unused.
+            --num_segments;
+            abstractor::free_buckets(segment[num_segments], round_buckets);
+          }
+
+        return(true);
+      }
+
+    // Each removal can require merging up to (4 / load_factor) + 1
+    // buckets, to keep the average above a quarter of the load factor.
+    void removed()
+      {
+        --num_elems;
+
+        while (((4 * num_elems) < (load_factor * num_buckets())) and merge())
+          ;
+      }
+  };
+
+} // end namespace abstract_container
+
+#endif /* Include once */
@@ -0,0 +1,405 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_MMAP_AVL_H_
+#define ABSTRACT_CONTAINER_MMAP_AVL_H_
+
+// AVL Tree Stored in a Memory-Mapped File.
+//
+// The nodes of the tree are records in a file that is mapped into memory
+// (using POSIX mmap()).  Handles are byte offsets of the records from the
+// start of the file, so they remain valid when the file is mapped at a
+// different address.  The handle of the root node is kept in a header at
+// the start of the file.  So, a tree can be reopened in O(1) time, with
+// no need to rebuild it.
+//
+// The file also serves as the storage allocator for the nodes (so records
+// can be allocated and freed without any use of new/delete).  The file is
+// enlarged (doubling the number of records) as needed.
+
+#include <stdint.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "avl_tree.h"
+
+namespace abstract_container
+{
+
+template <class traits, unsigned max_depth>
+class mmap_avl_tree;
+
+// Abstractor for avl_tree, for nodes in a memory-mapped file.
+//
+// traits parameter class must have these public members, or equivalents:
+//
+// Types:
+//
+// key -- a copyable type.
+// value -- the type of the data stored in each node.  It must be trivially
+//   copyable (memcpy-able), and it should not contain any pointers (since
+//   they will not be valid when the file is reopened).
+//
+// Member functions:
+//
+// int compare_key_value(key k, const value &v) -- returns a negative,
+//   zero or positive value if k is less than, equal to or greater than the
+//   key of v.
+// int compare_value_value(const value &v1, const value &v2) -- returns a
+//   negative, zero or positive value if the key of v1 is less than, equal
+//   to or greater than the key of v2.
+//
+template <class traits>
+class mmap_avl_abs
+  {
+  public:
+
+    typedef uint64_t handle;
+    typedef uint64_t size;
+    typedef typename traits::key key;
+    typedef typename traits::value value;
+
+    // Record for a node in the file.
+    struct node
+      {
+	handle lt, gt;
+	signed char bf;
+	value val;
+      };
+
+    handle get_less(handle h, bool access)
+      { return(check(nd(h).lt, access)); }
+    void set_less(handle h, handle lh) { nd(h).lt = lh; }
+
+    handle get_greater(handle h, bool access)
+      { return(check(nd(h).gt, access)); }
+    void set_greater(handle h, handle gh) { nd(h).gt = gh; }
+
+    int get_balance_factor(handle h) { return(nd(h).bf); }
+    void set_balance_factor(handle h, int bf) { nd(h).bf = bf; }
+
+    int compare_key_node(key k, handle h)
+      { return(traits::compare_key_value(k, nd(h).val)); }
+
+    int compare_node_node(handle h1, handle h2)
+      { return(traits::compare_value_value(nd(h1).val, nd(h2).val)); }
+
+    // Offset 0 is the header, so it cannot be the offset of a node.
+    static handle null() { return(0); }
+
+    // Returns true if a link to a node outside the file was found.  This
+    // means the file is corrupt.
+    bool read_error() { return(error); }
+
+    mmap_avl_abs() : base(0), map_size(0), fd(-1), error(false) { }
+
+    // Returns the value stored in a node.  Only valid until a node is
+    // allocated, since the file may be remapped at a different address.
+    value & val(handle h) { return(nd(h).val); }
+
+    // Returns the handle of a newly allocated node, or null if the file
+    // could not be enlarged, or the list of free records is corrupt (in
+    // which case read_error() returns true).
+    handle alloc()
+      {
+	header &hdr = hd();
+	handle h;
+
+	if (hdr.free_list != null())
+	  {
+	    h = check(hdr.free_list, true);
+	    if (error)
+	      return(null());
+	    handle next = check(nd(h).lt, true);
+	    if (error)
+	      return(null());
+	    hdr.free_list = next;
+	    return(h);
+	  }
+
+	if (hdr.num_used == hdr.capacity)
+	  if (!remap(hdr.capacity * 2))
+	    return(null());
+
+	header &hdr2 = hd();
+	h = header_size + (hdr2.num_used++ * sizeof(node));
+
+	return(h);
+      }
+
+    // Free a node (that is not in the tree), so its record can be reused.
+    void free(handle h)
+      {
+	nd(h).lt = hd().free_list;
+	hd().free_list = h;
+      }
+
+  protected:
+
+    template <class, unsigned>
+    friend class mmap_avl_tree;
+
+    struct header
+      {
+	uint64_t magic;
+
+	// Size of a node record, to check that the file was created for
+	// the same value type.
+	uint64_t node_size;
+
+	handle root;
+
+	// List of free records, linked by the lt field.
+	handle free_list;
+
+	// Number of records that have been allocated (including ones that
+	// are now free), and number there is space for in the file.
+	size num_used, capacity;
+      };
+
+    // "AVL_MMAP" in ASCII.
+    static const uint64_t magic_value =
+      (uint64_t(0x41564c5f) << 32) | uint64_t(0x4d4d4150);
+
+    // The header takes a cache line, so the records are cache aligned.
+    static const size header_size = (sizeof(header) + 63) & ~size(63);
+
+    char *base;
+    size map_size;
+    int fd;
+    bool error;
+
+    node & nd(handle h) { return(*reinterpret_cast<node *>(base + h)); }
+
+    header & hd() { return(*reinterpret_cast<header *>(base)); }
+
+    // A link is valid if it is the offset of the start of a record that
+    // has been allocated.
+    handle check(handle h, bool access)
+      {
+	if (access && (h != null()) &&
+	    ((h < header_size) ||
+	     (h >= (header_size + (hd().num_used * sizeof(node)))) ||
+	     (((h - header_size) % sizeof(node)) != 0)))
+	  {
+	    error = true;
+	    return(null());
+	  }
+	return(h);
+      }
+
+    // Change the file to have space for capacity records, and map the
+    // whole file.  Returns false on failure.
+    bool remap(size capacity)
+      {
+	size new_size = header_size + (capacity * sizeof(node));
+
+	if (ftruncate(fd, off_t(new_size)) != 0)
+	  return(false);
+
+	// Map the enlarged file before unmapping it at the old address, so
+	// the old mapping is still usable if this fails.
+	void *p = mmap(0, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED)
+	  return(false);
+
+	munmap(base, map_size);
+	base = static_cast<char *>(p);
+	map_size = new_size;
+	hd().capacity = capacity;
+
+	return(true);
+      }
+
+    // Opens the file, creating it if it does not exist, with space for
+    // initial_capacity records.  Returns false on failure.
+    bool open_file(const char *path, size initial_capacity, handle &root)
+      {
+	fd = ::open(path, O_RDWR | O_CREAT, 0666);
+	if (fd < 0)
+	  return(false);
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	  {
+	    unmap(root);
+	    return(false);
+	  }
+
+	error = false;
+
+	if (st.st_size == 0)
+	  {
+	    // New file.
+	    if (initial_capacity == 0)
+	      initial_capacity = 1;
+	    map_size = header_size + (initial_capacity * sizeof(node));
+	    if (ftruncate(fd, off_t(map_size)) != 0)
+	      {
+		unmap(root);
+		return(false);
+	      }
+	    base = static_cast<char *>(
+		     mmap(0, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+			  0));
+	    if (base == MAP_FAILED)
+	      {
+		base = 0;
+		unmap(root);
+		return(false);
+	      }
+	    header &hdr = hd();
+	    hdr.magic = magic_value;
+	    hdr.node_size = sizeof(node);
+	    hdr.root = null();
+	    hdr.free_list = null();
+	    hdr.num_used = 0;
+	    hdr.capacity = initial_capacity;
+	    root = null();
+	    return(true);
+	  }
+
+	if (size(st.st_size) < header_size)
+	  {
+	    unmap(root);
+	    return(false);
+	  }
+
+	map_size = size(st.st_size);
+	base = static_cast<char *>(
+		 mmap(0, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+	if (base == MAP_FAILED)
+	  {
+	    base = 0;
+	    unmap(root);
+	    return(false);
+	  }
+
+	header &hdr = hd();
+	if ((hdr.magic != magic_value) || (hdr.node_size != sizeof(node)) ||
+	    (hdr.capacity == 0) || (hdr.num_used > hdr.capacity) ||
+	    ((header_size + (hdr.capacity * sizeof(node))) > map_size))
+	  {
+	    unmap(root);
+	    return(false);
+	  }
+
+	root = check(hdr.root, true);
+	check(hdr.free_list, true);
+	if (error)
+	  {
+	    unmap(root);
+	    return(false);
+	  }
+
+	return(true);
+      }
+
+    // Store the root handle in the header, and flush the file to disk.
+    void sync_file(handle root)
+      {
+	if (base)
+	  {
+	    hd().root = root;
+	    msync(base, map_size, MS_SYNC);
+	  }
+      }
+
+    void close_file(handle &root)
+      {
+	sync_file(root);
+	unmap(root);
+      }
+
+    // Unmap and close the file, without saving the root.
+    void unmap(handle &root)
+      {
+	if (base)
+	  {
+	    munmap(base, map_size);
+	    base = 0;
+	  }
+	if (fd >= 0)
+	  {
+	    ::close(fd);
+	    fd = -1;
+	  }
+	map_size = 0;
+	root = null();
+      }
+  };
+
+// AVL tree stored in a memory-mapped file.  The handle of the root node
+// is saved in the file by sync() and close() (and the destructor).  If
+// the process ends without calling one of them after the tree was
+// changed, the tree in the file will be corrupt.
+//
+template <class traits, unsigned max_depth = 48>
+class mmap_avl_tree : public avl_tree<mmap_avl_abs<traits>, max_depth>
+  {
+  private:
+
+    typedef avl_tree<mmap_avl_abs<traits>, max_depth> base;
+
+  public:
+
+    typedef typename base::handle handle;
+    typedef typename base::size size;
+    typedef typename traits::value value;
+
+    // Opens the file, creating it (with space for initial_capacity nodes)
+    // if it does not exist.  Returns false on failure.
+    bool open(const char *path, size initial_capacity = 1024)
+      {
+	close();
+	return(this->abs.open_file(path, initial_capacity, this->abs.root));
+      }
+
+    bool is_open() { return(this->abs.base != 0); }
+
+    // Saves the root handle in the file, and flushes the file to disk.
+    void sync() { this->abs.sync_file(this->abs.root); }
+
+    void close() { this->abs.close_file(this->abs.root); }
+
+    // Returns the handle of a newly allocated node (not in the tree), or
+    // null if the file could not be enlarged, or the list of free records
+    // is corrupt (see read_error()).
+    handle alloc() { return(this->abs.alloc()); }
+
+    // Frees a node that is not in the tree.
+    void free(handle h) { this->abs.free(h); }
+
+    // The value stored in a node.  The reference is only valid until the
+    // next call to alloc().
+    value & val(handle h) { return(this->abs.val(h)); }
+
+    mmap_avl_tree() { }
+
+    ~mmap_avl_tree() { close(); }
+  };
+
+} // end namespace abstract_container
+
+#endif
@@ -0,0 +1,616 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_PAGED_AVL_H_
+#define ABSTRACT_CONTAINER_PAGED_AVL_H_
+
+// AVL Tree Stored in a File, With a Bounded Page Cache.
+//
+// The nodes of the tree are records in fixed-size pages of a file.  Only a
+// bounded number of pages are in memory at any time, so the tree can be
+// much larger than memory.  Pages are read (using POSIX pread()) when a
+// node in them is needed, into a pool of page frames provided by the
+// caller.  When all the frames are in use, the least recently used page
+// is evicted (and written back with pwrite() first, if it was changed).
+//
+// Handles are node numbers, which remain valid when the file is reopened.
+// Node number n is in page n / nodes_per_page (page 0 of the file is a
+// header, so node numbers less than nodes_per_page are never used).
+//
+// A failure to read or write a page, or a link to a node outside the file,
+// is reported through read_error(), the same way as any other failure of
+// a tree to access its nodes.
+
+#include <stdint.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "avl_tree.h"
+#include "bidir_list.h"
+
+namespace abstract_container
+{
+
+template <class traits, unsigned page_size, unsigned max_depth>
+class paged_avl_tree;
+
+// Abstractor for avl_tree, for nodes in pages of a file.
+//
+// traits parameter class has the same requirements as for mmap_avl_abs.
+// page_size is the size of a page in bytes.  It must be at least twice
+// the size of a node record.
+//
+// The get_less() and get_greater() member functions make the page of the
+// returned node resident when their access parameter is true (the tree
+// is traversing to the node), and only copy the link when it is false
+// (the tree is moving the link into another node).  So only traversal
+// causes page faults, and an I/O error is detected before the tree
+// uses the node.
+//
+template <class traits, unsigned page_size = 4096>
+class paged_avl_abs
+  {
+  public:
+
+    typedef uint64_t handle;
+    typedef uint64_t size;
+    typedef typename traits::key key;
+    typedef typename traits::value value;
+
+    // Record for a node in the file.
+    struct node
+      {
+	handle lt, gt;
+	signed char bf;
+	value val;
+      };
+
+    static const unsigned nodes_per_page = page_size / sizeof(node);
+
+    // A page frame.  The caller provides an array of these, which the
+    // cache uses while the tree is open.
+    class frame
+      {
+      private:
+
+	node nodes[nodes_per_page];
+
+	// Page in the frame, or 0 if the frame is unused.
+	uint64_t page;
+
+	// Links for the LRU list.
+	unsigned lru[2];
+
+	// Next frame in the same hash chain.
+	unsigned hash_next;
+
+	// Head of the hash chain for the pages whose number modulo the
+	// number of frames is the index of this frame.
+	unsigned hash_head;
+
+	bool dirty;
+
+	friend class paged_avl_abs;
+      };
+
+    // Cache performance counters.
+    struct cache_stats
+      {
+	// Node accesses satisfied by a resident page.
+	uint64_t hits;
+
+	// Pages read from the file.
+	uint64_t faults;
+
+	// Changed pages written to the file (when evicted or by sync()).
+	uint64_t write_backs;
+
+	// Links read with access true (traversal), and false (relinking).
+	uint64_t traversal_reads, relink_reads;
+      };
+
+    handle get_less(handle h, bool access)
+      { return(link(nd(h).lt, access)); }
+    void set_less(handle h, handle lh) { nd_w(h).lt = lh; }
+
+    handle get_greater(handle h, bool access)
+      { return(link(nd(h).gt, access)); }
+    void set_greater(handle h, handle gh) { nd_w(h).gt = gh; }
+
+    int get_balance_factor(handle h) { return(nd(h).bf); }
+    void set_balance_factor(handle h, int bf) { nd_w(h).bf = bf; }
+
+    int compare_key_node(key k, handle h)
+      { return(traits::compare_key_value(k, nd(h).val)); }
+
+    // (With at least two frames, the page of h1 is the most recently
+    // used when the page of h2 is made resident, so it is not evicted.)
+    int compare_node_node(handle h1, handle h2)
+      { return(traits::compare_value_value(nd(h1).val, nd(h2).val)); }
+
+    static handle null() { return(0); }
+
+    // Returns true if a page could not be read or written, or a link to
+    // a node outside the file was found.
+    bool read_error() { return(error); }
+
+    paged_avl_abs() : frames(0), num_frames(0), fd(-1), error(false)
+      { reset_stats(); }
+
+    // Returns the value stored in a node, and marks its page as changed.
+    // Only valid until the next access to another node (by the tree or
+    // this function), since the page may then be evicted.
+    value & val(handle h) { return(nd_w(h).val); }
+
+    // Same as val(), but does not mark the page as changed.
+    const value & read_val(handle h) { return(nd(h).val); }
+
+    // Returns the handle of a newly allocated node.
+    handle alloc()
+      {
+	handle h;
+
+	if (hdr.free_list != null())
+	  {
+	    h = hdr.free_list;
+	    hdr.free_list = nd(h).lt;
+	    return(h);
+	  }
+
+	return(nodes_per_page + hdr.num_used++);
+      }
+
+    // Free a node (that is not in the tree), so its record can be reused.
+    void free(handle h)
+      {
+	nd_w(h).lt = hdr.free_list;
+	hdr.free_list = h;
+      }
+
+    const cache_stats & stats() { return(stats_); }
+
+    void reset_stats()
+      {
+	stats_.hits = 0;
+	stats_.faults = 0;
+	stats_.write_backs = 0;
+	stats_.traversal_reads = 0;
+	stats_.relink_reads = 0;
+      }
+
+  protected:
+
+    template <class, unsigned, unsigned>
+    friend class paged_avl_tree;
+
+    // Check at compile time that a page holds at least two nodes.
+    typedef char page_size_too_small[nodes_per_page >= 2 ? 1 : -1];
+
+    // Saved in page 0 of the file.
+    struct header
+      {
+	uint64_t magic;
+
+	// Size of a node record and of a page, to check that the file was
+	// created for the same value type and page size.
+	uint64_t node_size, page_sz;
+
+	handle root;
+
+	// List of free records, linked by the lt field.
+	handle free_list;
+
+	// Number of records that have been allocated (including ones that
+	// are now free).
+	size num_used;
+      };
+
+    // "AVL_PAGE" in ASCII.
+    static const uint64_t magic_value =
+      (uint64_t(0x41564c5f) << 32) | uint64_t(0x50414745);
+
+    struct lru_abs
+      {
+	typedef unsigned handle;
+
+	frame *frames;
+
+	static handle null() { return(~0u); }
+
+	handle link(handle h, bool is_forward)
+	  { return(frames[h].lru[is_forward]); }
+
+	void link(handle h, handle link_h, bool is_forward)
+	  { frames[h].lru[is_forward] = link_h; }
+      };
+
+    header hdr;
+
+    frame *frames;
+    unsigned num_frames;
+
+    // Number of frames that have been used since the file was opened.
+    unsigned frames_used;
+
+    // Most recently used frame first.
+    bidir_list<lru_abs> lru;
+
+    // Number of pages that have been written to the file.
+    uint64_t file_pages;
+
+    int fd;
+    bool error;
+
+    cache_stats stats_;
+
+    // Returned by nd() for a node whose page could not be read.
+    node scratch;
+
+    static uint64_t page_of(handle h) { return(h / nodes_per_page); }
+
+    bool valid(handle h)
+      { return((h >= nodes_per_page) && (h < (nodes_per_page + hdr.num_used))); }
+
+    handle link(handle h, bool access)
+      {
+	if (!access)
+	  {
+	    ++stats_.relink_reads;
+	    return(h);
+	  }
+
+	++stats_.traversal_reads;
+
+	if (h == null())
+	  return(h);
+
+	if (!valid(h) || (resident(page_of(h)) == lru_abs::null()))
+	  {
+	    error = true;
+	    return(null());
+	  }
+
+	return(h);
+      }
+
+    node & nd(handle h)
+      {
+	unsigned f = lru.start();
+
+	// Fast path for the most recently used page.
+	if ((f != lru_abs::null()) && (frames[f].page == page_of(h)))
+	  {
+	    ++stats_.hits;
+	    return(frames[f].nodes[h % nodes_per_page]);
+	  }
+
+	if (!valid(h) || ((f = resident(page_of(h))) == lru_abs::null()))
+	  {
+	    error = true;
+	    scratch.lt = null();
+	    scratch.gt = null();
+	    scratch.bf = 0;
+	    return(scratch);
+	  }
+
+	return(frames[f].nodes[h % nodes_per_page]);
+      }
+
+    // For a node that is about to be changed.
+    node & nd_w(handle h)
+      {
+	node &n = nd(h);
+
+	if (&n != &scratch)
+	  frames[lru.start()].dirty = true;
+
+	return(n);
+      }
+
+    // Makes the page resident and the most recently used, and returns its
+    // frame, or null if the page could not be read.
+    unsigned resident(uint64_t page)
+      {
+	unsigned f = frames[page % num_frames].hash_head;
+
+	while ((f != lru_abs::null()) && (frames[f].page != page))
+	  f = frames[f].hash_next;
+
+	if (f != lru_abs::null())
+	  {
+	    ++stats_.hits;
+	    if (f != lru.start())
+	      {
+		lru.remove(f);
+		lru.push(f);
+	      }
+	    return(f);
+	  }
+
+	++stats_.faults;
+
+	if (frames_used < num_frames)
+	  f = frames_used++;
+	else
+	  {
+	    // Evict the least recently used page.
+	    f = lru.pop(reverse);
+	    if (!write_back(f))
+	      {
+		lru.push(f, reverse);
+		return(lru_abs::null());
+	      }
+	    unhash(f);
+	  }
+
+	frame &fr = frames[f];
+
+	if (page < file_pages)
+	  {
+	    if (pread(fd, fr.nodes, sizeof(fr.nodes), off_t(page * page_size))
+		!= ssize_t(sizeof(fr.nodes)))
+	      {
+		fr.page = 0;
+		lru.push(f, reverse);
+		return(lru_abs::null());
+	      }
+	  }
+	else
+	  // Page of newly allocated nodes, not yet in the file.
+	  memset(fr.nodes, 0, sizeof(fr.nodes));
+
+	fr.page = page;
+	fr.dirty = false;
+	fr.hash_next = frames[page % num_frames].hash_head;
+	frames[page % num_frames].hash_head = f;
+	lru.push(f);
+
+	return(f);
+      }
+
+    void unhash(unsigned f)
+      {
+	if (frames[f].page == 0)
+	  return;
+
+	unsigned *p = &frames[frames[f].page % num_frames].hash_head;
+
+	while (*p != f)
+	  p = &frames[*p].hash_next;
+
+	*p = frames[f].hash_next;
+	frames[f].page = 0;
+      }
+
+    // Writes the page in the frame to the file, if it was changed.
+    // Returns false on failure.
+    bool write_back(unsigned f)
+      {
+	frame &fr = frames[f];
+
+	if ((fr.page == 0) || !fr.dirty)
+	  return(true);
+
+	if (pwrite(fd, fr.nodes, sizeof(fr.nodes), off_t(fr.page * page_size))
+	    != ssize_t(sizeof(fr.nodes)))
+	  {
+	    error = true;
+	    return(false);
+	  }
+
+	++stats_.write_backs;
+	fr.dirty = false;
+	if (fr.page >= file_pages)
+	  file_pages = fr.page + 1;
+
+	return(true);
+      }
+
+    // Opens the file, creating it if it does not exist, using the given
+    // array of page frames as the cache.  Returns false on failure.
+    bool open_file(
+      const char *path, frame *frames_, unsigned num_frames_, handle &root)
+      {
+	if (num_frames_ < 2)
+	  return(false);
+
+	frames = frames_;
+	num_frames = num_frames_;
+	frames_used = 0;
+	lru.frames = frames;
+	lru.purge();
+	error = false;
+
+	for (unsigned i = 0; i < num_frames; ++i)
+	  {
+	    frames[i].page = 0;
+	    frames[i].hash_head = lru_abs::null();
+	  }
+
+	fd = ::open(path, O_RDWR | O_CREAT, 0666);
+	if (fd < 0)
+	  return(false);
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	  {
+	    close_no_save(root);
+	    return(false);
+	  }
+
+	file_pages = uint64_t(st.st_size) / page_size;
+
+	if (st.st_size == 0)
+	  {
+	    // New file.
+	    hdr.magic = magic_value;
+	    hdr.node_size = sizeof(node);
+	    hdr.page_sz = page_size;
+	    hdr.root = null();
+	    hdr.free_list = null();
+	    hdr.num_used = 0;
+	    root = null();
+	    return(true);
+	  }
+
+	if ((pread(fd, &hdr, sizeof(hdr), 0) != ssize_t(sizeof(hdr))) ||
+	    (hdr.magic != magic_value) || (hdr.node_size != sizeof(node)) ||
+	    (hdr.page_sz != page_size))
+	  {
+	    close_no_save(root);
+	    return(false);
+	  }
+
+	root = hdr.root;
+	if ((root != null()) && !valid(root))
+	  {
+	    close_no_save(root);
+	    return(false);
+	  }
+
+	return(true);
+      }
+
+    // Writes all changed pages and the header to the file, and flushes
+    // the file to disk.  Returns false on failure.
+    bool sync_file(handle root)
+      {
+	if (fd < 0)
+	  return(false);
+
+	bool ok = true;
+
+	for (unsigned f = 0; f < frames_used; ++f)
+	  if (!write_back(f))
+	    ok = false;
+
+	// The header is only written if all the nodes were, so it never
+	// refers to nodes that are not in the file.
+	if (ok)
+	  {
+	    hdr.root = root;
+	    if (pwrite(fd, &hdr, sizeof(hdr), 0) != ssize_t(sizeof(hdr)))
+	      ok = false;
+	  }
+
+	if (ok && (fsync(fd) != 0))
+	  ok = false;
+
+	if (!ok)
+	  error = true;
+
+	return(ok);
+      }
+
+    bool close_file(handle &root)
+      {
+	bool ok = sync_file(root);
+	close_no_save(root);
+	return(ok);
+      }
+
+    // Close the file, without saving anything.
+    void close_no_save(handle &root)
+      {
+	if (fd >= 0)
+	  {
+	    ::close(fd);
+	    fd = -1;
+	  }
+	frames = 0;
+	num_frames = 0;
+	frames_used = 0;
+	lru.purge();
+	root = null();
+      }
+  };
+
+// AVL tree stored in a file, with a bounded cache of pages in memory.
+// Changed pages and the handle of the root node are only all saved in the
+// file by sync() and close() (and the destructor).  If the process ends
+// without calling one of them after the tree was changed, the tree in the
+// file will be corrupt.
+//
+template <class traits, unsigned page_size = 4096, unsigned max_depth = 48>
+class paged_avl_tree
+  : public avl_tree<paged_avl_abs<traits, page_size>, max_depth>
+  {
+  private:
+
+    typedef paged_avl_abs<traits, page_size> abs_t;
+    typedef avl_tree<abs_t, max_depth> base;
+
+  public:
+
+    typedef typename base::handle handle;
+    typedef typename base::size size;
+    typedef typename traits::value value;
+    typedef typename abs_t::frame frame;
+    typedef typename abs_t::cache_stats cache_stats;
+
+    static const unsigned nodes_per_page = abs_t::nodes_per_page;
+
+    // Opens the file, creating it if it does not exist.  The num_frames
+    // (at least 2) page frames starting at frames are used as the page
+    // cache until the file is closed.  Returns false on failure.
+    bool open(const char *path, frame *frames, unsigned num_frames)
+      {
+	close();
+	return(this->abs.open_file(path, frames, num_frames, this->abs.root));
+      }
+
+    bool is_open() { return(this->abs.fd >= 0); }
+
+    // Saves the changed pages and the root handle in the file, and
+    // flushes the file to disk.  Returns false on failure.
+    bool sync() { return(this->abs.sync_file(this->abs.root)); }
+
+    bool close() { return(this->abs.close_file(this->abs.root)); }
+
+    // Returns the handle of a newly allocated node (not in the tree).
+    handle alloc() { return(this->abs.alloc()); }
+
+    // Frees a node that is not in the tree.
+    void free(handle h) { this->abs.free(h); }
+
+    // The value stored in a node.  The reference is only valid until the
+    // next access to another node.
+    value & val(handle h) { return(this->abs.val(h)); }
+
+    // Same as val(), for a value that will not be changed.  (Pages that
+    // have not been changed are not written back when evicted.)
+    const value & read_val(handle h) { return(this->abs.read_val(h)); }
+
+    const cache_stats & stats() { return(this->abs.stats()); }
+
+    void reset_stats() { this->abs.reset_stats(); }
+
+    paged_avl_tree() { }
+
+    ~paged_avl_tree() { close(); }
+  };
+
+} // end namespace abstract_container
+
+#endif
@@ -0,0 +1,532 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_PERSIST_AVL_H_
+#define ABSTRACT_CONTAINER_PERSIST_AVL_H_
+
+// Persistent (Path Copying) AVL Tree, with Lock-Free Readers.
+//
+// A node is never changed once it is in a published version of the tree.
+// Instead, insert() and remove() make copies of the O(log n) nodes on the
+// path from the root to the change (and of the few other nodes that
+// rebalancing changes), and then atomically publish the root of the new
+// version.  Readers pin the current version, and can then search and
+// iterate it without any locks, while a writer makes new versions.
+//
+// A node that is replaced by a copy (or removed) is retired.  It is
+// passed to the abstractor's release() function once no reader can still
+// have it pinned.  This uses epoch-based reclamation:  each pinned reader
+// records the epoch when it pinned, and the epoch only advances once
+// every pinned reader has pinned in the current epoch.  Nodes retired in
+// an epoch are released two epochs later.
+//
+// Calls to the writer member functions (insert(), remove(), reclaim())
+// must not overlap.  Any number of readers can run concurrently with
+// each other and with a writer.
+//
+// Requires C++11 or later.
+//
+// The abstractor class must have the same members as for avl_tree (in
+// avl_tree.h), except that the read_error() member is not used (it is
+// assumed the nodes are in memory).  It must also have these members:
+//
+//   // Returns the handle of a new node with the same contents (key,
+//   // value, links and balance factor) as the node h.
+//   handle clone(handle h);
+//
+//   // Called when the node h is no longer in any version of the tree
+//   // that can be read, so its storage can be freed or reused.
+//   void release(handle h);
+//
+//   // Get/set a link (separate from the less and greater links) used to
+//   // keep lists of retired nodes.
+//   handle get_retired_next(handle h);
+//   void set_retired_next(handle h, handle next);
+//
+// The abstractor member functions must be able to be called concurrently
+// by a writer and readers.  Readers only call get_less(),
+// get_greater() and compare_key_node().
+
+#include <atomic>
+
+namespace abstract_container
+{
+
+template <class abstractor, unsigned max_readers = 64,
+	  unsigned max_depth = 32>
+class persist_avl_tree
+  {
+  public:
+
+    typedef typename abstractor::key key;
+    typedef typename abstractor::handle handle;
+
+    persist_avl_tree() : wroot(abs.null()), pub_root(abs.null()), epoch(0)
+      {
+	for (unsigned i = 0; i < max_readers; ++i)
+	  {
+	    slot[i].store(0);
+	    slot_used[i].store(false);
+	  }
+	for (unsigned i = 0; i < 3; ++i)
+	  limbo[i] = null();
+      }
+
+    // Releases all retired nodes.  There must be no pinned readers.
+    // The nodes in the current version are not released.
+    ~persist_avl_tree()
+      {
+	for (unsigned i = 0; i < 3; ++i)
+	  release_list(i);
+      }
+
+    persist_avl_tree(const persist_avl_tree &) = delete;
+    persist_avl_tree & operator = (const persist_avl_tree &) = delete;
+
+    // Writer member functions.
+
+    // Inserts the node h, and publishes the resulting version.  Returns
+    // h, or, if the tree already has a node with the same key, the
+    // handle of that node (and the tree is not changed).
+    handle insert(handle h)
+      {
+	handle path[max_depth];
+	bool dir[max_depth];
+	unsigned depth = 0;
+	handle cur = wroot;
+	int c;
+
+	while (cur != null())
+	  {
+	    c = abs.compare_node_node(h, cur);
+	    if (c == 0)
+	      return(cur);
+	    path[depth] = cur;
+	    dir[depth++] = c > 0;
+	    cur = get_ch(cur, c > 0);
+	  }
+
+	set_ch(h, false, null());
+	set_ch(h, true, null());
+	abs.set_balance_factor(h, 0);
+
+	// Copy the path, from the bottom up, rebalancing the copies as in
+	// an ordinary insertion.  Rebalancing only changes nodes in the
+	// path (which are new copies).
+	bool grew = true;
+	int bf;
+	handle n;
+	cur = h;
+	while (depth)
+	  {
+	    --depth;
+	    n = copy(path[depth]);
+	    set_ch(n, dir[depth], cur);
+	    if (grew)
+	      {
+		bf = abs.get_balance_factor(n) + (dir[depth] ? 1 : -1);
+		abs.set_balance_factor(n, bf);
+		if ((bf == 2) || (bf == -2))
+		  {
+		    n = balance(n);
+		    grew = false;
+		  }
+		else
+		  grew = (bf != 0);
+	      }
+	    cur = n;
+	  }
+
+	publish(cur);
+
+	return(h);
+      }
+
+    // Removes the node with key k, and publishes the resulting version.
+    // Returns the handle of the removed node, or null if there is no node
+    // with key k.  The removed node is retired (readers may still be
+    // accessing it), so it must only be freed by release().
+    handle remove(key k)
+      {
+	handle path[max_depth];
+	bool dir[max_depth];
+	unsigned depth = 0;
+	handle cur = wroot;
+	int c;
+
+	for ( ; ; )
+	  {
+	    if (cur == null())
+	      return(null());
+	    c = abs.compare_key_node(k, cur);
+	    if (c == 0)
+	      break;
+	    path[depth] = cur;
+	    dir[depth++] = c > 0;
+	    cur = get_ch(cur, c > 0);
+	  }
+
+	handle target = cur;
+	unsigned target_depth = depth;
+
+	// gone is the node whose position in the tree is removed.  If the
+	// target has two children, it is the target's successor, which
+	// then takes the target's position.
+	handle gone = target;
+	if ((get_ch(target, false) != null()) &&
+	    (get_ch(target, true) != null()))
+	  {
+	    path[depth] = target;
+	    dir[depth++] = true;
+	    gone = get_ch(target, true);
+	    while (get_ch(gone, false) != null())
+	      {
+		path[depth] = gone;
+		dir[depth++] = false;
+		gone = get_ch(gone, false);
+	      }
+	  }
+
+	// The child (if any) of gone replaces it.
+	cur = get_ch(gone, get_ch(gone, false) == null());
+	retire(gone);
+
+	bool shrunk = true, heavy;
+	int bf;
+	handle n, s;
+	while (depth)
+	  {
+	    --depth;
+	    if (depth == target_depth)
+	      {
+		// A copy of the successor replaces the target.
+		n = abs.clone(gone);
+		set_ch(n, false, get_ch(target, false));
+		abs.set_balance_factor(n, abs.get_balance_factor(target));
+		retire(target);
+	      }
+	    else
+	      n = copy(path[depth]);
+	    set_ch(n, dir[depth], cur);
+	    if (shrunk)
+	      {
+		bf = abs.get_balance_factor(n) + (dir[depth] ? -1 : 1);
+		abs.set_balance_factor(n, bf);
+		if ((bf == 2) || (bf == -2))
+		  {
+		    // The deeper child is not in the path, so it (and its
+		    // child, for a double rotation) must be copied before
+		    // balance() changes them.
+		    heavy = bf > 0;
+		    s = copy(get_ch(n, heavy));
+		    set_ch(n, heavy, s);
+		    if (abs.get_balance_factor(s) == (heavy ? -1 : 1))
+		      set_ch(s, !heavy, copy(get_ch(s, !heavy)));
+		    n = balance(n);
+		    shrunk = (abs.get_balance_factor(n) == 0);
+		  }
+		else
+		  shrunk = (bf == 0);
+	      }
+	    cur = n;
+	  }
+
+	publish(cur);
+
+	return(target);
+      }
+
+    // Tries to release all retired nodes.  Returns false if some could
+    // not be released, because some readers are pinned to old versions.
+    bool reclaim()
+      {
+	for (unsigned i = 0; i < 3; ++i)
+	  if (!try_advance())
+	    return(false);
+
+	return(true);
+      }
+
+    // Reader member functions.  The root parameter is the root of a
+    // version pinned by a reader.
+
+    // Returns the handle of the node with key k in the version, or null
+    // if there is no such node.
+    handle search(handle root, key k)
+      {
+	int c;
+
+	while (root != null())
+	  {
+	    c = abs.compare_key_node(k, root);
+	    if (c == 0)
+	      break;
+	    root = get_ch(root, c > 0);
+	  }
+
+	return(root);
+      }
+
+    handle null() { return(abs.null()); }
+
+    // A reader.  Each reader takes one of max_readers slots in the tree,
+    // while it exists.  A reader must only be used by one thread at a
+    // time.
+    class reader
+      {
+      public:
+
+	explicit reader(persist_avl_tree &t) : tree(t), idx(max_readers)
+	  {
+	    for (unsigned i = 0; i < max_readers; ++i)
+	      {
+		bool expected = false;
+		if (t.slot_used[i].compare_exchange_strong(expected, true))
+		  {
+		    idx = i;
+		    break;
+		  }
+	      }
+	  }
+
+	~reader()
+	  {
+	    if (valid())
+	      {
+		unpin();
+		tree.slot_used[idx].store(false);
+	      }
+	  }
+
+	reader(const reader &) = delete;
+	reader & operator = (const reader &) = delete;
+
+	// Returns false if all the slots were taken when the reader was
+	// created.
+	bool valid() const { return(idx < max_readers); }
+
+	// Pins the current version, and returns its root.  The version
+	// stays pinned until unpin() or pin() is called, or the reader
+	// is destroyed.
+	handle pin()
+	  {
+	    tree.slot[idx].store(tree.epoch.load() + 1);
+	    return(tree.pub_root.load());
+	  }
+
+	void unpin() { tree.slot[idx].store(0); }
+
+      private:
+
+	persist_avl_tree &tree;
+	unsigned idx;
+      };
+
+    // Iterates in ascending key order over the nodes of a version.
+    class iter
+      {
+      public:
+
+	iter() : tree_(0), depth(0) { }
+
+	void start_iter_least(persist_avl_tree &t, handle root)
+	  {
+	    tree_ = &t;
+	    depth = 0;
+	    push_least(root);
+	  }
+
+	// Returns the handle of the current node, or null if iteration
+	// is finished.
+	handle operator * ()
+	  { return(depth ? path[depth - 1] : tree_->null()); }
+
+	void operator ++ ()
+	  {
+	    if (depth)
+	      {
+		--depth;
+		push_least(tree_->get_ch(path[depth], true));
+	      }
+	  }
+
+	void operator ++ (int) { ++(*this); }
+
+      private:
+
+	persist_avl_tree *tree_;
+
+	// The current node is at the top.  Below it are the ancestors
+	// that follow it in key order.
+	handle path[max_depth];
+	unsigned depth;
+
+	void push_least(handle h)
+	  {
+	    while (h != tree_->null())
+	      {
+		path[depth++] = h;
+		h = tree_->get_ch(h, false);
+	      }
+	  }
+      };
+
+  private:
+
+    abstractor abs;
+
+    // Root of the current version, only accessed by the writer.
+    handle wroot;
+
+    // Root of the current version, for readers.
+    std::atomic<handle> pub_root;
+
+    std::atomic<unsigned long long> epoch;
+
+    // For each reader slot, zero if the reader is not pinned, otherwise
+    // one more than the epoch when it pinned.
+    std::atomic<unsigned long long> slot[max_readers];
+
+    std::atomic<bool> slot_used[max_readers];
+
+    // Lists of retired nodes, linked with the retired_next links.  The
+    // nodes retired in epoch e are in limbo[e % 3].
+    handle limbo[3];
+
+    handle get_ch(handle h, bool greater)
+      {
+	return(greater ? abs.get_greater(h, true) : abs.get_less(h, true));
+      }
+
+    void set_ch(handle h, bool greater, handle ch)
+      {
+	if (greater)
+	  abs.set_greater(h, ch);
+	else
+	  abs.set_less(h, ch);
+      }
+
+    void retire(handle h)
+      {
+	unsigned i = unsigned(epoch.load(std::memory_order_relaxed) % 3);
+
+	abs.set_retired_next(h, limbo[i]);
+	limbo[i] = h;
+      }
+
+    // Returns a copy of the node h, and retires h.
+    handle copy(handle h)
+      {
+	handle n = abs.clone(h);
+	retire(h);
+	return(n);
+      }
+
+    void release_list(unsigned i)
+      {
+	handle h = limbo[i], next;
+
+	limbo[i] = null();
+	while (h != null())
+	  {
+	    next = abs.get_retired_next(h);
+	    abs.release(h);
+	    h = next;
+	  }
+      }
+
+    // Advances the epoch, if every pinned reader pinned in the current
+    // epoch, and releases the nodes retired two epochs before the current
+    // one.  Returns false if the epoch could not be advanced.
+    bool try_advance()
+      {
+	unsigned long long e = epoch.load(std::memory_order_relaxed), v;
+
+	for (unsigned i = 0; i < max_readers; ++i)
+	  {
+	    v = slot[i].load();
+	    if (v && (v != (e + 1)))
+	      return(false);
+	  }
+
+	epoch.store(e + 1);
+
+	// The list for the new epoch has the nodes retired in epoch
+	// e - 2.  Any reader that could still have them pinned pinned
+	// in epoch e - 2 or e - 1, and so would have prevented the
+	// advance from epoch e - 1 or e.
+	release_list(unsigned((e + 1) % 3));
+
+	return(true);
+      }
+
+    void publish(handle root)
+      {
+	wroot = root;
+	pub_root.store(root);
+	try_advance();
+      }
+
+    // Rebalances the subtree whose root is h, whose balance factor is 2
+    // or -2.  Returns the new root of the subtree.  The deeper child of
+    // h, and, if the balance factor of that child is opposite in sign to
+    // that of h, its child on the shallower side, must not be in any
+    // published version.
+    handle balance(handle h)
+      {
+	bool heavy = abs.get_balance_factor(h) > 0;
+	int sign = heavy ? 1 : -1, bf;
+	handle deep = get_ch(h, heavy);
+
+	if (abs.get_balance_factor(deep) == -sign)
+	  {
+	    // Double rotation.
+	    handle top = get_ch(deep, !heavy);
+	    set_ch(h, heavy, get_ch(top, !heavy));
+	    set_ch(deep, !heavy, get_ch(top, heavy));
+	    set_ch(top, !heavy, h);
+	    set_ch(top, heavy, deep);
+	    bf = abs.get_balance_factor(top);
+	    abs.set_balance_factor(h, bf == sign ? -sign : 0);
+	    abs.set_balance_factor(deep, bf == -sign ? sign : 0);
+	    abs.set_balance_factor(top, 0);
+	    return(top);
+	  }
+
+	// Single rotation.
+	set_ch(h, heavy, get_ch(deep, !heavy));
+	set_ch(deep, !heavy, h);
+	if (abs.get_balance_factor(deep) == 0)
+	  {
+	    abs.set_balance_factor(deep, -sign);
+	    abs.set_balance_factor(h, sign);
+	  }
+	else
+	  {
+	    abs.set_balance_factor(deep, 0);
+	    abs.set_balance_factor(h, 0);
+	  }
+	return(deep);
+      }
+  };
+
+} // end namespace abstract_container
+
+#endif /* Include once */
@@ -256,14 +256,21 @@ void ru_shared_mutex::impl::blocking_unlock_shared(ru_shared_mutex::data &d)
 
 void ru_shared_mutex::impl::notify_uniq_cond(ru_shared_mutex::data &d)
   {
-    // condition_variable::notify_one() is non-const, so presumably not thread-safe, so protect it.
+    // condition_variable::notify_one() is non-const, so presumably not thread-safe, so protect it.  If another thread
+    // is notifying, wait for it to finish rather than skipping the notify.  Its notify may have been done before the
+    // thread that now needs to be woken started waiting, so skipping could leave that thread waiting forever.
     //
-    bool f{false};
-    if (d.notify_uniq_cond.compare_exchange_strong(f, true, std::memory_order_relaxed, std::memory_order_relaxed))
+    for (;;)
       {
-        d.wait_uniq_cond.notify_one();
-        d.notify_uniq_cond = false;
+        bool f{false};
+        if (d.notify_uniq_cond.compare_exchange_strong(f, true, std::memory_order_acquire, std::memory_order_relaxed))
+          break;
+        L(NU1);
+        std::this_thread::yield();
       }
+    d.wait_uniq_cond.notify_one();
+    L(NU0);
+    d.notify_uniq_cond.store(false, std::memory_order_release);
   }
 
 // Returns false if no 'sharing' flag true, or 'blocking' is false, and a shared lock on the list of per-thread data 
@@ -16,7 +16,7 @@ rm -f a.out *.o
 
 $CC $OPTS --std=c++${YR} -c crc32.cpp fnv_hash.cpp >| $L 2>&1
 
-for F in avl_ex1.cpp avl_ex2.cpp test_avl.cpp test_cq.cpp test_cq_lf.cpp test_hash.cpp test_list.cpp test_modulus.cpp test_util.cpp
+for F in avl_ex1.cpp avl_ex2.cpp test_arena_avl.cpp test_avl.cpp test_conc_avl.cpp test_cq.cpp test_cq_lf.cpp test_eytz_index.cpp test_hash.cpp test_lin_hash.cpp test_list.cpp test_mmap_avl.cpp test_modulus.cpp test_paged_avl.cpp test_persist_avl.cpp test_swiss_hash.cpp test_util.cpp
 do
     rm -f a.out *.o
     $CC $OPTS --std=c++${YR} $F -lstdc++ -lpthread
@@ -25,11 +25,36 @@ done >> $L 2>&1
 
 rm -f a.out *.o
 
+$CC $OPTS --std=c++${YR} test_avl_snapshot.cpp crc32.cpp -lstdc++ >> $L 2>&1
+./a.out >> $L 2>&1
+
+rm -f a.out *.o
+
 $CC $OPTS --std=c++${YR} test_hash_speed.cpp crc32.cpp fnv_hash.cpp -lm -lstdc++ >> $L 2>&1
 ./a.out 0 10000 >> $L 2>&1
 
 rm -f a.out *.o
 
+$CC $OPTS --std=c++${YR} test_hash_table_speed.cpp -lstdc++ >> $L 2>&1
+./a.out >> $L 2>&1
+
+rm -f a.out *.o
+
+$CC $OPTS --std=c++${YR} test_lin_hash_speed.cpp -lstdc++ >> $L 2>&1
+./a.out >> $L 2>&1
+
+rm -f a.out *.o
+
+$CC $OPTS --std=c++${YR} test_swiss_hash_speed.cpp -lstdc++ >> $L 2>&1
+./a.out >> $L 2>&1
+
+rm -f a.out *.o
+
+$CC $OPTS --std=c++${YR} test_avl_speed.cpp -lstdc++ -lpthread >> $L 2>&1
+./a.out 100000 >> $L 2>&1
+
+rm -f a.out *.o
+
 $CC $OPTS -std=c++17 test_ru_shared_mutex.cpp -lstdc++ >> $L 2>&1
 ./a.out >> $L 2>&1
 
@@ -49,3 +74,18 @@ $CC $OPTS -std=c++17 test_ru_shared_mutex_speed2.cpp ru_shared_mutex.cpp -lstdc+
 ./a.out >> $L 2>&1
 
 rm -f a.out *.o
+
+$CC $OPTS -std=c++17 test_conc_hash.cpp -lstdc++ -lpthread >> $L 2>&1
+./a.out >> $L 2>&1
+
+rm -f a.out *.o
+
+$CC $OPTS -std=c++17 test_conc_avl_speed.cpp ru_shared_mutex.cpp -lstdc++ -lpthread >> $L 2>&1
+./a.out >> $L 2>&1
+
+rm -f a.out *.o
+
+$CC $OPTS -std=c++17 test_conc_hash_speed.cpp -lstdc++ -lpthread >> $L 2>&1
+./a.out >> $L 2>&1
+
+rm -f a.out *.o
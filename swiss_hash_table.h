@@ -0,0 +1,517 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Include once.
+#ifndef ABSTRACT_CONTAINER_SWISS_HASH_TABLE_H_
+#define ABSTRACT_CONTAINER_SWISS_HASH_TABLE_H_
+
+#include <utility>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace abstract_container
+{
+
+namespace impl
+{
+
+// A group of 16 control bytes, for probing 16 slots at once.
+class swiss_group
+  {
+  public:
+
+    // Control byte values other than hash fingerprints (which are
+    // 0 - 127).
+    static const int8_t empty = -128;
+    static const int8_t deleted = -2;
+
+    static const unsigned width = 16;
+
+    explicit swiss_group(const int8_t *p)
+      {
+        #if defined(__SSE2__)
+        ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        #else
+        memcpy(ctrl, p, width);
+        #endif
+      }
+
+    // Bit i of the result is set if control byte i is equal to c.
+    unsigned match(int8_t c) const
+      {
+        #if defined(__SSE2__)
+        return(unsigned(
+          _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(c), ctrl))));
+        #else
+        unsigned m = 0;
+        for (unsigned i = 0; i < width; ++i)
+          m |= unsigned(ctrl[i] == c) << i;
+        return(m);
+        #endif
+      }
+
+    unsigned match_empty() const { return(match(empty)); }
+
+    // Bit i of the result is set if slot i is empty or deleted.
+    unsigned match_non_full() const
+      {
+        #if defined(__SSE2__)
+        return(unsigned(_mm_movemask_epi8(ctrl)));
+        #else
+        unsigned m = 0;
+        for (unsigned i = 0; i < width; ++i)
+          m |= unsigned(ctrl[i] < 0) << i;
+        return(m);
+        #endif
+      }
+
+    // Returns the index of the lowest set bit in a non-zero mask.
+    static unsigned lowest(unsigned m)
+      {
+        #if defined(__GNUC__)
+        return(unsigned(__builtin_ctz(m)));
+        #else
+        unsigned i = 0;
+        while (!(m & 1))
+          {
+            m >>= 1;
+            ++i;
+          }
+        return(i);
+        #endif
+      }
+
+    // Returns the number of high zero bits of a mask of group width.
+    static unsigned leading(unsigned m)
+      {
+        unsigned i = 0;
+        while ((i < width) and !(m & (1U << (width - 1 - i))))
+          ++i;
+        return(i);
+      }
+
+    // Returns the number of low zero bits of a mask of group width.
+    static unsigned trailing(unsigned m)
+      {
+        return(m ? lowest(m) : width);
+      }
+
+  private:
+
+    #if defined(__SSE2__)
+    __m128i ctrl;
+    #else
+    int8_t ctrl[width];
+    #endif
+  };
+
+} // end namespace impl
+
+// Intrusive open addressing hash table, in the style of the "Swiss table".
+//
+// The table is an array of element handles, with a control byte for each
+// slot.  The control byte is either empty, deleted, or the low 7 bits of
+// the hash value of the key of the element in the slot.  A search
+// examines the control bytes for 16 slots at once (using SSE2 if it is
+// available), and only calls is_key() for slots whose 7 bits match the
+// key's.  So, unlike a chained hash table, there is usually no access of
+// the elements themselves, other than the one with the key.
+//
+// The number of slots is fixed (so there is no use of new/delete).
+// Unlike a chained hash table, the table can become full.  Searches for
+// missing keys get slow as it approaches full, so the number of elements
+// should be kept below about 7/8 of the number of slots.
+//
+// abstractor parameter class must have these public members, or equivalents
+// (the same as for base_hash_table, except for the list type):
+//
+// Types:
+//
+// handle -- must be copyable and comparable with ==.
+// index -- an unsigned integral type.
+// key -- some copyable type.
+//
+// Member functions:
+//
+// handle null() -- returns a handle value that is never associated with
+//   any element.  Must be a static member.
+// index hash_key(key) -- returns the hash value of the given key.  All
+//   the bits of the hash value are used.  The low 7 bits are stored in
+//   the control bytes, and the higher bits select the slot where probing
+//   starts.  So both the low and high bits should be well mixed.
+// index hash_elem(handle) -- returns hash value of the key of the element
+//   associated with the given handle.  Each element placed into the hash
+//   table must be associated with a unique handle value, and a unique key
+//   value.
+// bool is_key(key, handle) -- returns true if the first parameter is
+//   the key of the element whose handle is the second parameter.
+//
+// Static constants:
+//
+// static const size_t num_slots -- the number of slots.  Must be a power
+//   of 2 that is at least 16.
+//
+template <class abstractor>
+class swiss_hash_table : public abstractor
+  {
+  protected:
+
+    typedef typename abstractor::index index;
+    typedef impl::swiss_group group;
+
+  public:
+
+    typedef typename abstractor::key key;
+    typedef typename abstractor::handle handle;
+
+    static const size_t num_slots = abstractor::num_slots;
+
+    #if __cplusplus >= 201100
+
+    template<typename ... args_t>
+    swiss_hash_table(args_t && ... args)
+      : abstractor(std::forward<args_t>(args)...) { purge(); }
+
+    swiss_hash_table(const swiss_hash_table &) = delete;
+
+    swiss_hash_table & operator = (const swiss_hash_table &) = delete;
+
+    #else
+
+    swiss_hash_table() { purge(); }
+
+    #endif
+
+    index hash_key(key k) { return(abstractor::hash_key(k)); }
+
+    index hash_elem(handle h) { return(abstractor::hash_elem(h)); }
+
+    // Returns false if the table is full.
+    bool insert(handle h, index hash_value)
+      {
+        if ((num_deleted >= (num_slots / 16)) and
+            (num_empty <= (num_slots / 8)))
+          drop_deleted();
+
+        size_t i = find_non_full(hash_value);
+
+        if (i == num_slots)
+          return(false);
+
+        if (ctrl[i] == group::empty)
+          --num_empty;
+        else
+          --num_deleted;
+
+        set_ctrl(i, fingerprint(hash_value));
+        slot[i] = h;
+
+        return(true);
+      }
+
+    bool insert(handle h) { return(insert(h, hash_elem(h))); }
+
+    // Returns null() if no element has key k.
+    handle search(key k, index hash_value)
+      {
+        size_t i = find(k, hash_value);
+
+        return(i == num_slots ? null() : slot[i]);
+      }
+
+    handle search(key k) { return(search(k, hash_key(k))); }
+
+    // Returns the handle of the removed element, or null() is no element
+    // has key k.
+    handle remove_key(key k)
+      {
+        size_t i = find(k, hash_key(k));
+
+        if (i == num_slots)
+          return(null());
+
+        handle h = slot[i];
+
+        erase(i);
+
+        return(h);
+      }
+
+    // The element must be in the table.
+    void remove(handle h)
+      {
+        index hash_value = hash_elem(h);
+        int8_t fp = fingerprint(hash_value);
+        size_t pos = hash_value >> 7;
+
+        for (size_t step = 0; ; step += group::width)
+          {
+            pos &= mask;
+
+            group g(ctrl + pos);
+
+            for (unsigned m = g.match(fp); m; m &= m - 1)
+              {
+                size_t i = (pos + group::lowest(m)) & mask;
+
+                if (slot[i] == h)
+                  {
+                    erase(i);
+                    return;
+                  }
+              }
+
+            pos += step + group::width;
+          }
+      }
+
+    // Make the hash table empty.
+    void purge()
+      {
+        memset(ctrl, group::empty, sizeof(ctrl));
+
+        num_empty = num_slots;
+        num_deleted = 0;
+      }
+
+    static handle null() { return(abstractor::null()); }
+
+    // Number of elements in the table.
+    size_t size() { return(num_slots - num_empty - num_deleted); }
+
+    // Note:  removing an element invalidates iterators referencing it,
+    // but no others.  Inserting an element invalidates all iterators.
+    //
+    class iter
+      {
+      public:
+
+        void start_iter(swiss_hash_table &ht_)
+          {
+            ht = &ht_;
+
+            i = size_t(0) - 1;
+
+            advance();
+          }
+
+        iter(swiss_hash_table &ht_) { start_iter(ht_); }
+
+        // Returns handle of element currently referenced by iterator, or
+        // null() if the iterator is past the last element (if any).
+        //
+        handle operator * ()
+          { return(i == num_slots ? swiss_hash_table::null() : ht->slot[i]); }
+
+        operator bool () { return(i != num_slots); }
+
+        swiss_hash_table & table() { return(*ht); }
+
+        void operator ++ () { advance(); }
+
+        void operator ++ (int) { ++(*this); }
+
+      protected:
+
+        // Hash table being iterated over.
+        swiss_hash_table *ht;
+
+        // Current slot.
+        size_t i;
+
+        void advance()
+          {
+            while ((++i < num_slots) and (ht->ctrl[i] < 0))
+              ;
+          }
+      };
+
+  protected:
+
+    static const size_t mask = num_slots - 1;
+
+    bool is_key(key k, handle h) { return(abstractor::is_key(k, h)); }
+
+    static int8_t fingerprint(index hash_value)
+      { return(int8_t(hash_value & 0x7f)); }
+
+  private:
+
+    // Control bytes.  The first group::width - 1 are repeated at the end,
+    // so a group can be loaded starting at any slot.
+    int8_t ctrl[num_slots + group::width - 1];
+
+    handle slot[num_slots];
+
+    size_t num_empty, num_deleted;
+
+    void set_ctrl(size_t i, int8_t c)
+      {
+        ctrl[i] = c;
+
+        if (i < (group::width - 1))
+          ctrl[num_slots + i] = c;
+      }
+
+    // Returns the slot of the element with key k, or num_slots if there
+    // is none.
+    size_t find(key k, index hash_value)
+      {
+        int8_t fp = fingerprint(hash_value);
+        size_t pos = hash_value >> 7;
+
+        #if defined(__GNUC__)
+        // The slot will most likely be in the first group, so load it in
+        // parallel with the control bytes.
+        __builtin_prefetch(slot + (pos & mask));
+        #endif
+
+        // Triangular probing (with group-sized steps) visits every group
+        // of slots, since num_slots is a power of 2.
+        for (size_t step = 0; step < num_slots; step += group::width)
+          {
+            pos &= mask;
+
+            group g(ctrl + pos);
+
+            for (unsigned m = g.match(fp); m; m &= m - 1)
+              {
+                size_t i = (pos + group::lowest(m)) & mask;
+
+                if (is_key(k, slot[i]))
+                  return(i);
+              }
+
+            if (g.match_empty())
+              break;
+
+            pos += step + group::width;
+          }
+
+        return(num_slots);
+      }
+
+    // Returns the first empty or deleted slot in the probe sequence for
+    // a hash value, or num_slots if all slots are full.
+    size_t find_non_full(index hash_value)
+      {
+        size_t pos = hash_value >> 7;
+
+        for (size_t step = 0; step < num_slots; step += group::width)
+          {
+            pos &= mask;
+
+            unsigned m = group(ctrl + pos).match_non_full();
+
+            if (m)
+              return((pos + group::lowest(m)) & mask);
+
+            pos += step + group::width;
+          }
+
+        return(num_slots);
+      }
+
+    // The slot can be made empty (rather than deleted) if no group
+    // containing it has ever been full, since then no probe sequence can
+    // have passed over it.
+    void erase(size_t i)
+      {
+        unsigned before =
+          group::leading(
+            group(ctrl + ((i - group::width) & mask)).match_empty());
+        unsigned after = group::trailing(group(ctrl + i).match_empty());
+
+        if ((before + after) < group::width)
+          {
+            set_ctrl(i, group::empty);
+            ++num_empty;
+          }
+        else
+          {
+            set_ctrl(i, group::deleted);
+            ++num_deleted;
+          }
+      }
+
+    // Position of slot i in the probe sequence starting at pos, in groups.
+    static size_t probe_group(size_t pos, size_t i)
+      { return(((i - pos) & mask) / group::width); }
+
+    // Rehash in place, to turn all the deleted slots into empty ones.
+    // Full slots are marked deleted, then each is moved to the first
+    // non-full slot in its probe sequence.  (This is the algorithm used
+    // by Abseil's "drop deletes without resize".)
+    void drop_deleted()
+      {
+        size_t i;
+
+        for (i = 0; i < num_slots; ++i)
+          ctrl[i] = ctrl[i] == group::deleted ? group::empty :
+                    (ctrl[i] >= 0 ? group::deleted : ctrl[i]);
+        memcpy(ctrl + num_slots, ctrl, group::width - 1);
+
+        for (i = 0; i < num_slots; ++i)
+          {
+            if (ctrl[i] != group::deleted)
+              continue;
+
+            index hash_value = hash_elem(slot[i]);
+            size_t pos = (hash_value >> 7) & mask;
+            size_t new_i = find_non_full(hash_value);
+
+            if (probe_group(pos, new_i) == probe_group(pos, i))
+              {
+                // Already in the best group.
+                set_ctrl(i, fingerprint(hash_value));
+                continue;
+              }
+
+            if (ctrl[new_i] == group::empty)
+              {
+                set_ctrl(new_i, fingerprint(hash_value));
+                slot[new_i] = slot[i];
+                set_ctrl(i, group::empty);
+              }
+            else
+              {
+                // Swap with the element in new_i (which has not been
+                // placed yet), and process slot i again.
+                set_ctrl(new_i, fingerprint(hash_value));
+                handle tmp = slot[new_i];
+                slot[new_i] = slot[i];
+                slot[i] = tmp;
+                --i;
+              }
+          }
+
+        num_empty += num_deleted;
+        num_deleted = 0;
+      }
+  };
+
+} // end namespace abstract_container
+
+#endif /* Include once */
@@ -0,0 +1,218 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Arena AVL Tree Test.
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "stdint.h"
+
+#include "arena_avl.h"
+
+// Check to make sure double inclusion OK.
+#include "arena_avl.h"
+
+void bail(const char *note)
+  {
+    printf("%s\n", note);
+    exit(1);
+  }
+
+struct rec
+  {
+    int key;
+    int data;
+  };
+
+struct traits
+  {
+    typedef int key;
+    typedef rec value;
+
+    static int compare_key_value(key k, const value &v)
+      { return(k < v.key ? -1 : (k > v.key ? 1 : 0)); }
+
+    static int compare_value_value(const value &v1, const value &v2)
+      { return(compare_key_value(v1.key, v2)); }
+  };
+
+const unsigned num_keys = 2000;
+
+bool present[num_keys];
+
+unsigned long hnd[num_keys];
+
+// Tree with the abstractor public, so the links and balance factors can
+// be checked.
+template <typename index, index capacity>
+class t_tree :
+  public abstract_container::arena_avl_tree<traits, index, capacity>
+  {
+  public:
+
+    typedef abstract_container::arena_avl_abs<traits, index, capacity> abs_t;
+
+    abs_t & pub_abs() { return(this->abs); }
+
+    index root() { return(this->abs.root); }
+  };
+
+// Verifies that a subtree is balanced, with the correct balance factors,
+// and in order.  Returns the depth.
+template <class tree_t>
+int verify(tree_t &tree, typename tree_t::handle h)
+  {
+    typename tree_t::abs_t &a = tree.pub_abs();
+    typename tree_t::handle null = tree.null();
+
+    if (h == null)
+      return(0);
+
+    typename tree_t::handle lh = a.get_less(h, true),
+			    gh = a.get_greater(h, true);
+
+    if ((lh != null) and (tree.val(lh).key >= tree.val(h).key))
+      bail("verify less order");
+    if ((gh != null) and (tree.val(gh).key <= tree.val(h).key))
+      bail("verify greater order");
+
+    int l_depth = verify(tree, lh), g_depth = verify(tree, gh);
+
+    if (a.get_balance_factor(h) != (g_depth - l_depth))
+      bail("verify balance factor");
+
+    return(1 + (l_depth > g_depth ? l_depth : g_depth));
+  }
+
+// Check that the tree contains exactly the nodes that are present, in order.
+template <class tree_t>
+void check(tree_t &tree)
+  {
+    typename tree_t::iter it;
+    unsigned i;
+
+    verify(tree, tree.root());
+
+    it.start_iter_least(tree);
+    for (i = 0; i < num_keys; i++)
+      if (present[i])
+	{
+	  if ((*it == tree.null()) or (*it != hnd[i]))
+	    {
+	      printf("%u\n", i);
+	      bail("check iter");
+	    }
+	  if ((tree.val(*it).key != int(i)) or
+	      (tree.val(*it).data != int(3 * i)))
+	    bail("check value");
+	  it++;
+	}
+    if (*it != tree.null())
+      bail("check end");
+
+    for (i = 0; i < num_keys; i++)
+      if (tree.search(i) != (present[i] ? hnd[i] : tree.null()))
+	bail("check search");
+  }
+
+template <class tree_t>
+void insert(tree_t &tree, unsigned i)
+  {
+    typename tree_t::handle h = tree.alloc();
+    if (h == tree.null())
+      bail("alloc");
+    tree.val(h).key = i;
+    tree.val(h).data = 3 * i;
+    if (tree.insert(h) != h)
+      bail("insert");
+    hnd[i] = h;
+    present[i] = true;
+  }
+
+template <class tree_t>
+void remove(tree_t &tree, unsigned i)
+  {
+    typename tree_t::handle h = tree.remove(i);
+    if (h != hnd[i])
+      bail("remove");
+    tree.free(h);
+    present[i] = false;
+  }
+
+template <class tree_t>
+void test(tree_t &tree)
+  {
+    unsigned i, step;
+
+    for (i = 0; i < num_keys; i++)
+      present[i] = false;
+
+    srand(1);
+    for (step = 0; step < (20 * num_keys); step++)
+      {
+	unsigned k = unsigned(rand()) % num_keys;
+	if (present[k])
+	  remove(tree, k);
+	else
+	  insert(tree, k);
+	if ((step % 1000) == 0)
+	  check(tree);
+      }
+    check(tree);
+
+    // Freed nodes are reused, so all the keys fit, and then the arena is
+    // full.
+    for (i = 0; i < num_keys; i++)
+      if (!present[i])
+	insert(tree, i);
+    check(tree);
+    if (tree.alloc() != tree.null())
+      bail("alloc when full");
+
+    remove(tree, 7);
+    check(tree);
+    if (tree.alloc() != hnd[7])
+      bail("alloc after free");
+
+    tree.clear();
+    for (i = 0; i < num_keys; i++)
+      present[i] = false;
+    check(tree);
+    if (tree.alloc() != 0)
+      bail("alloc after clear");
+  }
+
+t_tree<uint16_t, num_keys> tree16;
+
+t_tree<uint32_t, num_keys> tree32;
+
+int main()
+  {
+    test(tree16);
+    test(tree32);
+
+    // The links with the balance factor bits take 2 bytes each with 16-bit
+    // indexes.
+    if (t_tree<uint16_t, num_keys>::node_size != (sizeof(rec) + 4))
+      bail("node size");
+
+    printf("SUCCESS!\n");
+
+    return(0);
+  }
@@ -23,6 +23,7 @@ SOFTWARE.
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
+#include "limits.h"
 
 #include "avl_tree.h"
 
@@ -50,6 +51,9 @@ static struct
   }
 arr[401], arr2[400];
 
+// Count of key comparisons.
+unsigned num_cmp;
+
 // Class to pass to template as abstractor parameter.
 class abstr
   {
@@ -123,6 +127,7 @@ class abstr
       {
 	if (!(h & HIGH_BIT))
 	  bail("compare_key_node");
+	num_cmp++;
 	return(k - arr[h & ~HIGH_BIT].val);
       }
 
@@ -132,6 +137,7 @@ class abstr
 	  bail("compare_node_node - h1");
 	if (!(h2 & HIGH_BIT))
 	  bail("compare_node_node - h2");
+	num_cmp++;
 	return(arr[h1 & ~HIGH_BIT].val - arr[h2 & ~HIGH_BIT].val);
       }
 
@@ -651,6 +657,32 @@ void all_trees(unsigned depth)
 // Array of handles in order by node key.
 unsigned h_arr[400];
 
+namespace fail_iter_ns
+{
+
+// Random-access iterator over an array of handles, which fails when the
+// handle at position 'fail' is read.
+struct fail_iter
+  {
+    const unsigned *p, *fail;
+
+    unsigned operator * () const { return(*p); }
+
+    fail_iter operator + (unsigned n) const
+      {
+	fail_iter it = { p + n, fail };
+	return(it);
+      }
+
+    void operator ++ () { ++p; }
+
+    void operator ++ (int) { ++p; }
+  };
+
+bool build_iter_error(const fail_iter &it) { return(it.p == it.fail); }
+
+} // end namespace fail_iter_ns
+
 // Test the build member function template by building tress with from 1
 // to 400 nodes.
 void build_test(void)
@@ -666,101 +698,1904 @@ void build_test(void)
 	tree.build(h_arr, i + 1);
 	verify_tree();
       }
+
+    // parallel_build() must build exactly the same tree as build().
+    static unsigned char shape[sizeof(arr)];
+    const unsigned num_threads[] = { 1, 2, 3, 8 };
+    unsigned t;
+
+    for (i = 0; i <= 400; i++)
+      {
+	tree.build(h_arr, i);
+	memcpy(shape, arr, sizeof(arr));
+	for (t = 0; t < 4; t++)
+	  {
+	    for (unsigned j = 0; j < i; j++)
+	      {
+		arr[j].lt = arr[j].gt = 12345;
+		arr[j].bf = 7;
+	      }
+	    if (!tree.parallel_build(h_arr, i, num_threads[t]))
+	      bail("parallel_build read error");
+	    if (memcmp(shape, arr, sizeof(arr)) or
+		(tree.pub_root != (i ? (((i - 1) / 2) | HIGH_BIT) :
+				   abstr::null())))
+	      {
+		printf("%u %u\n", i, num_threads[t]);
+		bail("parallel_build");
+	      }
+	  }
+      }
+
+    // If the iterator fails, at any position, build() and
+    // parallel_build() must fail, and not change the root.
+    for (i = 1; i <= 40; i++)
+      for (unsigned f = 0; f < i; f++)
+	{
+	  fail_iter_ns::fail_iter it = { h_arr, h_arr + f };
+
+	  tree.build(h_arr, 400);
+	  if (tree.build(it, i) or (tree.pub_root != (199 | HIGH_BIT)))
+	    bail("build iterator failure");
+	  for (t = 0; t < 4; t++)
+	    if (tree.parallel_build(it, i, num_threads[t]) or
+		(tree.pub_root != (199 | HIGH_BIT)))
+	      {
+		printf("%u %u %u\n", i, f, num_threads[t]);
+		bail("parallel_build iterator failure");
+	      }
+	}
   }
 
-int main()
+t_avl_tree tree2;
+
+// Verifies a tree, and returns the number of nodes in it.
+unsigned check_tree(t_avl_tree &t)
   {
-    unsigned i;
+    if (t.pub_root == abstr::null())
+      return(0);
 
-    printf(
-      "Empty member optimization is%s working\n",
-      sizeof(abstract_container::avl_tree<abstr>) == sizeof(unsigned) ?
-	"" : " NOT");
+    verify_tree(t.pub_root & ~HIGH_BIT);
+
+    unsigned cnt = 0;
+    iter it;
+
+    for (it.start_iter_least(t); *it != abstr::null(); it++)
+      cnt++;
+
+    return(cnt);
+  }
+
+// Returns true if a node with key k2 would satisfy a search for key k1
+// with search type st.
+bool satisfies(int k1, abstract_container::search_type st, int k2)
+  {
+    if (k2 == k1)
+      return(st & abstract_container::EQUAL);
+    if (k2 < k1)
+      return(st & abstract_container::LESS);
+    return(st & abstract_container::GREATER);
+  }
+
+const abstract_container::search_type all_st[] =
+  {
+    abstract_container::EQUAL,
+    abstract_container::LESS,
+    abstract_container::LESS_EQUAL,
+    abstract_container::GREATER,
+    abstract_container::GREATER_EQUAL
+  };
+
+// Split a tree with num_nodes nodes at key k, check the two resulting
+// trees, then join them back together.
+void one_split(unsigned num_nodes, int k, abstract_container::search_type st)
+  {
+    tree.build(h_arr, num_nodes);
+
+    tree2.insert(num_nodes | HIGH_BIT);
+
+    if (!tree.split(k, st, tree2))
+      bail("split failed");
+
+    unsigned cnt = check_tree(tree), cnt2 = check_tree(tree2), i, keep = 0;
+
+    for (i = 0; i < num_nodes; ++i)
+      if (satisfies(k, st, 2 * i))
+	++keep;
+
+    if ((cnt != keep) or (cnt2 != (num_nodes - keep)))
+      {
+	printf("%u %d %x %u %u\n", num_nodes, k, (unsigned) st, cnt, cnt2);
+	bail("split count");
+      }
+
+    iter it;
+
+    for (it.start_iter_least(tree); *it != abstr::null(); it++)
+      if (!satisfies(k, st, arr[*it & ~HIGH_BIT].val))
+	bail("split keep");
+
+    for (it.start_iter_least(tree2); *it != abstr::null(); it++)
+      if (satisfies(k, st, arr[*it & ~HIGH_BIT].val))
+	bail("split rest");
+
+    if (st == abstract_container::EQUAL)
+      {
+	tree.purge();
+	tree2.purge();
+	return;
+      }
+
+    bool ok;
+
+    if (st & abstract_container::LESS)
+      ok = tree.join(tree, tree2);
+    else
+      ok = tree.join(tree2, tree);
+
+    if (!ok or (check_tree(tree) != num_nodes) or !tree2.is_empty())
+      {
+	printf("%u %d %x\n", num_nodes, k, (unsigned) st);
+	bail("split rejoin");
+      }
+
+    tree.purge();
+  }
+
+void split_join_test(void)
+  {
+    unsigned i, n;
+    int k;
 
     for (i = 0; i < 400; i++)
-      arr2[i].val = i * 2;
+      h_arr[i] = i | HIGH_BIT;
 
-    memcpy(arr, arr2, sizeof(arr));
+    for (n = 0; n < 70; n++)
+      for (k = -1; k <= int(2 * n + 1); k++)
+	for (i = 0; i < (sizeof(all_st) / sizeof(all_st[0])); i++)
+	  one_split(n, k, all_st[i]);
 
-    max_elems = 3;
-    mark_bf();
+    for (k = -1; k <= 399; k += 3)
+      for (i = 0; i < (sizeof(all_st) / sizeof(all_st[0])); i++)
+	one_split(399, k, all_st[i]);
 
-    printf("0 nodes\n");
+    // Join trees of every possible pair of sizes adding up to 399.
+    for (i = 0; i <= 399; i++)
+      {
+	tree.build(h_arr, i);
+	tree2.build(h_arr + i, 399 - i);
+	if (!tree.join(tree, tree2) or (check_tree(tree) != 399) or
+	    !tree2.is_empty())
+	  {
+	    printf("%u\n", i);
+	    bail("join");
+	  }
+	tree.build(h_arr, i);
+	tree2.build(h_arr + i, 399 - i);
+	if (!tree2.join(tree, tree2) or (check_tree(tree2) != 399) or
+	    !tree.is_empty())
+	  {
+	    printf("%u\n", i);
+	    bail("join 2");
+	  }
+	tree2.purge();
+      }
+  }
 
-    check_empty();
+// Handles of nodes dropped by a set operation.
+bool dropped[400];
 
-    search_all();
+void drop(unsigned h)
+  {
+    h &= ~HIGH_BIT;
+    if (dropped[h])
+      bail("dropped twice");
+    dropped[h] = true;
+  }
 
-    printf("1 node\n");
+// Test the bulk set operations.  Nodes 0 - 199 are used for the first
+// tree, and nodes 200 - 399 for the second tree.  Node j and node
+// 200 + j have the same key.
+void set_op_test(void)
+  {
+    const unsigned pct[] = { 1, 5, 30, 70, 97 };
+    const unsigned num_pct = sizeof(pct) / sizeof(pct[0]);
+    bool in1[200], in2[200];
+    unsigned i, j, n1, n2, op, trial;
 
-    insert(1);
-    insert(1);
-    verify_tree();
-    search_all();
-    remove(2);
-    remove(2, true);
-    check_empty();
+    srand(1);
 
-    printf("2 nodes less slant\n");
+    for (j = 0; j < 200; j++)
+      arr[200 + j].val = 2 * j;
 
-    insert(2);
-    insert(2);
-    insert(1);
-    insert(1);
-    verify_tree();
-    search_all();
-    remove(2);
-    remove(2, true);
-    insert(1);
-    verify_tree();
-    remove(4);
-    remove(4, true);
-    verify_tree();
-    remove(2);
-    check_empty();
+    for (trial = 0; trial < (3 * num_pct * num_pct * 20); trial++)
+      {
+	op = trial % 3;
 
-    printf("2 nodes greater slant\n");
+	n1 = 0;
+	n2 = 0;
+	for (j = 0; j < 200; j++)
+	  {
+	    in1[j] = unsigned(rand() % 100) < pct[(trial / 3) % num_pct];
+	    in2[j] = unsigned(rand() % 100) <
+		       pct[(trial / (3 * num_pct)) % num_pct];
+	    if (in1[j])
+	      h_arr[n1++] = j | HIGH_BIT;
+	    if (in2[j])
+	      h_arr[200 + n2++] = (200 + j) | HIGH_BIT;
+	    dropped[j] = false;
+	    dropped[200 + j] = false;
+	  }
+	tree.build(h_arr, n1);
+	tree2.build(h_arr + 200, n2);
+
+	unsigned num_threads = trial & 1 ? 4 : 1;
+	bool ok;
+	if (op == 0)
+	  ok = tree.set_union(tree2, drop, num_threads);
+	else if (op == 1)
+	  ok = tree.set_intersection(tree2, drop, num_threads);
+	else
+	  ok = tree.set_difference(tree2, drop, num_threads);
+	if (!ok)
+	  bail("set_op failed");
 
-    insert(1);
-    insert(1);
-    insert(2);
-    insert(2);
-    verify_tree();
-    search_all();
-    remove(4);
-    remove(4, true);
-    insert(2);
-    verify_tree();
-    remove(2);
-    remove(2, true);
-    verify_tree();
-    remove(4);
-    check_empty();
+	unsigned cnt = 0;
+	for (j = 0; j < 200; j++)
+	  {
+	    bool in, drop1, drop2;
+	    if (op == 0)
+	      {
+		in = in1[j] or in2[j];
+		drop1 = false;
+		drop2 = in1[j] and in2[j];
+	      }
+	    else if (op == 1)
+	      {
+		in = in1[j] and in2[j];
+		drop1 = in1[j] and !in2[j];
+		drop2 = false;
+	      }
+	    else
+	      {
+		in = in1[j] and !in2[j];
+		drop1 = in1[j] and in2[j];
+		drop2 = false;
+	      }
+	    if ((dropped[j] != drop1) or (dropped[200 + j] != drop2))
+	      {
+		printf("%u %u\n", trial, j);
+		bail("set_op dropped");
+	      }
+	    if (in)
+	      {
+		cnt++;
+		// The node from the first tree is kept if both have
+		// the key.
+		i = (in1[j] ? j : 200 + j) | HIGH_BIT;
+		if (tree.search(2 * j) != i)
+		  {
+		    printf("%u %u\n", trial, j);
+		    bail("set_op missing");
+		  }
+	      }
+	  }
+	if (check_tree(tree) != cnt)
+	  {
+	    printf("%u\n", trial);
+	    bail("set_op count");
+	  }
+	if (check_tree(tree2) != (op == 0 ? 0 : n2))
+	  {
+	    printf("%u\n", trial);
+	    bail("set_op other");
+	  }
+      }
 
-    max_elems = 400;
+    tree.purge();
+    tree2.purge();
 
-    printf("%u nodes\n", max_elems);
+    for (j = 0; j < 200; j++)
+      arr[200 + j].val = 2 * (200 + j);
+  }
 
-    mark_bf();
+// Remove the nodes in a range from a tree with num_nodes nodes, and check
+// the result.
+void one_remove_range(
+  unsigned num_nodes, int lo, abstract_container::search_type st_lo, int hi,
+  abstract_container::search_type st_hi)
+  {
+    unsigned i, cnt = 0;
 
-    big_test(3, 7);
-    big_test(13, 7);
+    tree.build(h_arr, num_nodes);
 
-    printf("all trees depth 3\n");
+    for (i = 0; i < num_nodes; i++)
+      dropped[i] = false;
 
-    all_trees(3);
+    if (!tree.remove_range(lo, st_lo, hi, st_hi, drop))
+      bail("remove_range failed");
 
-    printf("all trees depth 4\n");
+    for (i = 0; i < num_nodes; i++)
+      {
+	bool in_range =
+	  satisfies(lo, st_lo, 2 * i) and satisfies(hi, st_hi, 2 * i);
+	if ((dropped[i] != in_range) or
+	    ((tree.search(2 * i) == abstr::null()) != in_range))
+	  {
+	    printf("%u %d %x %d %x %u\n", num_nodes, lo, (unsigned) st_lo, hi,
+		   (unsigned) st_hi, i);
+	    bail("remove_range node");
+	  }
+	if (!in_range)
+	  cnt++;
+      }
 
-    all_trees(4);
+    if (check_tree(tree) != cnt)
+      {
+	printf("%u %d %x %d %x\n", num_nodes, lo, (unsigned) st_lo, hi,
+	       (unsigned) st_hi);
+	bail("remove_range count");
+      }
 
-    printf("all trees depth 5\n");
+    tree.purge();
+  }
 
-    all_trees(5);
+void remove_range_test(void)
+  {
+    const unsigned num_st = sizeof(all_st) / sizeof(all_st[0]);
+    unsigned i, j, n;
+    int lo, hi;
 
-    printf("build test\n");
+    for (i = 0; i < 400; i++)
+      h_arr[i] = i | HIGH_BIT;
+
+    for (n = 0; n < 40; n++)
+      for (lo = -1; lo <= int(2 * n + 1); lo++)
+	for (hi = lo; hi <= int(2 * n + 1); hi += 3)
+	  for (i = 0; i < num_st; i++)
+	    for (j = 0; j < num_st; j++)
+	      one_remove_range(n, lo, all_st[i], hi, all_st[j]);
+
+    for (lo = -1; lo <= 399; lo += 37)
+      for (hi = lo; hi <= 800; hi += 41)
+	for (i = 0; i < num_st; i++)
+	  for (j = 0; j < num_st; j++)
+	    one_remove_range(400, lo, all_st[i], hi, all_st[j]);
+  }
 
-    build_test();
+// Mark a node as dropped, then scribble over its links, as if it had
+// been freed.
+void drop_and_clobber(unsigned h)
+  {
+    drop(h);
+    arr[h & ~HIGH_BIT].lt = 12345;
+    arr[h & ~HIGH_BIT].gt = 54321;
+  }
+
+void purge_visit_test(void)
+  {
+    unsigned i, n;
+
+    for (n = 0; n <= 400; n = n ? n + 13 : 1)
+      {
+	// Random insertion order gives trees of many shapes.
+	srand(n);
+	for (i = 0; i < n; i++)
+	  dropped[i] = false;
+	for (i = 0; i < (4 * n); i++)
+	  tree.insert((unsigned(rand()) % n) | HIGH_BIT);
+	for (i = 0; i < n; i++)
+	  if (tree.search(2 * i) == abstr::null())
+	    dropped[i] = true;
+
+	if (!tree.purge(drop_and_clobber) or !tree.is_empty())
+	  bail("purge_visit");
+
+	for (i = 0; i < n; i++)
+	  if (!dropped[i])
+	    {
+	      printf("%u %u\n", n, i);
+	      bail("purge_visit missed");
+	    }
+      }
+  }
+
+// Subtree sizes, for the abstractor that stores them.
+unsigned sz[401];
+
+class size_abstr : public abstr
+  {
+  public:
+
+    static size get_size(handle h)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("get_size");
+	return(sz[h & ~HIGH_BIT]);
+      }
+
+    static void set_size(handle h, size s)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("set_size");
+	sz[h & ~HIGH_BIT] = s;
+      }
+  };
+
+// AVL tree storing subtree sizes, with public root for testing purposes.
+class t_size_tree : public abstract_container::avl_tree<size_abstr>
+  {
+  public:
+    handle &pub_root;
+
+    t_size_tree(void) : pub_root(abs.root) { }
+  };
+
+t_size_tree stree, stree2;
+
+// Verifies the stored subtree sizes in a subtree, and returns the
+// size of the subtree.
+unsigned verify_size(unsigned subroot)
+  {
+    if (subroot == abstr::null())
+      return(0);
+
+    subroot &= ~HIGH_BIT;
+
+    unsigned s =
+      verify_size(arr[subroot].lt) + verify_size(arr[subroot].gt) + 1;
+
+    if (s != sz[subroot])
+      {
+	printf("bad size: n=%u stored=%u actual=%u\n", subroot, sz[subroot], s);
+	bail("verify_size");
+      }
+
+    return(s);
+  }
+
+// Verifies a tree storing sizes, and returns the number of nodes in it.
+unsigned check_size_tree(t_size_tree &t)
+  {
+    if (t.pub_root == abstr::null())
+      {
+	if (t.num_nodes() != 0)
+	  bail("check_size_tree empty");
+	return(0);
+      }
+
+    verify_tree(t.pub_root & ~HIGH_BIT);
+
+    unsigned n = verify_size(t.pub_root);
+    if (n != t.num_nodes())
+      bail("check_size_tree");
+
+    return(n);
+  }
+
+// Check select() and rank() against the nodes that are known to be in
+// the tree.
+void check_order_stat(bool *present)
+  {
+    unsigned i, j, cnt = 0;
+
+    for (i = 0; i < 400; i++)
+      if (present[i])
+	{
+	  if (stree.select(cnt) != (i | HIGH_BIT))
+	    {
+	      printf("%u %u\n", cnt, i);
+	      bail("select");
+	    }
+	  cnt++;
+	}
+    if (stree.select(cnt) != abstr::null())
+      bail("select past end");
+
+    for (int k = -1; k <= 800; k++)
+      for (i = 0; i < (sizeof(all_st) / sizeof(all_st[0])); i++)
+	{
+	  cnt = 0;
+	  for (j = 0; j < 400; j++)
+	    if (present[j] and satisfies(k, all_st[i], 2 * j))
+	      cnt++;
+	  if (stree.rank(k, all_st[i]) != cnt)
+	    {
+	      printf("%d %x %u\n", k, (unsigned) all_st[i], cnt);
+	      bail("rank");
+	    }
+	}
+
+    for (int k = -1; k <= 800; k += 7)
+      {
+	cnt = 0;
+	for (j = 0; j < 400; j++)
+	  if (present[j] and (int(2 * j) >= k) and (int(2 * j) < (k + 50)))
+	    cnt++;
+	if (stree.count_range(k, k + 50) != cnt)
+	  {
+	    printf("%d %u\n", k, cnt);
+	    bail("count_range");
+	  }
+      }
+  }
+
+void size_test(void)
+  {
+    bool present[400];
+    unsigned i, j, step;
+
+    for (i = 0; i < 400; i++)
+      present[i] = false;
+
+    srand(2);
+
+    for (step = 0; step < 20000; step++)
+      {
+	j = unsigned(rand()) % 400;
+	if (present[j])
+	  {
+	    if (stree.remove(2 * j) != (j | HIGH_BIT))
+	      bail("size_test remove");
+	  }
+	else if (stree.insert(j | HIGH_BIT) != (j | HIGH_BIT))
+	  bail("size_test insert");
+	present[j] = !present[j];
+
+	check_size_tree(stree);
+
+	if ((step % 1000) == 0)
+	  {
+	    check_order_stat(present);
+
+	    // Substituted node should get same size.
+	    for (i = 0; (i < 400) and !present[i]; i++)
+	      ;
+	    if (i < 400)
+	      {
+		arr[400].val = 2 * i;
+		sz[400] = 0;
+		if (stree.subst(400 | HIGH_BIT) != (i | HIGH_BIT))
+		  bail("size_test subst in");
+		check_size_tree(stree);
+		if (stree.subst(i | HIGH_BIT) != (400 | HIGH_BIT))
+		  bail("size_test subst out");
+	      }
+	  }
+      }
+
+    check_order_stat(present);
+
+    // build(), split() and join() must also maintain sizes.
+    for (i = 0; i < 400; i++)
+      h_arr[i] = i | HIGH_BIT;
+    for (i = 0; i <= 400; i += 7)
+      {
+	stree.build(h_arr, i);
+	if (check_size_tree(stree) != i)
+	  bail("size_test build");
+	for (int k = -1; k <= int(2 * i); k += 11)
+	  {
+	    stree.build(h_arr, i);
+	    if (!stree.split(k, abstract_container::LESS_EQUAL, stree2))
+	      bail("size_test split");
+	    check_size_tree(stree);
+	    check_size_tree(stree2);
+	    if (!stree.join(stree, stree2) or (check_size_tree(stree) != i))
+	      bail("size_test join");
+	  }
+
+	// remove_range() must also maintain sizes.
+	for (int k = -1; k <= int(2 * i); k += 13)
+	  {
+	    stree.build(h_arr, i);
+	    for (j = 0; j < 400; j++)
+	      dropped[j] = false;
+	    if (!stree.remove_range(
+		  k, abstract_container::GREATER, k + 30,
+		  abstract_container::LESS_EQUAL, drop))
+	      bail("size_test remove_range");
+	    check_size_tree(stree);
+	  }
+      }
+
+    stree.purge();
+    stree2.purge();
+  }
+
+// Interval ends, and greatest interval ends in subtrees.  The interval
+// of node j is [2 * j, iend[j]).
+int iend[401], max_end[401];
+
+class interval_abstr : public abstr
+  {
+  public:
+
+    static key get_end(handle h)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("get_end");
+	return(iend[h & ~HIGH_BIT]);
+      }
+
+    static key get_max_end(handle h)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("get_max_end");
+	return(max_end[h & ~HIGH_BIT]);
+      }
+
+    static void set_max_end(handle h, key e)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("set_max_end");
+	max_end[h & ~HIGH_BIT] = e;
+      }
+
+    static int compare_key_key(key k1, key k2) { return(k1 - k2); }
+  };
+
+// AVL tree storing greatest interval ends, with public root for testing
+// purposes.
+class t_interval_tree : public abstract_container::avl_tree<interval_abstr>
+  {
+  public:
+    handle &pub_root;
+
+    t_interval_tree(void) : pub_root(abs.root) { }
+  };
+
+t_interval_tree itree, itree2;
+
+// Verifies the stored greatest interval ends in a subtree, and returns
+// the greatest end (or INT_MIN if the subtree is empty).
+int verify_max_end(unsigned subroot)
+  {
+    if (subroot == abstr::null())
+      return(INT_MIN);
+
+    subroot &= ~HIGH_BIT;
+
+    int e = iend[subroot], ce = verify_max_end(arr[subroot].lt);
+
+    if (ce > e)
+      e = ce;
+    ce = verify_max_end(arr[subroot].gt);
+    if (ce > e)
+      e = ce;
+
+    if (e != max_end[subroot])
+      {
+	printf("bad max end: n=%u stored=%d actual=%d\n", subroot,
+	       max_end[subroot], e);
+	bail("verify_max_end");
+      }
+
+    return(e);
+  }
+
+void check_interval_tree(t_interval_tree &t)
+  {
+    if (t.pub_root != abstr::null())
+      {
+	verify_tree(t.pub_root & ~HIGH_BIT);
+	verify_max_end(t.pub_root);
+      }
+  }
+
+// Checks the overlap queries for [lo, hi) (or the point lo, if point is
+// true) against the nodes that are known to be in the tree.
+void check_overlap(bool *present, int lo, int hi, bool point)
+  {
+    t_interval_tree::iter it;
+    unsigned j;
+
+    if (point)
+      it.overlap_first(itree, lo);
+    else
+      it.overlap_first(itree, lo, hi);
+
+    for (j = 0; j < 400; j++)
+      if (present[j] and (int(2 * j) < (point ? lo + 1 : hi)) and
+	  (iend[j] > lo))
+	{
+	  if (*it != (j | HIGH_BIT))
+	    {
+	      printf("%d %d %d %u %x\n", lo, hi, int(point), j, *it);
+	      bail("overlap");
+	    }
+	  if (point)
+	    it.overlap_next(lo);
+	  else
+	    it.overlap_next(lo, hi);
+	}
+    if (*it != abstr::null())
+      {
+	printf("%d %d %d %x\n", lo, hi, int(point), *it);
+	bail("overlap past end");
+      }
+  }
+
+void check_overlaps(bool *present)
+  {
+    for (int lo = -70; lo <= 870; lo += 9)
+      {
+	check_overlap(present, lo, 0, true);
+	check_overlap(present, lo, lo, false);
+	check_overlap(present, lo, lo + 1, false);
+	check_overlap(present, lo, lo + 40, false);
+      }
+    check_overlap(present, -1000, 1000, false);
+  }
+
+void interval_test(void)
+  {
+    bool present[400];
+    unsigned i, j, step;
+
+    srand(3);
+
+    for (i = 0; i < 400; i++)
+      {
+	present[i] = false;
+	iend[i] = int(2 * i) + 1 + (rand() % 60);
+      }
+
+    for (step = 0; step < 20000; step++)
+      {
+	j = unsigned(rand()) % 400;
+	if (present[j])
+	  {
+	    if (itree.remove(2 * j) != (j | HIGH_BIT))
+	      bail("interval_test remove");
+	  }
+	else
+	  {
+	    // Occasionally, a long interval.
+	    iend[j] = int(2 * j) + 1 + (rand() % ((step % 50) ? 60 : 600));
+	    if (itree.insert(j | HIGH_BIT) != (j | HIGH_BIT))
+	      bail("interval_test insert");
+	  }
+	present[j] = !present[j];
+
+	check_interval_tree(itree);
+
+	if ((step % 1000) == 0)
+	  {
+	    check_overlaps(present);
+
+	    // Substituting a node with a different interval end should
+	    // update the greatest ends.
+	    for (i = 0; (i < 400) and !present[i]; i++)
+	      ;
+	    if (i < 400)
+	      {
+		arr[400].val = 2 * i;
+		iend[400] = iend[i] + 500;
+		if (itree.subst(400 | HIGH_BIT) != (i | HIGH_BIT))
+		  bail("interval_test subst in");
+		check_interval_tree(itree);
+		if (itree.subst(i | HIGH_BIT) != (400 | HIGH_BIT))
+		  bail("interval_test subst out");
+		check_interval_tree(itree);
+	      }
+	  }
+      }
+
+    check_overlaps(present);
+
+    // build(), split(), join() and remove_range() must also maintain the
+    // greatest ends.
+    for (i = 0; i < 400; i++)
+      {
+	h_arr[i] = i | HIGH_BIT;
+	present[i] = true;
+      }
+    itree.build(h_arr, 400);
+    check_interval_tree(itree);
+    check_overlaps(present);
+    for (int k = -1; k <= 800; k += 37)
+      {
+	itree.build(h_arr, 400);
+	if (!itree.split(k, abstract_container::LESS_EQUAL, itree2))
+	  bail("interval_test split");
+	check_interval_tree(itree);
+	check_interval_tree(itree2);
+	if (!itree.join(itree, itree2))
+	  bail("interval_test join");
+	check_interval_tree(itree);
+
+	for (j = 0; j < 400; j++)
+	  dropped[j] = false;
+	if (!itree.remove_range(
+	      k, abstract_container::GREATER, k + 30,
+	      abstract_container::LESS_EQUAL, drop))
+	  bail("interval_test remove_range");
+	check_interval_tree(itree);
+      }
+
+    itree.purge();
+    itree2.purge();
+  }
+
+// Aggregate for agg_test.  It is a polynomial hash of the sequence of
+// node values, so combine() is not commutative, and the count of nodes.
+struct agg_t
+  {
+    unsigned h, p, n;
+
+    bool operator == (const agg_t &a) const
+      { return((h == a.h) and (p == a.p) and (n == a.n)); }
+  };
+
+// Node values, and subtree aggregates.
+unsigned val[401];
+agg_t agg_arr[401];
+
+class agg_abstr : public abstr
+  {
+  public:
+
+    typedef agg_t agg;
+
+    static agg agg_identity()
+      {
+	agg a = { 0, 1, 0 };
+	return(a);
+      }
+
+    static agg combine(agg a1, agg a2)
+      {
+	agg a = { (a1.h * a2.p) + a2.h, a1.p * a2.p, a1.n + a2.n };
+	return(a);
+      }
+
+    static agg get_node_agg(handle h)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("get_node_agg");
+	agg a = { val[h & ~HIGH_BIT], 31, 1 };
+	return(a);
+      }
+
+    static agg get_agg(handle h)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("get_agg");
+	return(agg_arr[h & ~HIGH_BIT]);
+      }
+
+    static void set_agg(handle h, agg a)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("set_agg");
+	agg_arr[h & ~HIGH_BIT] = a;
+      }
+  };
+
+// AVL tree storing aggregates, with public root for testing purposes.
+class t_agg_tree : public abstract_container::avl_tree<agg_abstr>
+  {
+  public:
+    handle &pub_root;
+
+    t_agg_tree(void) : pub_root(abs.root) { }
+  };
+
+t_agg_tree atree, atree2;
+
+// Verifies the stored aggregates in a subtree, and returns the aggregate
+// of the subtree.
+agg_t verify_agg(unsigned subroot)
+  {
+    if (subroot == abstr::null())
+      return(agg_abstr::agg_identity());
+
+    subroot |= HIGH_BIT;
+
+    unsigned i = subroot & ~HIGH_BIT;
+    agg_t a = agg_abstr::combine(
+		agg_abstr::combine(
+		  verify_agg(arr[i].lt), agg_abstr::get_node_agg(subroot)),
+		verify_agg(arr[i].gt));
+
+    if (!(a == agg_arr[i]))
+      {
+	printf("bad aggregate: n=%u\n", i);
+	bail("verify_agg");
+      }
+
+    return(a);
+  }
+
+void check_agg_tree(t_agg_tree &t)
+  {
+    if (t.pub_root != abstr::null())
+      {
+	verify_tree(t.pub_root & ~HIGH_BIT);
+	verify_agg(t.pub_root);
+      }
+  }
+
+// Check aggregate() against the nodes that are known to be in the tree.
+void check_aggregate(bool *present)
+  {
+    static const abstract_container::search_type st_lo[] =
+      { abstract_container::GREATER, abstract_container::GREATER_EQUAL };
+    static const abstract_container::search_type st_hi[] =
+      { abstract_container::LESS, abstract_container::LESS_EQUAL };
+
+    for (int lo = -1; lo <= 800; lo += 13)
+      for (int hi = lo - 2; hi <= 801; hi += 29)
+	for (unsigned i = 0; i < 2; i++)
+	  for (unsigned k = 0; k < 2; k++)
+	    {
+	      agg_t a = agg_abstr::agg_identity();
+
+	      for (unsigned j = 0; j < 400; j++)
+		if (present[j] and satisfies(lo, st_lo[i], 2 * j) and
+		    satisfies(hi, st_hi[k], 2 * j))
+		  a = agg_abstr::combine(
+			a, agg_abstr::get_node_agg(j | HIGH_BIT));
+
+	      if (!(atree.aggregate(lo, st_lo[i], hi, st_hi[k]) == a))
+		{
+		  printf("%d %u %d %u\n", lo, i, hi, k);
+		  bail("aggregate");
+		}
+	    }
+  }
+
+void agg_test(void)
+  {
+    bool present[400];
+    unsigned i, j, step;
+
+    srand(4);
+
+    for (i = 0; i < 400; i++)
+      {
+	present[i] = false;
+	val[i] = unsigned(rand());
+      }
+
+    for (step = 0; step < 20000; step++)
+      {
+	j = unsigned(rand()) % 400;
+	if (present[j])
+	  {
+	    if (atree.remove(2 * j) != (j | HIGH_BIT))
+	      bail("agg_test remove");
+	  }
+	else if (atree.insert(j | HIGH_BIT) != (j | HIGH_BIT))
+	  bail("agg_test insert");
+	present[j] = !present[j];
+
+	check_agg_tree(atree);
+
+	if ((step % 1000) == 0)
+	  {
+	    check_aggregate(present);
+
+	    // Substituting a node for itself, after changing its value,
+	    // should update the aggregates.
+	    for (i = 0; (i < 400) and !present[i]; i++)
+	      ;
+	    if (i < 400)
+	      {
+		val[i] = unsigned(rand());
+		if (atree.subst(i | HIGH_BIT) != (i | HIGH_BIT))
+		  bail("agg_test subst");
+		check_agg_tree(atree);
+		check_aggregate(present);
+	      }
+	  }
+      }
+
+    // build(), split(), join() and remove_range() must also maintain the
+    // aggregates.
+    for (i = 0; i < 400; i++)
+      {
+	h_arr[i] = i | HIGH_BIT;
+	present[i] = true;
+      }
+    atree.build(h_arr, 400);
+    check_agg_tree(atree);
+    check_aggregate(present);
+    for (int k = -1; k <= 800; k += 37)
+      {
+	atree.build(h_arr, 400);
+	if (!atree.split(k, abstract_container::LESS_EQUAL, atree2))
+	  bail("agg_test split");
+	check_agg_tree(atree);
+	check_agg_tree(atree2);
+	if (!atree.join(atree, atree2))
+	  bail("agg_test join");
+	check_agg_tree(atree);
+
+	for (j = 0; j < 400; j++)
+	  dropped[j] = false;
+	if (!atree.remove_range(
+	      k, abstract_container::GREATER, k + 30,
+	      abstract_container::LESS_EQUAL, drop))
+	  bail("agg_test remove_range");
+	check_agg_tree(atree);
+      }
+
+    atree.purge();
+    atree2.purge();
+  }
+
+// Number of calls to prefix_abstr::get_key_prefix().
+unsigned num_key_prefix;
+
+// Abstractor with key prefixes.  The prefix of a key is the key divided
+// by 16, so up to 8 nodes in the tree can have the same prefix.
+class prefix_abstr : public abstr
+  {
+  public:
+
+    typedef int key_prefix;
+
+    static key_prefix get_key_prefix(key k)
+      {
+	num_key_prefix++;
+	return(k >> 4);
+      }
+
+    static key_prefix get_prefix(handle h)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("get_prefix");
+	return(arr[h & ~HIGH_BIT].val >> 4);
+      }
+  };
+
+abstract_container::avl_tree<prefix_abstr> pftree;
+
+// Returns the handle of the node that should be found by a search with
+// key k and search type st, given which nodes are present.
+unsigned expected_search(
+  const bool present[], int k, abstract_container::search_type st)
+  {
+    unsigned h = abstr::null();
+
+    for (unsigned i = 0; i < 400; i++)
+      if (present[i])
+	{
+	  int v = 2 * int(i);
+
+	  if ((v == k) and (st & abstract_container::EQUAL))
+	    return(i | HIGH_BIT);
+	  if ((v < k) and (st & abstract_container::LESS))
+	    h = i | HIGH_BIT;
+	  if ((v > k) and (st & abstract_container::GREATER)
+	      and (h == abstr::null()))
+	    h = i | HIGH_BIT;
+	}
+
+    return(h);
+  }
+
+void prefix_test(void)
+  {
+    static const abstract_container::search_type st[] =
+      {
+	abstract_container::EQUAL,
+	abstract_container::LESS,
+	abstract_container::LESS_EQUAL,
+	abstract_container::GREATER,
+	abstract_container::GREATER_EQUAL
+      };
+    bool present[400];
+    unsigned i, j, step;
+
+    srand(5);
+
+    for (i = 0; i < 400; i++)
+      present[i] = false;
+
+    for (step = 0; step < 4000; step++)
+      {
+	j = unsigned(rand()) % 400;
+	if (present[j])
+	  {
+	    if (pftree.remove(2 * j) != (j | HIGH_BIT))
+	      bail("prefix_test remove");
+	  }
+	else if (pftree.insert(j | HIGH_BIT) != (j | HIGH_BIT))
+	  bail("prefix_test insert");
+	present[j] = !present[j];
+
+	if ((step % 500) == 0)
+	  for (int k = -1; k <= 800; k++)
+	    for (unsigned s = 0; s < (sizeof(st) / sizeof(st[0])); s++)
+	      if (pftree.search(k, st[s]) !=
+		  expected_search(present, k, st[s]))
+		{
+		  printf("%d %x\n", k, unsigned(st[s]));
+		  bail("prefix_test search");
+		}
+      }
+
+    // Full key comparisons are only needed among nodes with the same
+    // prefix.
+    for (i = 0; i < 400; i++)
+      h_arr[i] = i | HIGH_BIT;
+    pftree.build(h_arr, 400);
+    num_cmp = 0;
+    num_key_prefix = 0;
+    for (i = 0; i < 400; i++)
+      if (pftree.search(2 * i) != (i | HIGH_BIT))
+	bail("prefix_test search after build");
+    if (num_cmp > (4 * 400))
+      {
+	printf("%u\n", num_cmp);
+	bail("prefix_test too many full compares");
+      }
+
+    // The prefix of the search key is only computed once per search.
+    if (num_key_prefix != 400)
+      {
+	printf("%u\n", num_key_prefix);
+	bail("prefix_test get_key_prefix calls");
+      }
+
+    // Iteration order must not be affected.
+    abstract_container::avl_tree<prefix_abstr>::iter it;
+    it.start_iter_least(pftree);
+    for (i = 0; i < 400; i++, it++)
+      if (*it != (i | HIGH_BIT))
+	bail("prefix_test iter");
+    if (*it != abstr::null())
+      bail("prefix_test iter end");
+
+    pftree.purge();
+
+    // str_key_prefix() must not contradict strcmp().
+    char s1[12], s2[12];
+    for (step = 0; step < 100000; step++)
+      {
+	for (i = 0; i < 11; i++)
+	  {
+	    s1[i] = char(1 + (rand() % 3) * 127);
+	    s2[i] = (rand() % 4) ? s1[i] : char(1 + (rand() % 3) * 127);
+	  }
+	s1[rand() % 12] = '\0';
+	s2[rand() % 12] = '\0';
+	s1[11] = s2[11] = '\0';
+	int c = strcmp(s1, s2);
+	uint64_t p1 = abstract_container::str_key_prefix(s1),
+		 p2 = abstract_container::str_key_prefix(s2);
+	if ((p1 < p2) ? (c >= 0) : ((p1 > p2) ? (c <= 0) : false))
+	  {
+	    printf("%s %s\n", s1, s2);
+	    bail("prefix_test str_key_prefix");
+	  }
+      }
+  }
+
+// Test insert and search with an iterator as a hint.
+void finger_test(void)
+  {
+    bool present[400];
+    unsigned i, j, step;
+    t_size_tree::iter hint, hint2;
+
+    // Insert in ascending, then descending order, with the previously
+    // inserted node as the hint.
+    for (int dir = 0; dir < 2; dir++)
+      {
+	num_cmp = 0;
+	for (i = 0; i < 400; i++)
+	  {
+	    j = dir ? 399 - i : i;
+	    if (stree.insert(j | HIGH_BIT, hint) != (j | HIGH_BIT))
+	      bail("finger_test insert");
+	    if (*hint != (j | HIGH_BIT))
+	      bail("finger_test insert hint");
+	    check_size_tree(stree);
+	  }
+	if (num_cmp > (3 * 400))
+	  {
+	    printf("%u\n", num_cmp);
+	    bail("finger_test too many comparisons");
+	  }
+
+	// The hint should be usable as an ordinary iterator.
+	hint++;
+	if (*hint != (dir ? 1 | HIGH_BIT : abstr::null()))
+	  bail("finger_test increment");
+
+	// Search in ascending order.
+	num_cmp = 0;
+	for (i = 0; i < 400; i++)
+	  {
+	    if (stree.search(2 * i, hint) != (i | HIGH_BIT))
+	      bail("finger_test search");
+	    if (*hint != (i | HIGH_BIT))
+	      bail("finger_test search hint");
+	  }
+	if (num_cmp > (3 * 400))
+	  {
+	    printf("%u\n", num_cmp);
+	    bail("finger_test too many search comparisons");
+	  }
+
+	stree.purge();
+	hint = hint2;
+      }
+
+    // Random inserts, removes and searches, with the hint left by the
+    // previous insert or search.
+    for (i = 0; i < 400; i++)
+      present[i] = false;
+
+    srand(3);
+
+    for (step = 0; step < 20000; step++)
+      {
+	j = unsigned(rand()) % 400;
+	if ((step % 3) == 0)
+	  {
+	    unsigned h = stree.search((2 * j) + (step & 1), hint);
+	    if (h != ((present[j] and !(step & 1)) ? j | HIGH_BIT :
+		      abstr::null()))
+	      bail("finger_test random search");
+	    if (h == abstr::null())
+	      {
+		// Hint should be a neighbor of the key.
+		int k = (2 * j) + (step & 1);
+		unsigned n = *hint;
+		if ((n != abstr::null()) and
+		    (n != stree.search(k, abstract_container::LESS)) and
+		    (n != stree.search(k, abstract_container::GREATER)))
+		  bail("finger_test random search hint");
+	      }
+	    else if (*hint != h)
+	      bail("finger_test random search hint found");
+	  }
+	else if (present[j])
+	  {
+	    // Insert of node with duplicate key should return node in tree.
+	    arr[400].val = 2 * j;
+	    if (stree.insert(400 | HIGH_BIT, hint) != (j | HIGH_BIT))
+	      bail("finger_test random duplicate");
+	    if (*hint != (j | HIGH_BIT))
+	      bail("finger_test random duplicate hint");
+	    if (stree.remove(2 * j) != (j | HIGH_BIT))
+	      bail("finger_test random remove");
+	    present[j] = false;
+	    // Iterators are invalidated by remove().
+	    hint = hint2;
+	  }
+	else
+	  {
+	    if (stree.insert(j | HIGH_BIT, hint) != (j | HIGH_BIT))
+	      bail("finger_test random insert");
+	    if (*hint != (j | HIGH_BIT))
+	      bail("finger_test random insert hint");
+	    present[j] = true;
+	  }
+
+	check_size_tree(stree);
+      }
+
+    check_order_stat(present);
+
+    stree.purge();
+  }
+
+// Parent links, for the abstractor that stores them.
+unsigned par[401];
+
+class parent_abstr : public size_abstr
+  {
+  public:
+
+    static handle get_parent(handle h)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("get_parent");
+	handle p = par[h & ~HIGH_BIT];
+	if (p != null())
+	  p |= HIGH_BIT;
+	return(p);
+      }
+
+    static void set_parent(handle h, handle p)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("set_parent");
+	if (p != null())
+	  p &= ~HIGH_BIT;
+	par[h & ~HIGH_BIT] = p;
+      }
+  };
+
+// AVL tree storing parent links, with public root for testing purposes.
+class t_parent_tree : public abstract_container::avl_tree<parent_abstr>
+  {
+  public:
+    handle &pub_root;
+
+    t_parent_tree(void) : pub_root(abs.root) { }
+  };
+
+t_parent_tree ptree, ptree2;
+
+// Verifies the parent links in a subtree.
+void verify_parent(unsigned subroot, unsigned parent)
+  {
+    if (subroot == abstr::null())
+      return;
+
+    subroot &= ~HIGH_BIT;
+
+    if (par[subroot] != parent)
+      {
+	printf("bad parent: n=%u stored=%u actual=%u\n",
+	       subroot, par[subroot], parent);
+	bail("verify_parent");
+      }
+
+    verify_parent(arr[subroot].lt, subroot);
+    verify_parent(arr[subroot].gt, subroot);
+  }
+
+// Verifies a tree storing parent links, and returns the number of nodes
+// in it.
+unsigned check_parent_tree(t_parent_tree &t)
+  {
+    if (t.pub_root == abstr::null())
+      {
+	if (t.num_nodes() != 0)
+	  bail("check_parent_tree empty");
+	return(0);
+      }
+
+    verify_tree(t.pub_root & ~HIGH_BIT);
+    verify_parent(t.pub_root, abstr::null());
+
+    unsigned n = verify_size(t.pub_root);
+    if (n != t.num_nodes())
+      bail("check_parent_tree");
+
+    return(n);
+  }
+
+// Check that iterating over the tree with parent_iter visits the nodes
+// that are known to be in the tree.
+void check_parent_iter(bool *present)
+  {
+    t_parent_tree::parent_iter it;
+    int i;
+
+    it.start_iter_least(ptree);
+    for (i = 0; i < 400; i++)
+      if (present[i])
+	{
+	  if (*it != (unsigned(i) | HIGH_BIT))
+	    bail("parent_iter increment");
+	  it++;
+	}
+    if (*it != abstr::null())
+      bail("parent_iter increment past end");
+
+    it.start_iter_greatest(ptree);
+    for (i = 399; i >= 0; i--)
+      if (present[i])
+	{
+	  if (*it != (unsigned(i) | HIGH_BIT))
+	    bail("parent_iter decrement");
+	  --it;
+	}
+    if (*it != abstr::null())
+      bail("parent_iter decrement past end");
+
+    for (int k = -1; k <= 800; k += 3)
+      for (i = 0; i < int(sizeof(all_st) / sizeof(all_st[0])); i++)
+	{
+	  it.start_iter(ptree, k, all_st[i]);
+	  if (*it != ptree.search(k, all_st[i]))
+	    bail("parent_iter start");
+	}
+  }
+
+void parent_test(void)
+  {
+    bool present[400];
+    unsigned i, j, step;
+    t_parent_tree::parent_iter it, it2;
+
+    for (i = 0; i < 400; i++)
+      present[i] = false;
+
+    srand(4);
+
+    // The iterator should remain valid while other nodes are inserted
+    // and removed.
+    ptree.insert(200 | HIGH_BIT);
+    present[200] = true;
+    it.start_iter_node(ptree, 200 | HIGH_BIT);
+
+    for (step = 0; step < 20000; step++)
+      {
+	j = unsigned(rand()) % 400;
+	if (j == 200)
+	  ;
+	else if (present[j])
+	  {
+	    num_cmp = 0;
+	    if (step & 1)
+	      {
+		if (ptree.remove_node(j | HIGH_BIT) != (j | HIGH_BIT))
+		  bail("parent_test remove_node");
+	      }
+	    else if (ptree.remove(2 * j) != (j | HIGH_BIT))
+	      bail("parent_test remove");
+	    if ((step & 1) and (num_cmp != 0))
+	      bail("parent_test remove_node comparisons");
+	    present[j] = false;
+	  }
+	else
+	  {
+	    if (ptree.insert(j | HIGH_BIT) != (j | HIGH_BIT))
+	      bail("parent_test insert");
+	    present[j] = true;
+	  }
+
+	check_parent_tree(ptree);
+
+	if ((step % 1000) == 0)
+	  {
+	    check_parent_iter(present);
+
+	    it2 = it;
+	    it2++;
+	    --it2;
+	    for (i = 201; (i < 400) and !present[i]; i++)
+	      ;
+	    if ((*it != (200 | HIGH_BIT)) or (*it2 != (200 | HIGH_BIT)))
+	      bail("parent_test long-lived iterator");
+	    it2++;
+	    if (*it2 != (i < 400 ? i | HIGH_BIT : abstr::null()))
+	      bail("parent_test long-lived iterator next");
+
+	    // Substituted node should get same parent and children.
+	    arr[400].val = 2 * 200;
+	    if (ptree.subst(400 | HIGH_BIT) != (200 | HIGH_BIT))
+	      bail("parent_test subst in");
+	    check_parent_tree(ptree);
+	    if (ptree.subst(200 | HIGH_BIT) != (400 | HIGH_BIT))
+	      bail("parent_test subst out");
+	  }
+      }
+
+    check_parent_iter(present);
+
+    // Remove all the remaining nodes by handle.
+    for (i = 0; i < 400; i++)
+      if (present[i])
+	{
+	  if (ptree.remove_node(i | HIGH_BIT) != (i | HIGH_BIT))
+	    bail("parent_test remove_node all");
+	  check_parent_tree(ptree);
+	}
+    if (ptree.pub_root != abstr::null())
+      bail("parent_test not empty");
+
+    // build(), split(), join(), remove_range(), the set operations and
+    // hinted insert must also maintain the parent links.
+    for (i = 0; i < 400; i++)
+      h_arr[i] = i | HIGH_BIT;
+    for (i = 0; i <= 400; i += 7)
+      {
+	ptree.parallel_build(h_arr, i, 4);
+	if (check_parent_tree(ptree) != i)
+	  bail("parent_test parallel_build");
+	ptree.build(h_arr, i);
+	if (check_parent_tree(ptree) != i)
+	  bail("parent_test build");
+	for (int k = -1; k <= int(2 * i); k += 11)
+	  {
+	    ptree.build(h_arr, i);
+	    if (!ptree.split(k, abstract_container::LESS_EQUAL, ptree2))
+	      bail("parent_test split");
+	    check_parent_tree(ptree);
+	    check_parent_tree(ptree2);
+	    if (!ptree.join(ptree, ptree2) or (check_parent_tree(ptree) != i))
+	      bail("parent_test join");
+	  }
+	for (int k = -1; k <= int(2 * i); k += 13)
+	  {
+	    ptree.build(h_arr, i);
+	    for (j = 0; j < 400; j++)
+	      dropped[j] = false;
+	    if (!ptree.remove_range(
+		  k, abstract_container::GREATER_EQUAL, k + 30,
+		  abstract_container::LESS, drop))
+	      bail("parent_test remove_range");
+	    check_parent_tree(ptree);
+	  }
+      }
+
+    // Nodes 200 - 399 get the keys of nodes 100 - 299.
+    for (j = 0; j < 200; j++)
+      {
+	arr[200 + j].val = 2 * (100 + j);
+	dropped[j] = false;
+	dropped[200 + j] = false;
+      }
+    ptree.build(h_arr, 200);
+    ptree2.build(h_arr + 200, 200);
+    if (!ptree.set_difference(ptree2, drop, 4))
+      bail("parent_test set_difference");
+    if (check_parent_tree(ptree) != 100)
+      bail("parent_test set_difference count");
+    if (!ptree.set_union(ptree2, drop, 4) or
+	(check_parent_tree(ptree) != 300))
+      bail("parent_test set_union");
+    for (j = 0; j < 200; j++)
+      arr[200 + j].val = 2 * (200 + j);
+
+    ptree.purge();
+    t_parent_tree::iter hint;
+    for (i = 0; i < 400; i++)
+      {
+	j = (i * 7) % 400;
+	if (ptree.insert(j | HIGH_BIT, hint) != (j | HIGH_BIT))
+	  bail("parent_test hinted insert");
+	check_parent_tree(ptree);
+      }
+
+    ptree.purge();
+    ptree2.purge();
+  }
+
+// Compare word_bset to std::bitset.
+template <unsigned num_bits>
+void one_bset_test(void)
+  {
+    abstract_container::word_bset<num_bits> wb;
+    std::bitset<num_bits> sb;
+    unsigned i, step;
+
+    wb.reset();
+    sb.reset();
+
+    for (step = 0; step < 1000; step++)
+      {
+	i = unsigned(rand()) % num_bits;
+	if ((step % 100) == 0)
+	  {
+	    if (step & 1)
+	      {
+		wb.set();
+		sb.set();
+	      }
+	    else
+	      {
+		wb.reset();
+		sb.reset();
+	      }
+	  }
+	else if (step % 3)
+	  {
+	    wb[i] = !!(rand() & 1);
+	    sb[i] = wb[i];
+	  }
+	else
+	  {
+	    // Assign one bit to another.
+	    unsigned j = unsigned(rand()) % num_bits;
+	    wb[i] = wb[j];
+	    sb[i] = sb[j];
+	  }
+	for (i = 0; i < num_bits; i++)
+	  if (bool(wb[i]) != bool(sb[i]))
+	    {
+	      printf("%u %u %u\n", num_bits, step, i);
+	      bail("bset_test");
+	    }
+      }
+  }
+
+// AVL tree using std::bitset, with public root for testing purposes.
+class t_bitset_tree
+  : public abstract_container::base_avl_tree<abstr, 32, std::bitset<32> >
+  {
+  public:
+    handle &pub_root;
+
+    t_bitset_tree(void) : pub_root(abs.root) { }
+  };
+
+void bset_test(void)
+  {
+    srand(5);
+
+    one_bset_test<1>();
+    one_bset_test<9>();
+    one_bset_test<32>();
+    one_bset_test<33>();
+    one_bset_test<64>();
+
+    // base_avl_tree must still work with std::bitset.
+    t_bitset_tree btree;
+    bool present[400];
+    unsigned i, j;
+
+    for (i = 0; i < 400; i++)
+      present[i] = false;
+
+    for (i = 0; i < 5000; i++)
+      {
+	j = unsigned(rand()) % 400;
+	if (present[j])
+	  {
+	    if (btree.remove(2 * j) != (j | HIGH_BIT))
+	      bail("bset_test remove");
+	  }
+	else if (btree.insert(j | HIGH_BIT) != (j | HIGH_BIT))
+	  bail("bset_test insert");
+	present[j] = !present[j];
+	if (btree.pub_root != abstr::null())
+	  verify_tree(btree.pub_root & ~HIGH_BIT);
+      }
+
+    t_bitset_tree::iter it;
+    it.start_iter_least(btree);
+    for (i = 0; i < 400; i++)
+      if (present[i])
+	{
+	  if (*it != (i | HIGH_BIT))
+	    bail("bset_test iter");
+	  it++;
+	}
+    if (*it != abstr::null())
+      bail("bset_test iter end");
+  }
+
+unsigned num_prefetch;
+
+class prefetch_abstr : public abstr
+  {
+  public:
+
+    static void prefetch(handle h)
+      {
+	if (!(h & HIGH_BIT))
+	  bail("prefetch");
+	num_prefetch++;
+      }
+  };
+
+// Compare search_batch() to search() for every search type, for keys
+// from one less than the least possible key to one more than the
+// greatest, in a scrambled order.
+template <class tree_t>
+void check_batch(tree_t &t)
+  {
+    const abstract_container::search_type all_st[] =
+      {
+	abstract_container::EQUAL,
+	abstract_container::LESS,
+	abstract_container::LESS_EQUAL,
+	abstract_container::GREATER,
+	abstract_container::GREATER_EQUAL
+      };
+    const unsigned num_keys = 803;
+
+    // Full groups, a partial group, and a single search.
+    const unsigned batch_size[] = { num_keys, 17, 1 };
+
+    int keys[num_keys];
+    unsigned out[num_keys];
+    unsigned i, s, b, n;
+
+    for (i = 0; i < num_keys; i++)
+      keys[i] = int((i * 7) % num_keys) - 1;
+
+    for (s = 0; s < 5; s++)
+      for (b = 0; b < 3; b++)
+	{
+	  n = batch_size[b];
+	  if (!t.search_batch(keys, n, out, all_st[s]))
+	    bail("search_batch read error");
+	  for (i = 0; i < n; i++)
+	    if (out[i] != t.search(keys[i], all_st[s]))
+	      {
+		printf("%d %x %x\n", keys[i], (unsigned) all_st[s], out[i]);
+		bail("search_batch");
+	      }
+	}
+  }
+
+void batch_test(void)
+  {
+    abstract_container::avl_tree<prefetch_abstr> ptree;
+    bool present[400];
+    unsigned i, j, trial;
+
+    srand(6);
+
+    tree.purge();
+
+    check_batch(tree);
+    check_batch(ptree);
+
+    for (trial = 0; trial < 6; trial++)
+      {
+	tree.purge();
+	for (i = 0; i < 400; i++)
+	  present[i] = false;
+
+	// Random trees, from sparse to full.
+	for (i = 0; i < (trial * trial * 40); i++)
+	  {
+	    j = unsigned(rand()) % 400;
+	    if (!present[j])
+	      {
+		tree.insert(j | HIGH_BIT);
+		present[j] = true;
+	      }
+	  }
+	check_batch(tree);
+
+	tree.purge();
+	for (i = 0; i < 400; i++)
+	  if (present[i])
+	    ptree.insert(i | HIGH_BIT);
+	num_prefetch = 0;
+	check_batch(ptree);
+	if ((trial > 0) and (num_prefetch == 0))
+	  bail("batch_test no prefetch");
+	ptree.purge();
+      }
+  }
+
+int main()
+  {
+    unsigned i;
+
+    printf(
+      "Empty member optimization is%s working\n",
+      sizeof(abstract_container::avl_tree<abstr>) == sizeof(unsigned) ?
+	"" : " NOT");
+
+    for (i = 0; i < 400; i++)
+      arr2[i].val = i * 2;
+
+    memcpy(arr, arr2, sizeof(arr));
+
+    max_elems = 3;
+    mark_bf();
+
+    printf("0 nodes\n");
+
+    check_empty();
+
+    search_all();
+
+    printf("1 node\n");
+
+    insert(1);
+    insert(1);
+    verify_tree();
+    search_all();
+    remove(2);
+    remove(2, true);
+    check_empty();
+
+    printf("2 nodes less slant\n");
+
+    insert(2);
+    insert(2);
+    insert(1);
+    insert(1);
+    verify_tree();
+    search_all();
+    remove(2);
+    remove(2, true);
+    insert(1);
+    verify_tree();
+    remove(4);
+    remove(4, true);
+    verify_tree();
+    remove(2);
+    check_empty();
+
+    printf("2 nodes greater slant\n");
+
+    insert(1);
+    insert(1);
+    insert(2);
+    insert(2);
+    verify_tree();
+    search_all();
+    remove(4);
+    remove(4, true);
+    insert(2);
+    verify_tree();
+    remove(2);
+    remove(2, true);
+    verify_tree();
+    remove(4);
+    check_empty();
+
+    max_elems = 400;
+
+    printf("%u nodes\n", max_elems);
+
+    mark_bf();
+
+    big_test(3, 7);
+    big_test(13, 7);
+
+    printf("all trees depth 3\n");
+
+    all_trees(3);
+
+    printf("all trees depth 4\n");
+
+    all_trees(4);
+
+    printf("all trees depth 5\n");
+
+    all_trees(5);
+
+    printf("build test\n");
+
+    build_test();
+
+    printf("split and join test\n");
+
+    split_join_test();
+
+    printf("set operation test\n");
+
+    set_op_test();
+
+    printf("range removal test\n");
+
+    remove_range_test();
+
+    printf("purge with visitor test\n");
+
+    purge_visit_test();
+
+    printf("subtree size test\n");
+
+    size_test();
+
+    printf("interval test\n");
+
+    interval_test();
+
+    printf("aggregate test\n");
+
+    agg_test();
+
+    printf("key prefix test\n");
+
+    prefix_test();
+
+    printf("finger test\n");
+
+    finger_test();
+
+    printf("parent link test\n");
+
+    parent_test();
+
+    printf("bset test\n");
+
+    bset_test();
+
+    printf("batch search test\n");
+
+    batch_test();
 
     printf("SUCCESS!\n");
 
@@ -0,0 +1,333 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// AVL Tree Snapshot Test.
+
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+
+#include "avl_snapshot.h"
+#include "avl_tree.h"
+
+// Check to make sure double inclusion OK.
+#include "avl_snapshot.h"
+
+void bail(const char *note)
+  {
+    printf("%s\n", note);
+    exit(1);
+  }
+
+const unsigned max_nodes = 1000;
+
+// Nodes.  Handles are indexes into this array.
+struct node_t
+  {
+    int val;
+    int data;
+    unsigned lt, gt;
+    int bf;
+    unsigned size;
+  };
+
+// The nodes of the saved tree, and the nodes of the loaded tree.
+node_t node[2 * max_nodes];
+
+unsigned num_cmp;
+
+// Number of calls to get_less() and get_greater().
+unsigned num_link;
+
+class abstr
+  {
+  public:
+
+    typedef unsigned handle;
+    typedef unsigned size;
+    typedef int key;
+
+    static handle get_less(handle h, bool)
+      {
+	num_link++;
+	return(node[h].lt);
+      }
+    static void set_less(handle h, handle lh) { node[h].lt = lh; }
+    static handle get_greater(handle h, bool)
+      {
+	num_link++;
+	return(node[h].gt);
+      }
+    static void set_greater(handle h, handle gh) { node[h].gt = gh; }
+    static int get_balance_factor(handle h) { return(node[h].bf); }
+    static void set_balance_factor(handle h, int bf) { node[h].bf = bf; }
+
+    static int compare_key_node(key k, handle h)
+      {
+	num_cmp++;
+	return(k < node[h].val ? -1 : (k > node[h].val ? 1 : 0));
+      }
+
+    static int compare_node_node(handle h1, handle h2)
+      { return(compare_key_node(node[h1].val, h2)); }
+
+    static bool read_error() { return(false); }
+
+    static handle null() { return(~0); }
+  };
+
+typedef abstract_container::avl_tree<abstr> tree_t;
+
+// Abstractor that also stores subtree sizes.
+class size_abstr : public abstr
+  {
+  public:
+
+    static size get_size(handle h) { return(node[h].size); }
+    static void set_size(handle h, size s) { node[h].size = s; }
+  };
+
+abstract_container::avl_tree<size_abstr> stree;
+
+tree_t tree, tree2;
+
+// In-memory stream.
+
+const unsigned stream_max = 20000;
+
+unsigned char stream[stream_max];
+
+unsigned stream_len, stream_pos;
+
+bool write(const void *data, unsigned num_bytes)
+  {
+    if ((stream_len + num_bytes) > stream_max)
+      return(false);
+    memcpy(stream + stream_len, data, num_bytes);
+    stream_len += num_bytes;
+    return(true);
+  }
+
+bool read(void *data, unsigned num_bytes)
+  {
+    if ((stream_pos + num_bytes) > stream_len)
+      return(false);
+    memcpy(data, stream + stream_pos, num_bytes);
+    stream_pos += num_bytes;
+    return(true);
+  }
+
+const unsigned payload_size = 8;
+
+void save(unsigned h, void *payload)
+  {
+    if (h >= max_nodes)
+      bail("save handle");
+
+    int *p = static_cast<int *>(payload);
+    p[0] = node[h].val;
+    p[1] = node[h].data;
+  }
+
+// Loaded nodes are allocated sequentially after the nodes of the saved
+// tree.
+unsigned next_load;
+
+unsigned load(const void *payload)
+  {
+    const int *p = static_cast<const int *>(payload);
+    unsigned h = next_load++;
+    node[h].val = p[0];
+    node[h].data = p[1];
+    return(h);
+  }
+
+unsigned char buf[1000];
+
+bool do_save(unsigned buf_size)
+  {
+    stream_len = 0;
+    return(
+      abstract_container::save_snapshot(
+	tree, payload_size, save, write, buf, buf_size));
+  }
+
+bool do_load(unsigned buf_size)
+  {
+    stream_pos = 0;
+    next_load = max_nodes;
+    return(
+      abstract_container::load_snapshot(
+	tree2, payload_size, read, load, buf, buf_size));
+  }
+
+// Check that tree2 has the same contents and shape as tree.
+void check_same(unsigned n)
+  {
+    tree_t::iter it, it2;
+    unsigned i = 0;
+
+    it.start_iter_least(tree);
+    it2.start_iter_least(tree2);
+    for ( ; *it != abstr::null(); it++, it2++, i++)
+      {
+	if (*it2 == abstr::null())
+	  bail("check_same short");
+	if ((node[*it].val != node[*it2].val) or
+	    (node[*it].data != node[*it2].data))
+	  bail("check_same value");
+	if ((node[*it].bf != node[*it2].bf) or
+	    ((node[*it].lt == abstr::null()) !=
+	     (node[*it2].lt == abstr::null())) or
+	    ((node[*it].gt == abstr::null()) !=
+	     (node[*it2].gt == abstr::null())))
+	  bail("check_same shape");
+      }
+    if ((*it2 != abstr::null()) or (i != n))
+      bail("check_same long");
+  }
+
+// Make tree contain n nodes, built with build() (so its shape matches
+// the shape of a tree loaded from a snapshot).
+void make_tree(unsigned n)
+  {
+    static unsigned h_arr[max_nodes];
+
+    for (unsigned i = 0; i < n; i++)
+      {
+	node[i].val = int(i * 3);
+	node[i].data = int(i * 7);
+	h_arr[i] = i;
+      }
+    tree.build(h_arr, n);
+  }
+
+int main()
+  {
+    unsigned n, i;
+    const unsigned sizes[] = { 0, 1, 2, 3, 7, 8, 100, 511, max_nodes };
+    const unsigned buf_sizes[] = { payload_size + 8, 37, sizeof(buf) };
+
+    printf("round trip test\n");
+
+    for (n = 0; n < (sizeof(sizes) / sizeof(sizes[0])); n++)
+      {
+	make_tree(sizes[n]);
+
+	for (i = 0; i < (sizeof(buf_sizes) / sizeof(buf_sizes[0])); i++)
+	  {
+	    if (!do_save(buf_sizes[i]))
+	      bail("save");
+
+	    // Load with each buffer size big enough for the blocks.
+	    for (unsigned j = i;
+		 j < (sizeof(buf_sizes) / sizeof(buf_sizes[0])); j++)
+	      {
+		num_cmp = 0;
+		if (!do_load(buf_sizes[j]))
+		  bail("load");
+		if (num_cmp != 0)
+		  bail("load compared keys");
+		check_same(sizes[n]);
+		if ((sizes[n] > 0) and
+		    (tree2.search(node[sizes[n] / 2].val) !=
+		     (max_nodes + (sizes[n] / 2))))
+		  bail("load search");
+	      }
+
+	    // Buffer too small for the blocks.
+	    if ((sizes[n] > 1) and (i > 0) and do_load(buf_sizes[0]))
+	      bail("load with small buffer");
+	  }
+      }
+
+    printf("corruption test\n");
+
+    make_tree(100);
+    if (!do_save(64))
+      bail("save 2");
+
+    // Every corrupted byte must be detected.
+    for (i = 0; i < stream_len; i++)
+      {
+	stream[i] ^= 0x10;
+	if (do_load(sizeof(buf)))
+	  {
+	    printf("%u\n", i);
+	    bail("corrupt byte not detected");
+	  }
+	if (!tree2.is_empty())
+	  bail("not empty after failed load");
+	stream[i] ^= 0x10;
+      }
+
+    // Every truncation must be detected.
+    unsigned full_len = stream_len;
+    for (stream_len = 0; stream_len < full_len; stream_len++)
+      if (do_load(sizeof(buf)))
+	{
+	  printf("%u\n", stream_len);
+	  bail("truncation not detected");
+	}
+    if (!do_load(sizeof(buf)))
+      bail("load 2");
+    check_same(100);
+
+    // Wrong payload size.
+    stream_pos = 0;
+    if (abstract_container::load_snapshot(
+	  tree2, payload_size + 1, read, load, buf, sizeof(buf)))
+      bail("load with wrong payload size");
+
+    // With subtree sizes, the nodes are only traversed once.  stree is
+    // built with the same nodes as tree, so it has the same shape.
+    make_tree(max_nodes);
+    if (!do_save(sizeof(buf)))
+      bail("save 3");
+    static unsigned char stream2[stream_max];
+    unsigned len2 = stream_len;
+    memcpy(stream2, stream, len2);
+    static unsigned h_arr[max_nodes];
+    for (i = 0; i < max_nodes; i++)
+      h_arr[i] = i;
+    stree.build(h_arr, max_nodes);
+    stream_len = 0;
+    num_link = 0;
+    if (!abstract_container::save_snapshot(
+	  stree, payload_size, save, write, buf, sizeof(buf)))
+      bail("save with sizes");
+    if ((stream_len != len2) or memcmp(stream, stream2, len2))
+      bail("save with sizes stream");
+    if (num_link > (3 * max_nodes))
+      {
+	printf("%u\n", num_link);
+	bail("save with sizes traversed twice");
+      }
+    stree.purge();
+
+    // Write error.
+    stream_len = stream_max - 100;
+    if (abstract_container::save_snapshot(
+	  tree, payload_size, save, write, buf, 64))
+      bail("no write error");
+
+    printf("SUCCESS!\n");
+
+    return(0);
+  }
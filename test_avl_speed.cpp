@@ -0,0 +1,1082 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Speed tests for the AVL tree template.
+
+Usage:  a.out [ total_ops [ mmap_file_path [ paged_file_path ] ] ]
+
+total_ops is the approximate total number of node operations done for each
+tree size (default 4000000).  The number of passes over a tree is total_ops
+divided by the tree size.
+
+The timings are wall clock time, so they are only meaningful on an
+otherwise idle machine.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <exception>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+
+#include "avl_tree.h"
+#include "eytz_index.h"
+#include "mmap_avl.h"
+#include "paged_avl.h"
+#include "arena_avl.h"
+
+using std::cout;
+
+void bail(const char *msg)
+  {
+    cout << msg << '\n';
+    std::terminate();
+  }
+
+// Accumulates the elapsed time over any number of start/stop intervals.
+class accum_tm
+  {
+  public:
+
+    accum_tm() : total(0) { }
+
+    void start() { beg = clk::now(); }
+
+    void stop() { total += clk::now() - beg; }
+
+    // Average nanoseconds per operation.
+    double ns_per(unsigned long long num_ops)
+      {
+	return(
+	  std::chrono::duration<double, std::nano>(total).count() / num_ops);
+      }
+
+  private:
+
+    typedef std::chrono::steady_clock clk;
+
+    clk::time_point beg;
+    clk::duration total;
+  };
+
+struct node
+  {
+    node *lt, *gt;
+    int bf;
+    unsigned key;
+  };
+
+class abstr
+  {
+  public:
+
+    typedef node *handle;
+    typedef unsigned key;
+    typedef std::size_t size;
+
+    static handle get_less(handle h, bool) { return(h->lt); }
+    static void set_less(handle h, handle lh) { h->lt = lh; }
+    static handle get_greater(handle h, bool) { return(h->gt); }
+    static void set_greater(handle h, handle gh) { h->gt = gh; }
+    static int get_balance_factor(handle h) { return(h->bf); }
+    static void set_balance_factor(handle h, int bf) { h->bf = bf; }
+
+    static int compare_key_node(key k, handle h)
+      { return(k < h->key ? -1 : (k > h->key ? 1 : 0)); }
+
+    static int compare_node_node(handle h1, handle h2)
+      { return(compare_key_node(h1->key, h2)); }
+
+    // For eytz_index.
+
+    static key get_key(handle h) { return(h->key); }
+
+    static int compare_key_key(key k1, key k2)
+      { return(k1 < k2 ? -1 : (k1 > k2 ? 1 : 0)); }
+
+    static handle null() { return(0); }
+
+    static bool read_error() { return(false); }
+  };
+
+// Same as abstr, with prefetching of nodes for search_batch().
+class abstr_pf : public abstr
+  {
+  public:
+
+    static void prefetch(handle h)
+      {
+	#if defined(__GNUC__)
+	__builtin_prefetch(h);
+	#else
+	(void) h;
+	#endif
+      }
+  };
+
+unsigned long long total_ops = 4000000;
+
+const unsigned tree_sizes[] = { 1000, 10000, 100000, 1000000 };
+const unsigned num_tree_sizes = sizeof(tree_sizes) / sizeof(tree_sizes[0]);
+
+// Nodes, in ascending key order.
+std::vector<node> nodes;
+
+// Pointers to the nodes, in random order.
+std::vector<node *> shuffled;
+
+void setup(unsigned num_nodes)
+  {
+    nodes.resize(num_nodes);
+    shuffled.resize(num_nodes);
+
+    for (unsigned i = 0; i < num_nodes; ++i)
+      {
+	nodes[i].key = 2 * i;
+	shuffled[i] = &nodes[i];
+      }
+
+    std::srand(num_nodes);
+    for (unsigned i = num_nodes; i > 1; --i)
+      std::swap(shuffled[i - 1], shuffled[unsigned(std::rand()) % i]);
+  }
+
+// Time insert, iteration and remove for a base_avl_tree using the given
+// bset.
+template <unsigned max_depth, class bset>
+void bset_speed(const char *name, unsigned num_nodes)
+  {
+    typedef abstract_container::base_avl_tree<abstr, max_depth, bset> tree_t;
+
+    tree_t tree;
+    accum_tm ins_tm, iter_tm, rm_tm;
+    unsigned num_passes = unsigned(total_ops / num_nodes);
+    unsigned i, pass;
+    unsigned long long sum = 0;
+
+    if (num_passes == 0)
+      num_passes = 1;
+
+    for (pass = 0; pass < num_passes; ++pass)
+      {
+	ins_tm.start();
+	for (i = 0; i < num_nodes; ++i)
+	  tree.insert(shuffled[i]);
+	ins_tm.stop();
+
+	iter_tm.start();
+	typename tree_t::iter it;
+	for (it.start_iter_least(tree); *it; ++it)
+	  sum += (*it)->key;
+	iter_tm.stop();
+
+	// Remove in the reverse of insertion order.
+	rm_tm.start();
+	for (i = num_nodes; i-- > 0; )
+	  if (!tree.remove(shuffled[i]->key))
+	    bail("remove failed");
+	rm_tm.stop();
+      }
+
+    if (sum != (num_passes * ((unsigned long long) num_nodes) *
+		(num_nodes - 1)))
+      bail("bad iteration sum");
+
+    unsigned long long num_ops = num_passes * (unsigned long long) num_nodes;
+
+    cout << std::setw(8) << num_nodes << "  " << std::setw(16) << name
+	 << std::fixed << std::setprecision(1)
+	 << std::setw(10) << ins_tm.ns_per(num_ops)
+	 << std::setw(10) << iter_tm.ns_per(num_ops)
+	 << std::setw(10) << rm_tm.ns_per(num_ops) << '\n';
+  }
+
+void bset_speed()
+  {
+    cout << "\nbset speed (nanoseconds per node)\n"
+	 << "   nodes  bset                  insert      iter    remove\n";
+
+    for (unsigned s = 0; s < num_tree_sizes; ++s)
+      {
+	setup(tree_sizes[s]);
+
+	bset_speed<32, std::bitset<32> >("std::bitset<32>", tree_sizes[s]);
+	bset_speed<32, abstract_container::word_bset<32> >(
+	  "word_bset<32>", tree_sizes[s]);
+	bset_speed<64, std::bitset<64> >("std::bitset<64>", tree_sizes[s]);
+	bset_speed<64, abstract_container::word_bset<64> >(
+	  "word_bset<64>", tree_sizes[s]);
+      }
+  }
+
+// Time searches with random keys (half of which are in the tree) with
+// the given search type, in an AVL tree and in frozen indexes built from
+// it.
+void frozen_speed(unsigned num_nodes, abstract_container::search_type st)
+  {
+    typedef abstract_container::avl_tree<abstr> tree_t;
+
+    tree_t tree;
+    abstract_container::eytz_index<abstr> idx;
+    abstract_container::eytz_index<abstr, false> idx_np;
+    std::vector<unsigned> keys(num_nodes + 1), queries(total_ops);
+    std::vector<node *> handles(num_nodes + 1);
+    accum_tm tree_tm, idx_tm, idx_np_tm;
+    unsigned long long i, found = 0, found_idx = 0, found_idx_np = 0;
+
+    std::vector<node *> ordered(num_nodes);
+    for (i = 0; i < num_nodes; ++i)
+      ordered[i] = &nodes[i];
+    tree.build(ordered.begin(), num_nodes);
+
+    if (!idx.build_from_tree(tree, &keys[0], &handles[0], num_nodes))
+      bail("build_from_tree failed");
+    idx_np.build(&keys[0], &handles[0], ordered.begin(), num_nodes);
+
+    std::srand(num_nodes + 1);
+    for (i = 0; i < total_ops; ++i)
+      queries[i] = unsigned(std::rand()) % (2 * num_nodes);
+
+    tree_tm.start();
+    for (i = 0; i < total_ops; ++i)
+      found += !!tree.search(queries[i], st);
+    tree_tm.stop();
+
+    idx_tm.start();
+    for (i = 0; i < total_ops; ++i)
+      found_idx += !!idx.search(queries[i], st);
+    idx_tm.stop();
+
+    idx_np_tm.start();
+    for (i = 0; i < total_ops; ++i)
+      found_idx_np += !!idx_np.search(queries[i], st);
+    idx_np_tm.stop();
+
+    if ((found != found_idx) || (found != found_idx_np))
+      bail("frozen index search mismatch");
+
+    cout << std::setw(8) << num_nodes << "  "
+	 << std::setw(13) << (st == abstract_container::EQUAL ?
+			      "EQUAL" : "LESS_EQUAL")
+	 << std::fixed << std::setprecision(1)
+	 << std::setw(10) << tree_tm.ns_per(total_ops)
+	 << std::setw(10) << idx_tm.ns_per(total_ops)
+	 << std::setw(12) << idx_np_tm.ns_per(total_ops) << '\n';
+  }
+
+void frozen_speed()
+  {
+    cout << "\nfrozen index search speed (nanoseconds per search)\n"
+	 << "   nodes  search type        tree     eytz  eytz (no pf)\n";
+
+    for (unsigned s = 0; s < num_tree_sizes; ++s)
+      {
+	setup(tree_sizes[s]);
+
+	frozen_speed(tree_sizes[s], abstract_container::EQUAL);
+	frozen_speed(tree_sizes[s], abstract_container::LESS_EQUAL);
+      }
+  }
+
+struct mmap_traits
+  {
+    typedef unsigned key;
+
+    // Node data for a tree in a memory-mapped file.
+    struct value
+      {
+	unsigned key;
+	unsigned data;
+      };
+
+    static int compare_key_value(key k, const value &v)
+      { return(k < v.key ? -1 : (k > v.key ? 1 : 0)); }
+
+    static int compare_value_value(const value &v1, const value &v2)
+      { return(compare_key_value(v1.key, v2)); }
+  };
+
+typedef abstract_container::mmap_avl_tree<mmap_traits> mmap_tree_t;
+
+const char *mmap_path = "/tmp/test_avl_speed_mmap.dat";
+
+// Compare the time to reopen a tree in a memory-mapped file to the time
+// to rebuild it with build().
+void mmap_speed()
+  {
+    unsigned num_nodes = unsigned(total_ops / 4);
+    if (num_nodes == 0)
+      num_nodes = 1;
+
+    std::vector<mmap_tree_t::handle> handles(num_nodes);
+    accum_tm reopen_tm, file_build_tm, mem_build_tm;
+    unsigned i;
+
+    unlink(mmap_path);
+
+    {
+      mmap_tree_t tree;
+
+      if (!tree.open(mmap_path, num_nodes))
+	bail("mmap open failed");
+      for (i = 0; i < num_nodes; ++i)
+	{
+	  handles[i] = tree.alloc();
+	  tree.val(handles[i]).key = 2 * i;
+	  tree.val(handles[i]).data = i;
+	}
+      tree.build(handles.begin(), num_nodes);
+    }
+
+    {
+      mmap_tree_t tree;
+
+      reopen_tm.start();
+      if (!tree.open(mmap_path))
+	bail("mmap reopen failed");
+      if (!tree.search(num_nodes))
+	bail("mmap search failed");
+      reopen_tm.stop();
+
+      file_build_tm.start();
+      tree.build(handles.begin(), num_nodes);
+      if (!tree.search(num_nodes))
+	bail("mmap search failed");
+      file_build_tm.stop();
+    }
+
+    setup(num_nodes);
+
+    {
+      abstract_container::avl_tree<abstr> tree;
+      std::vector<node *> ordered(num_nodes);
+
+      for (i = 0; i < num_nodes; ++i)
+	ordered[i] = &nodes[i];
+
+      mem_build_tm.start();
+      tree.build(ordered.begin(), num_nodes);
+      if (!tree.search(num_nodes))
+	bail("search failed");
+      mem_build_tm.stop();
+    }
+
+    unlink(mmap_path);
+
+    cout << "\nmemory-mapped file tree startup, " << num_nodes
+	 << " nodes (milliseconds)\n"
+	 << std::fixed << std::setprecision(3)
+	 << "reopen file:                       "
+	 << (reopen_tm.ns_per(1) / 1e6) << '\n'
+	 << "build() in file:                   "
+	 << (file_build_tm.ns_per(1) / 1e6) << '\n'
+	 << "build() in memory (nodes in RAM):  "
+	 << (mem_build_tm.ns_per(1) / 1e6) << '\n';
+  }
+
+// Time searches for random keys in the tree, calling search() for each
+// key, and calling search_batch() for groups of keys.
+template <class abs_t>
+void batch_speed(
+  unsigned num_nodes, const std::vector<unsigned> &queries,
+  double &serial_ns, double &batch16_ns, double &batch64_ns)
+  {
+    typedef abstract_container::avl_tree<abs_t, 48> tree_t;
+
+    tree_t tree;
+    std::vector<node *> out(64);
+    accum_tm serial_tm, batch16_tm, batch64_tm;
+    unsigned long long i, j, found = 0, found16 = 0, found64 = 0;
+
+    std::vector<node *> ordered(num_nodes);
+    for (i = 0; i < num_nodes; ++i)
+      ordered[i] = &nodes[i];
+    tree.build(ordered.begin(), num_nodes);
+
+    serial_tm.start();
+    for (i = 0; i < queries.size(); ++i)
+      found += !!tree.search(queries[i]);
+    serial_tm.stop();
+
+    batch16_tm.start();
+    for (i = 0; (i + 16) <= queries.size(); i += 16)
+      {
+	tree.search_batch(&queries[i], 16, &out[0]);
+	for (j = 0; j < 16; ++j)
+	  found16 += !!out[j];
+      }
+    batch16_tm.stop();
+
+    batch64_tm.start();
+    for (i = 0; (i + 64) <= queries.size(); i += 64)
+      {
+	tree.search_batch(&queries[i], 64, &out[0]);
+	for (j = 0; j < 64; ++j)
+	  found64 += !!out[j];
+      }
+    batch64_tm.stop();
+
+    // (queries.size() is a multiple of 64.)
+    if ((found != queries.size()) || (found16 != found) || (found64 != found))
+      bail("batch search failed");
+
+    serial_ns = serial_tm.ns_per(queries.size());
+    batch16_ns = batch16_tm.ns_per(queries.size());
+    batch64_ns = batch64_tm.ns_per(queries.size());
+  }
+
+void batch_speed(unsigned num_nodes)
+  {
+    std::vector<unsigned> queries(((total_ops + 63) / 64) * 64);
+    double serial_ns, batch16_ns, batch64_ns, unused, pf16_ns, pf64_ns;
+
+    setup(num_nodes);
+
+    std::srand(num_nodes + 2);
+    for (unsigned i = 0; i < queries.size(); ++i)
+      queries[i] = 2 * (unsigned(std::rand()) % num_nodes);
+
+    batch_speed<abstr>(num_nodes, queries, serial_ns, batch16_ns, batch64_ns);
+    batch_speed<abstr_pf>(num_nodes, queries, unused, pf16_ns, pf64_ns);
+
+    cout << std::setw(9) << num_nodes << std::fixed << std::setprecision(1)
+	 << std::setw(9) << serial_ns
+	 << std::setw(9) << batch16_ns << std::setw(9) << batch64_ns
+	 << std::setw(9) << pf16_ns << std::setw(9) << pf64_ns << '\n';
+  }
+
+void batch_speed()
+  {
+    cout << "\nbatch search speed (nanoseconds per search)\n"
+	 << "                     batch    batch  batch16  batch64\n"
+	 << "    nodes   serial       16       64    (pf)     (pf)\n";
+
+    for (unsigned s = 0; s < num_tree_sizes; ++s)
+      batch_speed(tree_sizes[s]);
+
+    // Nodes take 384 MB, larger than the last level cache of most
+    // machines.
+    if (total_ops >= 4000000)
+      batch_speed(16000000);
+  }
+
+// Time build() and parallel_build() with increasing numbers of threads.
+void build_speed()
+  {
+    typedef abstract_container::avl_tree<abstr, 48> tree_t;
+
+    unsigned num_nodes = unsigned(total_ops);
+    unsigned max_threads = 2 * std::thread::hardware_concurrency();
+    if (max_threads < 4)
+      max_threads = 4;
+
+    setup(num_nodes);
+
+    std::vector<node *> ordered(num_nodes);
+    for (unsigned i = 0; i < num_nodes; ++i)
+      ordered[i] = &nodes[i];
+
+    tree_t tree;
+    accum_tm build_tm;
+
+    build_tm.start();
+    tree.build(ordered.begin(), num_nodes);
+    build_tm.stop();
+
+    cout << "\nbuild speed, " << num_nodes << " nodes (milliseconds)\n"
+	 << std::fixed << std::setprecision(3)
+	 << "build():                   " << (build_tm.ns_per(1) / 1e6) << '\n';
+
+    for (unsigned t = 1; t <= max_threads; t *= 2)
+      {
+	accum_tm tm;
+
+	tm.start();
+	tree.parallel_build(ordered.begin(), num_nodes, t);
+	tm.stop();
+
+	if (tree.search(2 * (num_nodes - 1)) != &nodes[num_nodes - 1])
+	  bail("parallel_build failed");
+
+	cout << "parallel_build(), " << std::setw(3) << t << " threads: "
+	     << (tm.ns_per(1) / 1e6) << '\n';
+      }
+  }
+
+// Node with a value (its key) and the sum of the values in its subtree.
+struct agg_node : public node
+  {
+    unsigned long long sum;
+  };
+
+class agg_abstr
+  {
+  public:
+
+    typedef agg_node *handle;
+    typedef unsigned key;
+    typedef std::size_t size;
+    typedef unsigned long long agg;
+
+    static handle get_less(handle h, bool)
+      { return(static_cast<handle>(h->lt)); }
+    static void set_less(handle h, handle lh) { h->lt = lh; }
+    static handle get_greater(handle h, bool)
+      { return(static_cast<handle>(h->gt)); }
+    static void set_greater(handle h, handle gh) { h->gt = gh; }
+    static int get_balance_factor(handle h) { return(h->bf); }
+    static void set_balance_factor(handle h, int bf) { h->bf = bf; }
+
+    static int compare_key_node(key k, handle h)
+      { return(k < h->key ? -1 : (k > h->key ? 1 : 0)); }
+
+    static int compare_node_node(handle h1, handle h2)
+      { return(compare_key_node(h1->key, h2)); }
+
+    static agg agg_identity() { return(0); }
+    static agg combine(agg a1, agg a2) { return(a1 + a2); }
+    static agg get_node_agg(handle h) { return(h->key); }
+    static agg get_agg(handle h) { return(h->sum); }
+    static void set_agg(handle h, agg a) { h->sum = a; }
+
+    static handle null() { return(0); }
+
+    static bool read_error() { return(false); }
+  };
+
+// Time summing the values of the nodes with keys in a range of keys, with
+// aggregate(), and by iterating over the range.  There are about width
+// nodes in each range.
+void agg_speed(unsigned num_nodes, unsigned width)
+  {
+    typedef abstract_container::avl_tree<agg_abstr> tree_t;
+
+    std::vector<agg_node> a_nodes(num_nodes);
+    std::vector<agg_node *> h(num_nodes);
+    tree_t tree;
+    accum_tm agg_tm, iter_tm;
+    unsigned i, lo, hi;
+    unsigned long long agg_sum = 0, iter_sum = 0;
+
+    for (i = 0; i < num_nodes; ++i)
+      {
+	a_nodes[i].key = 2 * i;
+	h[i] = &a_nodes[i];
+      }
+    if (!tree.build(h.begin(), num_nodes))
+      bail("agg_speed build");
+
+    unsigned num_queries = unsigned(total_ops / width);
+
+    if (num_queries == 0)
+      num_queries = 1;
+
+    std::srand(num_nodes);
+    std::vector<unsigned> q_lo(num_queries);
+    for (i = 0; i < num_queries; ++i)
+      q_lo[i] = unsigned(std::rand()) % (2 * num_nodes);
+
+    agg_tm.start();
+    for (i = 0; i < num_queries; ++i)
+      {
+	lo = q_lo[i];
+	hi = lo + (2 * width);
+	agg_sum += tree.aggregate(
+		     lo, abstract_container::GREATER_EQUAL, hi,
+		     abstract_container::LESS);
+      }
+    agg_tm.stop();
+
+    iter_tm.start();
+    for (i = 0; i < num_queries; ++i)
+      {
+	lo = q_lo[i];
+	hi = lo + (2 * width);
+	tree_t::iter it;
+	for (it.start_iter(tree, lo, abstract_container::GREATER_EQUAL);
+	     *it && ((*it)->key < hi); ++it)
+	  iter_sum += (*it)->key;
+      }
+    iter_tm.stop();
+
+    if (agg_sum != iter_sum)
+      bail("agg_speed sum");
+
+    cout << std::setw(8) << num_nodes << std::setw(8) << width
+	 << std::fixed << std::setprecision(1)
+	 << std::setw(12) << agg_tm.ns_per(num_queries)
+	 << std::setw(12) << iter_tm.ns_per(num_queries) << '\n';
+  }
+
+void agg_speed()
+  {
+    cout << "\nrange aggregate speed (nanoseconds per range)\n"
+	 << "   nodes   width   aggregate        iter\n";
+
+    for (unsigned s = 0; s < num_tree_sizes; ++s)
+      for (unsigned w = 10; w <= tree_sizes[s]; w *= 10)
+	agg_speed(tree_sizes[s], w);
+  }
+
+// Node with a string key (like the env example), and the prefix of its
+// key.
+struct str_node
+  {
+    str_node *lt, *gt;
+    int bf;
+    uint64_t prefix;
+    const char *name;
+  };
+
+class str_abstr
+  {
+  public:
+
+    typedef str_node *handle;
+    typedef const char *key;
+    typedef std::size_t size;
+
+    static handle get_less(handle h, bool) { return(h->lt); }
+    static void set_less(handle h, handle lh) { h->lt = lh; }
+    static handle get_greater(handle h, bool) { return(h->gt); }
+    static void set_greater(handle h, handle gh) { h->gt = gh; }
+    static int get_balance_factor(handle h) { return(h->bf); }
+    static void set_balance_factor(handle h, int bf) { h->bf = bf; }
+
+    static int compare_key_node(key k, handle h)
+      { return(std::strcmp(k, h->name)); }
+
+    static int compare_node_node(handle h1, handle h2)
+      { return(std::strcmp(h1->name, h2->name)); }
+
+    static handle null() { return(0); }
+
+    static bool read_error() { return(false); }
+  };
+
+// String key with its prefix, so the prefix is only computed once per
+// search, rather than for every comparison.
+struct str_key
+  {
+    const char *s;
+    uint64_t prefix;
+
+    str_key(const char *s_)
+      : s(s_), prefix(abstract_container::str_key_prefix(s_)) { }
+  };
+
+// Same as str_abstr, with key prefixes.
+class str_abstr_kp : public str_abstr
+  {
+  public:
+
+    typedef str_key key;
+    typedef uint64_t key_prefix;
+
+    static int compare_key_node(key k, handle h)
+      { return(std::strcmp(k.s, h->name)); }
+
+    static key_prefix get_key_prefix(key k) { return(k.prefix); }
+
+    static key_prefix get_prefix(handle h) { return(h->prefix); }
+  };
+
+// Time inserting and searching for string keys.
+template <class abstractor>
+void str_speed(
+  std::vector<str_node> &s_nodes, const std::vector<std::string> &names,
+  accum_tm &ins_tm, accum_tm &srch_tm)
+  {
+    abstract_container::avl_tree<abstractor> tree;
+    unsigned num_nodes = unsigned(s_nodes.size());
+    unsigned num_passes = unsigned(total_ops / num_nodes);
+    unsigned i, pass;
+
+    if (num_passes == 0)
+      num_passes = 1;
+
+    for (pass = 0; pass < num_passes; ++pass)
+      {
+	tree.purge();
+
+	ins_tm.start();
+	for (i = 0; i < num_nodes; ++i)
+	  tree.insert(&s_nodes[i]);
+	ins_tm.stop();
+
+	srch_tm.start();
+	for (i = 0; i < num_nodes; ++i)
+	  if (tree.search(names[i].c_str()) != &s_nodes[i])
+	    bail("str_speed search");
+	srch_tm.stop();
+      }
+  }
+
+// Time inserting and searching for string keys, without and with key
+// prefixes.  All keys start with the same shared_len characters.
+void str_speed(unsigned num_nodes, unsigned shared_len)
+  {
+    std::vector<std::string> names(num_nodes);
+    std::vector<str_node> s_nodes(num_nodes);
+    accum_tm ins_tm, srch_tm, kp_ins_tm, kp_srch_tm;
+    unsigned i;
+    char buf[16];
+
+    // Keys are in random order, and unique, because they are a multiple
+    // of an odd number mod 2^32.
+    for (i = 0; i < num_nodes; ++i)
+      {
+	std::snprintf(buf, sizeof(buf), "%08X", i * 0x9E3779B1u);
+	names[i] = std::string(shared_len, 'P') + buf + "=value";
+	s_nodes[i].name = names[i].c_str();
+	s_nodes[i].prefix = abstract_container::str_key_prefix(names[i].c_str());
+      }
+
+    str_speed<str_abstr>(s_nodes, names, ins_tm, srch_tm);
+    str_speed<str_abstr_kp>(s_nodes, names, kp_ins_tm, kp_srch_tm);
+
+    unsigned long long num_ops =
+      std::max(total_ops / num_nodes, 1ULL) * num_nodes;
+
+    cout << std::setw(8) << num_nodes << std::setw(8) << shared_len
+	 << std::fixed << std::setprecision(1)
+	 << std::setw(10) << ins_tm.ns_per(num_ops)
+	 << std::setw(10) << kp_ins_tm.ns_per(num_ops)
+	 << std::setw(10) << srch_tm.ns_per(num_ops)
+	 << std::setw(10) << kp_srch_tm.ns_per(num_ops) << '\n';
+  }
+
+void str_speed()
+  {
+    cout << "\nstring key speed (nanoseconds per operation)\n"
+	 << "                        insert              search\n"
+	 << "   nodes  shared     plain    prefix     plain    prefix\n";
+
+    for (unsigned s = 0; s < num_tree_sizes; ++s)
+      for (unsigned shared_len = 0; shared_len <= 16; shared_len += 4)
+	str_speed(tree_sizes[s], shared_len);
+  }
+
+struct arena_traits
+  {
+    typedef unsigned key;
+    typedef unsigned value;
+
+    static int compare_key_value(key k, const value &v)
+      { return(k < v ? -1 : (k > v ? 1 : 0)); }
+
+    static int compare_value_value(const value &v1, const value &v2)
+      { return(compare_key_value(v1, v2)); }
+  };
+
+typedef abstract_container::arena_avl_tree<arena_traits, uint32_t, 1000000>
+  arena32_t;
+
+typedef abstract_container::arena_avl_tree<arena_traits, uint16_t, 32767>
+  arena16_t;
+
+// Too big for the stack.
+arena32_t arena32;
+arena16_t arena16;
+
+// Time random searches in an arena tree.  Returns nanoseconds per search.
+template <class tree_t>
+double arena_speed(tree_t &tree, const std::vector<unsigned> &queries)
+  {
+    unsigned num_nodes = unsigned(shuffled.size());
+    unsigned long long i, found = 0;
+    accum_tm tm;
+
+    // Like the pointer tree nodes, the nodes are allocated in key order,
+    // and inserted in random order.
+    tree.clear();
+    for (i = 0; i < num_nodes; ++i)
+      tree.val(tree.alloc()) = nodes[i].key;
+    for (i = 0; i < num_nodes; ++i)
+      tree.insert(typename tree_t::handle(shuffled[i] - &nodes[0]));
+
+    tm.start();
+    for (i = 0; i < total_ops; ++i)
+      found += tree.search(queries[i]) != tree_t::null();
+    tm.stop();
+
+    if (found != total_ops)
+      bail("arena_speed search");
+
+    return(tm.ns_per(total_ops));
+  }
+
+// Compare random searches in a tree of nodes with pointer links, and in
+// arena trees with 32-bit and 16-bit index links.
+void arena_speed(unsigned num_nodes)
+  {
+    abstract_container::avl_tree<abstr> tree;
+    std::vector<unsigned> queries(total_ops);
+    unsigned long long i, found = 0;
+    accum_tm tm;
+
+    for (i = 0; i < num_nodes; ++i)
+      tree.insert(shuffled[i]);
+
+    std::srand(num_nodes + 2);
+    for (i = 0; i < total_ops; ++i)
+      queries[i] = 2 * (unsigned(std::rand()) % num_nodes);
+
+    tm.start();
+    for (i = 0; i < total_ops; ++i)
+      found += !!tree.search(queries[i]);
+    tm.stop();
+
+    if (found != total_ops)
+      bail("arena_speed pointer search");
+
+    cout << std::setw(8) << num_nodes << std::fixed << std::setprecision(1)
+	 << std::setw(10) << tm.ns_per(total_ops)
+	 << std::setw(10) << arena_speed(arena32, queries);
+    if (num_nodes <= 32767)
+      cout << std::setw(10) << arena_speed(arena16, queries);
+    cout << '\n';
+  }
+
+void arena_speed()
+  {
+    cout << "\narena tree search speed (nanoseconds per search)\n"
+	 << "bytes per node:  pointer " << sizeof(node)
+	 << "  32-bit index " << arena32_t::node_size
+	 << "  16-bit index " << arena16_t::node_size << '\n'
+	 << "   nodes   pointer    32-bit    16-bit\n";
+
+    for (unsigned s = 0; s < num_tree_sizes; ++s)
+      {
+	setup(tree_sizes[s]);
+
+	arena_speed(tree_sizes[s]);
+      }
+  }
+
+// Free list for purge_speed().  Recycled nodes are linked through their
+// less links, which overwrites them, as freeing would.
+node *free_list;
+
+void recycle(node *h)
+  {
+    h->lt = free_list;
+    free_list = h;
+  }
+
+// Time emptying a tree and recycling its nodes, by walking it with an
+// iterator, and with purge(visitor).
+void purge_speed(unsigned num_nodes)
+  {
+    typedef abstract_container::avl_tree<abstr> tree_t;
+
+    tree_t tree;
+    accum_tm iter_tm, purge_tm;
+    unsigned num_passes = unsigned(total_ops / num_nodes);
+    unsigned i, pass;
+
+    if (num_passes == 0)
+      num_passes = 1;
+
+    for (pass = 0; pass < num_passes; ++pass)
+      {
+	for (i = 0; i < num_nodes; ++i)
+	  tree.insert(shuffled[i]);
+
+	// The iterator must move past a node before it is recycled.
+	free_list = 0;
+	iter_tm.start();
+	tree_t::iter it;
+	it.start_iter_least(tree);
+	while (*it)
+	  {
+	    node *h = *it;
+	    ++it;
+	    recycle(h);
+	  }
+	tree.purge();
+	iter_tm.stop();
+
+	for (i = 0; i < num_nodes; ++i)
+	  tree.insert(shuffled[i]);
+
+	free_list = 0;
+	purge_tm.start();
+	tree.purge(recycle);
+	purge_tm.stop();
+
+	for (i = 0; free_list; ++i)
+	  free_list = free_list->lt;
+	if (i != num_nodes)
+	  bail("purge missed nodes");
+      }
+
+    unsigned long long num_ops = num_passes * (unsigned long long) num_nodes;
+
+    cout << std::setw(8) << num_nodes << std::fixed << std::setprecision(1)
+	 << std::setw(10) << iter_tm.ns_per(num_ops)
+	 << std::setw(10) << purge_tm.ns_per(num_ops) << '\n';
+  }
+
+void purge_speed()
+  {
+    cout << "\npurge speed (nanoseconds per node)\n"
+	 << "   nodes      iter     purge\n";
+
+    for (unsigned s = 0; s < num_tree_sizes; ++s)
+      {
+	setup(tree_sizes[s]);
+
+	purge_speed(tree_sizes[s]);
+      }
+  }
+
+typedef abstract_container::paged_avl_tree<mmap_traits> paged_tree_t;
+
+const char *paged_path = "/tmp/test_avl_speed_paged.dat";
+
+// Random searches in a tree in a paged file, for a range of page cache
+// sizes relative to the size of the tree.  (The file will usually be in
+// the operating system's cache, so a page fault is a pread() that does
+// not wait for the disk.)
+void paged_speed(unsigned num_nodes)
+  {
+    unsigned num_pages =
+      (num_nodes + paged_tree_t::nodes_per_page - 1) /
+      paged_tree_t::nodes_per_page;
+    std::vector<paged_tree_t::frame> frames(num_pages + 1);
+    unsigned num_searches = unsigned(total_ops / 4);
+    unsigned i;
+
+    unlink(paged_path);
+
+    {
+      paged_tree_t tree;
+      std::vector<paged_tree_t::handle> handles(num_nodes);
+
+      if (!tree.open(paged_path, &frames[0], num_pages + 1))
+	bail("paged open failed");
+      for (i = 0; i < num_nodes; ++i)
+	{
+	  handles[i] = tree.alloc();
+	  tree.val(handles[i]).key = 2 * i;
+	  tree.val(handles[i]).data = i;
+	}
+      tree.build(handles.begin(), num_nodes);
+      if (!tree.close())
+	bail("paged close failed");
+    }
+
+    // Cache sizes, as divisors of the number of pages in the tree.
+    const unsigned divisor[] = { 1, 4, 16, 64, 256 };
+
+    for (unsigned d = 0; d < (sizeof(divisor) / sizeof(divisor[0])); ++d)
+      {
+	unsigned num_frames = num_pages / divisor[d];
+	if (num_frames < 2)
+	  continue;
+
+	paged_tree_t tree;
+	accum_tm tm;
+
+	if (!tree.open(paged_path, &frames[0], num_frames))
+	  bail("paged reopen failed");
+
+	// Warm up the cache.
+	std::srand(1);
+	for (i = 0; i < num_searches; ++i)
+	  tree.search(2 * (unsigned(std::rand()) % num_nodes));
+
+	tree.reset_stats();
+	tm.start();
+	for (i = 0; i < num_searches; ++i)
+	  if (!tree.search(2 * (unsigned(std::rand()) % num_nodes)))
+	    bail("paged search failed");
+	tm.stop();
+
+	if (tree.read_error())
+	  bail("paged read error");
+
+	const paged_tree_t::cache_stats &st = tree.stats();
+
+	cout << std::setw(8) << num_nodes << std::setw(8) << num_pages
+	     << std::setw(8) << num_frames << std::fixed << std::setprecision(1)
+	     << std::setw(10) << tm.ns_per(num_searches)
+	     << std::setw(9)
+	     << ((100.0 * st.hits) / (st.hits + st.faults))
+	     << std::setprecision(3) << std::setw(14)
+	     << (double(st.faults) / num_searches) << '\n';
+      }
+
+    unlink(paged_path);
+  }
+
+void paged_speed()
+  {
+    cout << "\npaged file tree random search, by page cache size\n"
+	 << "   nodes   pages  frames ns/search    hit % faults/search\n";
+
+    paged_speed(unsigned(total_ops / 40) + 1);
+    paged_speed(unsigned(total_ops / 4) + 1);
+  }
+
+int main(int n_arg, char **arg)
+  {
+    if (n_arg > 1)
+      {
+	total_ops = std::strtoull(arg[1], 0, 10);
+	if (total_ops == 0)
+	  bail("bad total_ops");
+      }
+
+    bset_speed();
+
+    frozen_speed();
+
+    batch_speed();
+
+    build_speed();
+
+    purge_speed();
+
+    agg_speed();
+
+    str_speed();
+
+    arena_speed();
+
+    if (n_arg > 2)
+      mmap_path = arg[2];
+
+    mmap_speed();
+
+    if (n_arg > 3)
+      paged_path = arg[3];
+
+    paged_speed();
+
+    return(0);
+  }
@@ -0,0 +1,314 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Concurrent AVL Tree Test.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <thread>
+
+#include "conc_avl.h"
+
+// Check to make sure double inclusion OK.
+#include "conc_avl.h"
+
+void bail(const char *note)
+  {
+    printf("%s\n", note);
+    exit(1);
+  }
+
+const unsigned num_threads = 4;
+
+const unsigned keys_per_thread = 300;
+
+const unsigned num_keys = num_threads * keys_per_thread;
+
+// Each thread has its own nodes, because a removed node may not be
+// released for a while.
+const unsigned nodes_per_thread = 4 * keys_per_thread;
+
+// The last node is the holder.
+const unsigned max_nodes = (num_threads * nodes_per_thread) + 1;
+
+const unsigned holder = max_nodes - 1;
+
+struct node_t
+  {
+    abstract_container::conc_avl_hook<node_t *> hook;
+    int key;
+
+    // Zero if free, otherwise 1.
+    std::atomic<int> state;
+  };
+
+node_t node[max_nodes];
+
+std::atomic<unsigned> num_released;
+
+class abstr
+  {
+  public:
+
+    typedef node_t *handle;
+    typedef int key;
+
+    static abstract_container::conc_avl_hook<handle> & get_hook(handle h)
+      { return(h->hook); }
+
+    static int compare_key_node(key k, handle h)
+      { return(k < h->key ? -1 : (k > h->key ? 1 : 0)); }
+
+    static int compare_node_node(handle h1, handle h2)
+      { return(compare_key_node(h1->key, h2)); }
+
+    static handle null() { return(0); }
+
+    static void release(handle h)
+      {
+	if (h->state.exchange(0) != 1)
+	  bail("bad release");
+	num_released++;
+      }
+  };
+
+typedef abstract_container::conc_avl_tree<abstr> tree_t;
+
+// Allocate a node from the ones for thread t.
+node_t * alloc(
+  tree_t &tree, tree_t::thread_ctx &ctx, unsigned t, unsigned &next)
+  {
+    for (unsigned tries = 0; ; ++tries)
+      {
+	node_t *h = node + (t * nodes_per_thread) + next;
+	if (++next == nodes_per_thread)
+	  next = 0;
+	if (h->state.load() == 0)
+	  {
+	    h->state.store(1);
+	    return(h);
+	  }
+	if ((tries % nodes_per_thread) == (nodes_per_thread - 1))
+	  {
+	    // Wait for other threads to unpin.
+	    tree.reclaim(ctx);
+	    std::this_thread::yield();
+	  }
+      }
+  }
+
+// Verifies a subtree (once there are no concurrent changes), with keys
+// greater than lo and less than hi.  Returns its height.  Counts the
+// present nodes in cnt.
+int verify(node_t *h, node_t *par, int lo, int hi, unsigned &cnt)
+  {
+    if (!h)
+      return(0);
+
+    if (h->hook.parent.load() != par)
+      bail("verify parent");
+    if ((h->key <= lo) || (h->key >= hi))
+      bail("verify order");
+    if (h->state.load() != 1)
+      bail("verify released");
+
+    node_t *lt = h->hook.less.load(), *gt = h->hook.greater.load();
+
+    if (h->hook.present.load())
+      ++cnt;
+    else if (!lt || !gt)
+      bail("verify routing");
+
+    int lh = verify(lt, h, lo, h->key, cnt),
+	gh = verify(gt, h, h->key, hi, cnt),
+	ht = (lh > gh ? lh : gh) + 1;
+
+    if ((lh - gh > 1) || (gh - lh > 1))
+      bail("verify balance");
+    if (h->hook.height.load() != ht)
+      bail("verify height");
+
+    return(ht);
+  }
+
+void verify(tree_t &tree, const bool *present)
+  {
+    unsigned cnt = 0, n = 0;
+
+    verify(node[holder].hook.greater.load(), node + holder, -1, num_keys,
+	   cnt);
+
+    tree_t::thread_ctx ctx(tree);
+
+    for (unsigned k = 0; k < num_keys; ++k)
+      {
+	node_t *h = tree.search(ctx, k);
+	if (present[k])
+	  {
+	    ++n;
+	    if (!h || (h->key != int(k)))
+	      bail("verify search");
+	  }
+	else if (h)
+	  bail("verify extra");
+      }
+
+    if (cnt != n)
+      bail("verify count");
+  }
+
+bool present[num_keys];
+
+// Thread t inserts and removes the keys k where k % num_threads is t, and
+// searches for any key.
+void thread_func(tree_t *tree, unsigned t, unsigned num_ops, unsigned seed)
+  {
+    tree_t::thread_ctx ctx(*tree);
+    unsigned next = 0, i;
+    int k;
+    node_t *h;
+
+    if (!ctx.valid())
+      bail("thread_ctx");
+
+    srand(seed);
+
+    for (i = 0; i < num_ops; ++i)
+      {
+	k = int(rand() % keys_per_thread) * int(num_threads) + int(t);
+
+	switch (rand() % 3)
+	  {
+	  case 0:
+	    if (present[k])
+	      {
+		h = tree->remove(ctx, k);
+		if (!h || (h->key != k))
+		  bail("remove");
+	      }
+	    else
+	      {
+		h = alloc(*tree, ctx, t, next);
+		h->key = k;
+		if (tree->insert(ctx, h) != h)
+		  bail("insert");
+	      }
+	    present[k] = !present[k];
+	    break;
+
+	  case 1:
+	    h = tree->search(ctx, k);
+	    if (present[k] ? (!h || (h->key != k)) : (h != 0))
+	      bail("search own");
+	    break;
+
+	  default:
+	    // Search for a key belonging to any thread.
+	    k = rand() % num_keys;
+	    ctx.pin();
+	    h = tree->search(ctx, k);
+	    if (h && ((h->key != k) || (h->state.load() != 1)))
+	      bail("search other");
+	    ctx.unpin();
+	    break;
+	  }
+      }
+  }
+
+void run(unsigned n_thr, unsigned num_ops)
+  {
+    unsigned t, in_use;
+
+    for (t = 0; t < max_nodes; ++t)
+      node[t].state.store(0);
+    for (t = 0; t < num_keys; ++t)
+      present[t] = false;
+    num_released = 0;
+
+    {
+      tree_t tree(node + holder);
+      std::thread *thr[num_threads];
+
+      for (t = 0; t < n_thr; ++t)
+	thr[t] = new std::thread(thread_func, &tree, t, num_ops, t + 1);
+      for (t = 0; t < n_thr; ++t)
+	{
+	  thr[t]->join();
+	  delete thr[t];
+	}
+
+      verify(tree, present);
+
+      // Also check that a second pass of removals and inserts leaves a
+      // valid tree.
+      thread_func(&tree, 0, num_ops, 99);
+      verify(tree, present);
+
+      {
+	// The nodes unlinked by the threads were left to the tree when
+	// their thread_ctx instances were destroyed.
+	tree_t::thread_ctx ctx(tree);
+
+	if (!tree.reclaim(ctx))
+	  bail("reclaim");
+      }
+
+      // Nodes in use are the ones in the tree (including routing nodes).
+      in_use = 0;
+      for (t = 0; t < max_nodes - 1; ++t)
+	if (node[t].state.load())
+	  ++in_use;
+      unsigned cnt = 0;
+      verify(node[holder].hook.greater.load(), node + holder, -1, num_keys,
+	     cnt);
+      unsigned n = 0;
+      for (t = 0; t < num_keys; ++t)
+	n += present[t];
+      if (cnt != n)
+	bail("present count");
+    }
+
+    // After the tree is destroyed, only present nodes are in use.
+    in_use = 0;
+    for (t = 0; t < max_nodes - 1; ++t)
+      if (node[t].state.load())
+	++in_use;
+    unsigned n = 0;
+    for (t = 0; t < num_keys; ++t)
+      n += present[t];
+    if (in_use != n)
+      bail("leak");
+  }
+
+int main()
+  {
+    printf("single thread test\n");
+
+    run(1, 100000);
+
+    printf("multiple thread test\n");
+
+    run(num_threads, 100000);
+
+    printf("SUCCESS!\n");
+
+    return(0);
+  }
@@ -0,0 +1,410 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Speed test of conc_avl_tree, versus avl_tree protected by a std::mutex, and
+avl_tree protected by an ru_shared_mutex (shared locks for searches).
+
+Usage:  a.out [ milliseconds_per_run ]
+
+Each run has some number of threads (1 to 64) doing a random mix of
+searches, inserts and removes on the same tree, for a fixed time (default
+250 milliseconds).  The output is the total operations per microsecond.
+The results are only meaningful on an otherwise idle machine, with as many
+cores as the larger thread counts.
+
+Requires C++17 (for ru_shared_mutex).  ru_shared_mutex.cpp must be linked
+in.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "avl_tree.h"
+#include "conc_avl.h"
+#include "ru_shared_mutex.h"
+
+using std::cout;
+
+void bail(const char *msg)
+  {
+    cout << msg << '\n';
+    std::terminate();
+  }
+
+const unsigned max_threads = 64;
+
+// Keys are 0 to num_keys - 1.  There is one node for each key.
+const unsigned num_keys = 1 << 16;
+
+struct node
+  {
+    // For avl_tree.
+    node *lt, *gt;
+    int bf;
+
+    abstract_container::conc_avl_hook<node *> hook;
+
+    unsigned key;
+
+    // Zero if the node is free, 1 if it is in use (in the tree, or waiting
+    // to be released by conc_avl_tree).
+    std::atomic<int> state;
+  };
+
+node nodes[num_keys + 1];
+
+// Node that holds the root of a conc_avl_tree.
+node * const holder = nodes + num_keys;
+
+class abstr
+  {
+  public:
+
+    typedef node *handle;
+    typedef unsigned key;
+    typedef std::size_t size;
+
+    static handle get_less(handle h, bool) { return(h->lt); }
+    static void set_less(handle h, handle lh) { h->lt = lh; }
+    static handle get_greater(handle h, bool) { return(h->gt); }
+    static void set_greater(handle h, handle gh) { h->gt = gh; }
+    static int get_balance_factor(handle h) { return(h->bf); }
+    static void set_balance_factor(handle h, int bf) { h->bf = bf; }
+
+    static abstract_container::conc_avl_hook<handle> & get_hook(handle h)
+      { return(h->hook); }
+
+    static int compare_key_node(key k, handle h)
+      { return(k < h->key ? -1 : (k > h->key ? 1 : 0)); }
+
+    static int compare_node_node(handle h1, handle h2)
+      { return(compare_key_node(h1->key, h2)); }
+
+    static handle null() { return(0); }
+
+    static bool read_error() { return(false); }
+
+    static void release(handle h) { h->state.store(0); }
+  };
+
+typedef abstract_container::avl_tree<abstr> avl_t;
+
+typedef abstract_container::conc_avl_tree<abstr, max_threads> conc_t;
+
+abstract_container::ru_shared_mutex::id id;
+typedef abstract_container::ru_shared_mutex::c<
+	  id, abstract_container::ru_shared_mutex::fast_ptd_func<id> > rusm_t;
+
+// Simple, fast pseudo-random number generator (xorshift).
+class rand_t
+  {
+  public:
+
+    explicit rand_t(std::uint32_t seed) : x(seed | 1) { }
+
+    std::uint32_t operator () ()
+      {
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return(x);
+      }
+
+  private:
+
+    std::uint32_t x;
+  };
+
+// Out of every 1000 operations, how many are inserts, and how many are
+// removes.  The rest are searches.
+unsigned per_mille_updates;
+
+std::atomic<bool> go, stop;
+std::atomic<unsigned> num_ready;
+std::atomic<unsigned long long> total_ops, total_found;
+
+// Each class wraps one kind of tree, and has a thread_func() that
+// searches, inserts and removes until stop is set.
+
+class locked_avl
+  {
+  public:
+
+    static const char * name() { return("avl_tree + std::mutex"); }
+
+    void prefill(unsigned k) { tree.insert(nodes + k); }
+
+    void thread_func(unsigned t);
+
+  private:
+
+    avl_t tree;
+    std::mutex mtx;
+  };
+
+class rusm_avl
+  {
+  public:
+
+    static const char * name() { return("avl_tree + ru_shared_mutex"); }
+
+    void prefill(unsigned k) { tree.insert(nodes + k); }
+
+    void thread_func(unsigned t);
+
+  private:
+
+    avl_t tree;
+  };
+
+class conc_avl
+  {
+  public:
+
+    conc_avl() : tree(holder) { }
+
+    static const char * name() { return("conc_avl_tree"); }
+
+    void prefill(unsigned k)
+      {
+	conc_t::thread_ctx ctx(tree);
+	tree.insert(ctx, nodes + k);
+      }
+
+    void thread_func(unsigned t);
+
+  private:
+
+    conc_t tree;
+  };
+
+// Does the operations common to all the thread functions.  search(k),
+// insert(h) and remove(k) do the operations on the tree, with any needed
+// locking.  remove() must return the removed node or null.  The node is
+// freed by free_node(h).
+template <class search_t, class insert_t, class remove_t, class free_t>
+void do_ops(
+  unsigned t, search_t search, insert_t insert, remove_t remove,
+  free_t free_node)
+  {
+    rand_t rnd(t + 1);
+    unsigned long long ops = 0, found = 0;
+    unsigned r, k;
+    node *h;
+
+    ++num_ready;
+    while (!go)
+      std::this_thread::yield();
+
+    while (!stop)
+      {
+	r = rnd();
+	k = (r >> 10) % num_keys;
+	r %= 1000;
+	if (r < per_mille_updates)
+	  {
+	    h = nodes + k;
+	    int expected = 0;
+	    if (h->state.compare_exchange_strong(expected, 1))
+	      {
+		h->key = k;
+		if (insert(h) != h)
+		  bail("insert");
+	      }
+	  }
+	else if (r < (2 * per_mille_updates))
+	  {
+	    h = remove(k);
+	    if (h)
+	      free_node(h);
+	  }
+	else if (search(k))
+	  // Use the result, so the search is not optimized away.
+	  ++found;
+	++ops;
+      }
+
+    total_ops += ops;
+    total_found += found;
+  }
+
+void locked_avl::thread_func(unsigned t)
+  {
+    do_ops(
+      t,
+      [this](unsigned k)
+	{
+	  std::lock_guard<std::mutex> lg(mtx);
+	  return(tree.search(k));
+	},
+      [this](node *h)
+	{
+	  std::lock_guard<std::mutex> lg(mtx);
+	  return(tree.insert(h));
+	},
+      [this](unsigned k)
+	{
+	  std::lock_guard<std::mutex> lg(mtx);
+	  return(tree.remove(k));
+	},
+      [](node *h) { h->state.store(0); });
+  }
+
+void rusm_avl::thread_func(unsigned t)
+  {
+    do_ops(
+      t,
+      [this](unsigned k)
+	{
+	  std::shared_lock<rusm_t> sl(rusm_t::inst());
+	  return(tree.search(k));
+	},
+      [this](node *h)
+	{
+	  std::unique_lock<rusm_t> ul(rusm_t::inst());
+	  return(tree.insert(h));
+	},
+      [this](unsigned k)
+	{
+	  std::unique_lock<rusm_t> ul(rusm_t::inst());
+	  return(tree.remove(k));
+	},
+      [](node *h) { h->state.store(0); });
+  }
+
+void conc_avl::thread_func(unsigned t)
+  {
+    conc_t::thread_ctx ctx(tree);
+
+    if (!ctx.valid())
+      bail("thread_ctx");
+
+    do_ops(
+      t,
+      [this, &ctx](unsigned k) { return(tree.search(ctx, k)); },
+      [this, &ctx](node *h) { return(tree.insert(ctx, h)); },
+      [this, &ctx](unsigned k) { return(tree.remove(ctx, k)); },
+      // Freed by release().
+      [](node *) { });
+  }
+
+unsigned run_ms = 250;
+
+template <class tree_t>
+void speed(unsigned num_threads)
+  {
+    unsigned k;
+
+    for (k = 0; k < num_keys; ++k)
+      nodes[k].state.store(0);
+
+    // The constructor, and destructor of conc_avl_tree access the nodes.
+    {
+      tree_t tree;
+
+      // Start with every other key in the tree.
+      for (k = 0; k < num_keys; k += 2)
+	{
+	  nodes[k].key = k;
+	  nodes[k].state.store(1);
+	  tree.prefill(k);
+	}
+
+      std::thread thr[max_threads];
+
+      go = false;
+      stop = false;
+      num_ready = 0;
+      total_ops = 0;
+
+      for (unsigned t = 0; t < num_threads; ++t)
+	thr[t] = std::thread(&tree_t::thread_func, &tree, t);
+
+      while (num_ready < num_threads)
+	std::this_thread::yield();
+
+      std::chrono::steady_clock::time_point beg =
+	std::chrono::steady_clock::now();
+
+      go = true;
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(run_ms));
+
+      stop = true;
+
+      for (unsigned t = 0; t < num_threads; ++t)
+	thr[t].join();
+
+      double us =
+	std::chrono::duration<double, std::micro>(
+	  std::chrono::steady_clock::now() - beg).count();
+
+      cout << std::setw(8) << std::setprecision(3) << std::fixed
+	   << (total_ops / us) << std::flush;
+    }
+  }
+
+template <class tree_t>
+void speed_all()
+  {
+    cout << std::setw(28) << std::left << tree_t::name() << std::right;
+    for (unsigned n = 1; n <= max_threads; n *= 2)
+      speed<tree_t>(n);
+    cout << '\n';
+  }
+
+void mix(unsigned per_mille_updates_)
+  {
+    per_mille_updates = per_mille_updates_;
+
+    cout << "\nOperations per microsecond, " << (per_mille_updates / 10)
+	 << '.' << (per_mille_updates % 10) << "% inserts and removes each, "
+	 << "the rest searches, " << num_keys << " keys\n";
+    cout << std::setw(28) << std::left << "threads:" << std::right;
+    for (unsigned n = 1; n <= max_threads; n *= 2)
+      cout << std::setw(8) << n;
+    cout << '\n';
+
+    speed_all<conc_avl>();
+    speed_all<locked_avl>();
+    speed_all<rusm_avl>();
+  }
+
+int main(int n_arg, char **arg)
+  {
+    if (n_arg > 1)
+      {
+	run_ms = unsigned(std::strtoul(arg[1], 0, 10));
+	if (run_ms == 0)
+	  bail("bad milliseconds_per_run");
+      }
+
+    mix(5);
+    mix(50);
+
+    return(0);
+  }
@@ -0,0 +1,212 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Unit testing for conc_hash_table.h .  Requires C++17.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <thread>
+
+#include "conc_hash_table.h"
+#include "conc_hash_table.h"
+
+void bail(const char *note)
+  {
+    printf("%s\n", note);
+    exit(1);
+  }
+
+using namespace abstract_container;
+
+const unsigned num_threads = 4;
+
+const unsigned keys_per_thread = 300;
+
+const unsigned num_keys = num_threads * keys_per_thread;
+
+// Fewer buckets than stripes, so some stripes have no buckets.
+const unsigned num_buckets = 37;
+
+struct Elem
+  {
+    unsigned key;
+    unsigned hash;
+    Elem *link;
+  };
+
+// Element for key k is e[k].
+Elem e[num_keys];
+
+// Only changed by the thread that inserts and removes the key.
+bool present[num_keys];
+
+class Abs
+  {
+  private:
+
+    struct List_abs
+      {
+        static const bool store_tail = false;
+        typedef Elem *handle;
+        static handle null() { return(nullptr); }
+        static handle link(handle h) { return(h->link); }
+        static void link(handle h, handle link_h) { h->link = link_h; }
+      };
+
+  protected:
+
+    typedef abstract_container::list<List_abs> list;
+    typedef unsigned index;
+    typedef unsigned key;
+
+    static const index num_hash_values = num_buckets;
+
+    static bool is_key(key k, Elem *h) { return(h->key == k); }
+
+    static index hash_key(key k) { return((k * 0x9E3779B1u) % num_buckets); }
+
+    static index hash_elem(Elem *h) { return(hash_key(h->key)); }
+  };
+
+// Abstractor that stores hash values in the elements.
+class Stored_abs : public Abs
+  {
+  protected:
+
+    static index hash_key(key k) { return(k * 0x9E3779B1u); }
+
+    static index hash_elem(Elem *h) { return(hash_key(h->key)); }
+
+    static void set_hash(Elem *h, index hash_value) { h->hash = hash_value; }
+
+    static index get_hash(Elem *h) { return(h->hash); }
+  };
+
+template <class table_t>
+void verify(table_t &table)
+  {
+    for (unsigned k = 0; k < num_keys; ++k)
+      if (table.search(k) != (present[k] ? (e + k) : nullptr))
+        bail("verify");
+  }
+
+// Thread t inserts and removes the keys k where k % num_threads is t, and
+// searches for any key.
+template <class table_t>
+void thread_func(table_t *table, unsigned t, unsigned num_ops, unsigned seed)
+  {
+    unsigned i, k;
+    Elem *h;
+
+    srand(seed);
+
+    for (i = 0; i < num_ops; ++i)
+      {
+        k = (unsigned(rand()) % keys_per_thread) * num_threads + t;
+
+        switch (rand() % 4)
+          {
+          case 0:
+            if (present[k])
+              {
+                if (table->remove_key(k) != (e + k))
+                  bail("remove_key");
+              }
+            else
+              table->insert(e + k);
+            present[k] = !present[k];
+            break;
+
+          case 1:
+            if (present[k])
+              {
+                table->remove(e + k);
+                present[k] = false;
+              }
+            else if (table->remove_key(k))
+              bail("remove_key absent");
+            break;
+
+          case 2:
+            h = table->search(k);
+            if (h != (present[k] ? (e + k) : nullptr))
+              bail("search own");
+            break;
+
+          default:
+            // Search for a key belonging to any thread.
+            k = unsigned(rand()) % num_keys;
+            h = table->search(k);
+            if (h && (h != (e + k)))
+              bail("search other");
+            break;
+          }
+      }
+  }
+
+template <class table_t>
+void run(const char *name, unsigned n_thr, unsigned num_ops)
+  {
+    unsigned t;
+
+    printf("%s, %u threads\n", name, n_thr);
+
+    for (t = 0; t < num_keys; ++t)
+      {
+        e[t].key = t;
+        present[t] = false;
+      }
+
+    table_t *table = new table_t;
+    std::thread thr[num_threads];
+
+    for (t = 0; t < n_thr; ++t)
+      thr[t] = std::thread(thread_func<table_t>, table, t, num_ops, t + 1);
+    for (t = 0; t < n_thr; ++t)
+      thr[t].join();
+
+    verify(*table);
+
+    table->purge();
+    for (t = 0; t < num_keys; ++t)
+      present[t] = false;
+    verify(*table);
+
+    delete table;
+  }
+
+template <class table_t>
+void run_all(const char *name)
+  {
+    run<table_t>(name, 1, 100000);
+    run<table_t>(name, num_threads, 100000);
+  }
+
+int main()
+  {
+    run_all<conc_hash_table<Abs> >("spinlock");
+    run_all<conc_hash_table<Abs, std::shared_mutex> >("std::shared_mutex");
+    run_all<conc_hash_table<Stored_abs, conc_hash_spinlock, 8> >(
+      "stored hash values, 8 stripes");
+
+    printf("SUCCESS!\n");
+
+    return(0);
+  }
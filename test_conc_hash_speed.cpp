@@ -0,0 +1,331 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Speed test of conc_hash_table (with spinlock and std::shared_mutex stripe
+locks), versus hash_table protected by a single std::mutex.
+
+Usage:  a.out [ milliseconds_per_run ]
+
+Each run has some number of threads (1 to 64) doing a random mix of
+searches, inserts and removes on the same table, for a fixed time (default
+250 milliseconds).  The output is the total operations per microsecond.
+The results are only meaningful on an otherwise idle machine, with as many
+cores as the larger thread counts.
+
+Requires C++17.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <exception>
+#include <cstdlib>
+#include <cstdint>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+
+#include "hash_table.h"
+#include "conc_hash_table.h"
+
+using std::cout;
+
+void bail(const char *msg)
+  {
+    cout << msg << '\n';
+    std::terminate();
+  }
+
+const unsigned max_threads = 64;
+
+// Keys are 0 to num_keys - 1.  There is one element for each key.
+const unsigned num_keys = 1 << 16;
+
+const unsigned num_buckets = 1 << 16;
+
+struct Elem
+  {
+    unsigned key;
+    Elem *link;
+
+    // Zero if the element is free, 1 if it is in the table.
+    std::atomic<int> state;
+  };
+
+Elem elems[num_keys];
+
+class Abs
+  {
+  private:
+
+    struct List_abs
+      {
+        static const bool store_tail = false;
+        typedef Elem *handle;
+        static handle null() { return(nullptr); }
+        static handle link(handle h) { return(h->link); }
+        static void link(handle h, handle link_h) { h->link = link_h; }
+      };
+
+  protected:
+
+    typedef abstract_container::list<List_abs> list;
+    typedef unsigned index;
+    typedef unsigned key;
+
+    static const index num_hash_values = num_buckets;
+
+    static bool is_key(key k, Elem *h) { return(h->key == k); }
+
+    static index hash_key(key k)
+      {
+        index h = k * 0x9E3779B1u;
+
+        return((h ^ (h >> 15)) % num_buckets);
+      }
+
+    static index hash_elem(Elem *h) { return(hash_key(h->key)); }
+  };
+
+// Simple, fast pseudo-random number generator (xorshift).
+class rand_t
+  {
+  public:
+
+    explicit rand_t(std::uint32_t seed) : x(seed | 1) { }
+
+    std::uint32_t operator () ()
+      {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return(x);
+      }
+
+  private:
+
+    std::uint32_t x;
+  };
+
+// Out of every 1000 operations, how many are inserts, and how many are
+// removes.  The rest are searches.
+unsigned per_mille_updates;
+
+std::atomic<bool> go, stop;
+std::atomic<unsigned> num_ready;
+std::atomic<unsigned long long> total_ops, total_found;
+
+// Each class wraps one kind of table, with search(), insert() and
+// remove_key() doing any needed locking.
+
+class locked_hash
+  {
+  public:
+
+    static const char * name() { return("hash_table + std::mutex"); }
+
+    Elem * search(unsigned k)
+      {
+        std::lock_guard<std::mutex> lg(mtx);
+        return(table.search(k));
+      }
+
+    void insert(Elem *h)
+      {
+        std::lock_guard<std::mutex> lg(mtx);
+        table.insert(h);
+      }
+
+    Elem * remove_key(unsigned k)
+      {
+        std::lock_guard<std::mutex> lg(mtx);
+        return(table.remove_key(k));
+      }
+
+  private:
+
+    abstract_container::hash_table<Abs> table;
+    std::mutex mtx;
+  };
+
+template <class lock_t>
+class striped_hash
+  {
+  public:
+
+    static const char * name();
+
+    Elem * search(unsigned k) { return(table.search(k)); }
+
+    void insert(Elem *h) { table.insert(h); }
+
+    Elem * remove_key(unsigned k) { return(table.remove_key(k)); }
+
+  private:
+
+    abstract_container::conc_hash_table<Abs, lock_t> table;
+  };
+
+template <>
+const char * striped_hash<abstract_container::conc_hash_spinlock>::name()
+  { return("conc_hash_table spinlock"); }
+
+template <>
+const char * striped_hash<std::shared_mutex>::name()
+  { return("conc_hash_table shared_mutex"); }
+
+template <class table_t>
+void thread_func(table_t *table, unsigned t)
+  {
+    rand_t rnd(t + 1);
+    unsigned long long ops = 0, found = 0;
+    unsigned r, k;
+    Elem *h;
+
+    ++num_ready;
+    while (!go)
+      std::this_thread::yield();
+
+    while (!stop)
+      {
+        r = rnd();
+        k = (r >> 10) % num_keys;
+        r %= 1000;
+        if (r < per_mille_updates)
+          {
+            h = elems + k;
+            int expected = 0;
+            if (h->state.compare_exchange_strong(expected, 1))
+              table->insert(h);
+          }
+        else if (r < (2 * per_mille_updates))
+          {
+            h = table->remove_key(k);
+            if (h)
+              h->state.store(0);
+          }
+        else if (table->search(k))
+          // Use the result, so the search is not optimized away.
+          ++found;
+        ++ops;
+      }
+
+    total_ops += ops;
+    total_found += found;
+  }
+
+unsigned run_ms = 250;
+
+template <class table_t>
+void speed(unsigned num_threads)
+  {
+    table_t *table = new table_t;
+    unsigned k;
+
+    // Start with every other key in the table.
+    for (k = 0; k < num_keys; ++k)
+      {
+        elems[k].key = k;
+        elems[k].state.store(k % 2 ? 0 : 1);
+        if (!(k % 2))
+          table->insert(elems + k);
+      }
+
+    std::thread thr[max_threads];
+
+    go = false;
+    stop = false;
+    num_ready = 0;
+    total_ops = 0;
+
+    for (unsigned t = 0; t < num_threads; ++t)
+      thr[t] = std::thread(thread_func<table_t>, table, t);
+
+    while (num_ready < num_threads)
+      std::this_thread::yield();
+
+    std::chrono::steady_clock::time_point beg =
+      std::chrono::steady_clock::now();
+
+    go = true;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(run_ms));
+
+    stop = true;
+
+    for (unsigned t = 0; t < num_threads; ++t)
+      thr[t].join();
+
+    double us =
+      std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - beg).count();
+
+    delete table;
+
+    cout << std::setw(8) << std::setprecision(2) << std::fixed
+         << (total_ops / us) << std::flush;
+  }
+
+template <class table_t>
+void speed_all()
+  {
+    cout << std::setw(30) << std::left << table_t::name() << std::right;
+    for (unsigned n = 1; n <= max_threads; n *= 2)
+      speed<table_t>(n);
+    cout << '\n';
+  }
+
+void mix(unsigned per_mille_updates_)
+  {
+    per_mille_updates = per_mille_updates_;
+
+    cout << "\nOperations per microsecond, " << (per_mille_updates / 10)
+         << '.' << (per_mille_updates % 10) << "% inserts and removes each, "
+         << "the rest searches, " << num_keys << " keys\n";
+    cout << std::setw(30) << std::left << "threads:" << std::right;
+    for (unsigned n = 1; n <= max_threads; n *= 2)
+      cout << std::setw(8) << n;
+    cout << '\n';
+
+    speed_all<striped_hash<abstract_container::conc_hash_spinlock> >();
+    speed_all<striped_hash<std::shared_mutex> >();
+    speed_all<locked_hash>();
+  }
+
+int main(int n_arg, char **arg)
+  {
+    if (n_arg > 1)
+      {
+        run_ms = unsigned(std::strtoul(arg[1], 0, 10));
+        if (run_ms == 0)
+          bail("bad milliseconds_per_run");
+      }
+
+    cout << "\nhardware threads:  " << std::thread::hardware_concurrency()
+         << '\n';
+
+    // Read-only, read-mostly, and update-heavy.
+    mix(0);
+    mix(50);
+    mix(250);
+
+    return(0);
+  }
@@ -0,0 +1,178 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Frozen Eytzinger Index Template Test.
+
+#include "stdio.h"
+#include "stdlib.h"
+
+#include "eytz_index.h"
+#include "avl_tree.h"
+
+// Check to make sure double inclusion OK.
+#include "eytz_index.h"
+
+void bail(const char *note)
+  {
+    printf("%s\n", note);
+    exit(1);
+  }
+
+const unsigned max_nodes = 300;
+
+// Nodes.  Handles are indexes into this array.
+static struct
+  {
+    int val;
+    unsigned lt, gt;
+    int bf;
+  }
+node[max_nodes];
+
+// Abstractor for both the index and the AVL tree.
+class abstr
+  {
+  public:
+
+    typedef unsigned handle;
+    typedef unsigned size;
+    typedef int key;
+
+    // For the index.
+
+    static key get_key(handle h) { return(node[h].val); }
+
+    static int compare_key_key(key k1, key k2)
+      { return(k1 < k2 ? -1 : (k1 > k2 ? 1 : 0)); }
+
+    // For the tree.
+
+    static handle get_less(handle h, bool) { return(node[h].lt); }
+    static void set_less(handle h, handle lh) { node[h].lt = lh; }
+    static handle get_greater(handle h, bool) { return(node[h].gt); }
+    static void set_greater(handle h, handle gh) { node[h].gt = gh; }
+    static int get_balance_factor(handle h) { return(node[h].bf); }
+    static void set_balance_factor(handle h, int bf) { node[h].bf = bf; }
+
+    static int compare_key_node(key k, handle h)
+      { return(compare_key_key(k, node[h].val)); }
+
+    static int compare_node_node(handle h1, handle h2)
+      { return(compare_key_key(node[h1].val, node[h2].val)); }
+
+    static bool read_error() { return(false); }
+
+    static handle null() { return(~0); }
+  };
+
+const abstract_container::search_type all_st[] =
+  {
+    abstract_container::EQUAL,
+    abstract_container::LESS,
+    abstract_container::LESS_EQUAL,
+    abstract_container::GREATER,
+    abstract_container::GREATER_EQUAL
+  };
+
+const unsigned num_st = sizeof(all_st) / sizeof(all_st[0]);
+
+abstract_container::avl_tree<abstr> tree;
+
+abstract_container::eytz_index<abstr> idx;
+
+abstract_container::eytz_index<abstr, false> idx_np;
+
+int keys[max_nodes + 1];
+unsigned handles[max_nodes + 1];
+
+unsigned h_arr[max_nodes];
+
+// Check every search type for every key from one less than the least
+// key in the index to one more than the greatest, against the tree.
+template <class index_t>
+void check(index_t &ix, unsigned n)
+  {
+    if (ix.num_nodes() != n)
+      bail("num_nodes");
+
+    for (int k = -1; k <= int(2 * n); k++)
+      for (unsigned i = 0; i < num_st; i++)
+	if (ix.search(k, all_st[i]) != tree.search(k, all_st[i]))
+	  {
+	    printf("n=%u k=%d st=%u\n", n, k, unsigned(all_st[i]));
+	    bail("search");
+	  }
+  }
+
+int main()
+  {
+    unsigned n, i;
+
+    for (i = 0; i < max_nodes; i++)
+      {
+	node[i].val = 2 * i;
+	h_arr[i] = i;
+      }
+
+    if (!idx.is_empty())
+      bail("not empty");
+
+    for (n = 0; n <= max_nodes; n++)
+      {
+	tree.build(h_arr, n);
+
+	idx.build(keys, handles, h_arr, n);
+	check(idx, n);
+
+	idx_np.build(keys, handles, h_arr, n);
+	check(idx_np, n);
+
+	idx.clear();
+	if (!idx.build_from_tree(tree, keys, handles, max_nodes))
+	  bail("build_from_tree");
+	check(idx, n);
+
+	if (n > 0)
+	  if (idx.build_from_tree(tree, keys, handles, n - 1))
+	    bail("build_from_tree too many");
+      }
+
+    // Sparse tree, keys not evenly spaced.
+    tree.purge();
+    srand(1);
+    for (i = 0; i < 1000; i++)
+      {
+	unsigned h = unsigned(rand()) % max_nodes;
+	if (tree.remove(node[h].val) == abstr::null())
+	  tree.insert(h);
+      }
+    if (!idx.build_from_tree(tree, keys, handles, max_nodes))
+      bail("build_from_tree sparse");
+    for (int k = -1; k <= int(2 * max_nodes); k++)
+      for (i = 0; i < num_st; i++)
+	if (idx.search(k, all_st[i]) != tree.search(k, all_st[i]))
+	  {
+	    printf("k=%d st=%u\n", k, unsigned(all_st[i]));
+	    bail("sparse search");
+	  }
+
+    printf("SUCCESS!\n");
+
+    return(0);
+  }
@@ -23,6 +23,7 @@ SOFTWARE.
 #include "hash_table.h"
 
 #include "list.h"
+#include "bidir_list.h"
 
 // Put a breakpoint on this function to break after a check fails.
 void bp() { }
@@ -154,6 +155,183 @@ void scan()
 
   } // end scan()
 
+// Element, and abstractor for a hash table that stores the hash value of
+// each element in the element.
+//
+struct Hash_elem
+  {
+    int key;
+    unsigned hash;
+    Hash_elem *link;
+  };
+
+Hash_elem he[Num_elem];
+
+unsigned num_is_key, num_hash_elem;
+
+class Hash_abs
+  {
+  private:
+
+    struct List_abs
+      {
+        static const bool store_tail = false;
+        typedef Hash_elem *handle;
+        static handle null() { return(nullptr); }
+        static handle link(handle h) { return(h->link); }
+        static void link(handle h, handle link_h) { h->link = link_h; }
+      };
+
+  protected:
+
+    typedef abstract_container::list<List_abs> list;
+    typedef unsigned index;
+
+    static const index num_hash_values = Num_buckets;
+
+    typedef int key;
+
+    bool is_key(key k, Hash_elem *h)
+      {
+        ++num_is_key;
+        return(h->key == k);
+      }
+
+    // Not reduced modulo num_hash_values.
+    index hash_key(key k) { return(unsigned(k) * 0x9E3779B1u); }
+
+    index hash_elem(Hash_elem *h)
+      {
+        ++num_hash_elem;
+        return(hash_key(h->key));
+      }
+
+    void set_hash(Hash_elem *h, index hash_value) { h->hash = hash_value; }
+
+    index get_hash(Hash_elem *h) { return(h->hash); }
+  };
+
+hash_table<Hash_abs> hht;
+
+void stored_hash_test()
+  {
+    unsigned i;
+
+    for (i = 0; i < Num_elem; ++i)
+      {
+        he[i].key = int(i);
+        hht.insert(he + i);
+      }
+    CHK(num_hash_elem == Num_elem);
+
+    // The hash values are all different, so is_key() is only called for
+    // the element with the key.
+    for (i = 0; i < Num_elem; ++i)
+      CHK(hht.search(int(i)) == (he + i));
+    CHK(hht.search(int(Num_elem)) == nullptr);
+    CHK(num_is_key == Num_elem);
+
+    // remove(handle) uses the stored hash value.
+    for (i = 1; i < Num_elem; i += 2)
+      hht.remove(he + i);
+    CHK(num_hash_elem == Num_elem);
+
+    num_is_key = 0;
+    for (i = 0; i < Num_elem; i += 2)
+      CHK(hht.remove_key(int(i)) == (he + i));
+    CHK(hht.remove_key(0) == nullptr);
+
+    for (i = 0; i < Num_elem; ++i)
+      CHK(hht.search(int(i)) == nullptr);
+    CHK(num_is_key == (Num_elem / 2));
+
+    hash_table<Hash_abs>::iter it(hht);
+    CHK(!it);
+  }
+
+// Element, and abstractor for a hash table with bidir_list buckets, and
+// stored hash values.
+//
+struct Bidir_elem
+  {
+    int key;
+    unsigned hash;
+    Bidir_elem *link[2];
+  };
+
+Bidir_elem be[Num_elem];
+
+class Bidir_abs
+  {
+  protected:
+
+    typedef Bidir_elem *handle;
+    static handle null() { return(nullptr); }
+    static handle link(handle h, bool is_forward)
+      { return(h->link[is_forward]); }
+    static void link(handle h, handle link_h, bool is_forward)
+      { h->link[is_forward] = link_h; }
+
+    typedef unsigned index;
+
+    static const index num_hash_values = Num_buckets;
+
+    typedef int key;
+
+    bool is_key(key k, Bidir_elem *h) { return(h->key == k); }
+
+    index hash_key(key k) { return(unsigned(k) * 0x9E3779B1u); }
+
+    index hash_elem(Bidir_elem *h)
+      {
+        ++num_hash_elem;
+        return(hash_key(h->key));
+      }
+
+    void set_hash(Bidir_elem *h, index hash_value) { h->hash = hash_value; }
+
+    index get_hash(Bidir_elem *h) { return(h->hash); }
+  };
+
+bidir_hash_table<Bidir_abs> bht;
+
+void bidir_test()
+  {
+    unsigned i;
+
+    num_hash_elem = 0;
+
+    for (i = 0; i < Num_elem; ++i)
+      {
+        be[i].key = int(i);
+        bht.insert(be + i);
+      }
+
+    // Remove elements at the start, middle and end of buckets.
+    for (i = 0; i < Num_elem; i += 3)
+      bht.remove(be + i);
+    for (i = Num_elem - 1; i < Num_elem; i -= 3)
+      bht.remove(be + i);
+    CHK(num_hash_elem == Num_elem);
+
+    for (i = 0; i < Num_elem; ++i)
+      CHK(bht.search(int(i)) == (((i % 3) == 1) ? (be + i) : nullptr));
+
+    unsigned cnt = 0;
+    for (bidir_hash_table<Bidir_abs>::iter it(bht); it; ++it)
+      {
+        CHK(((*it)->key % 3) == 1);
+        ++cnt;
+      }
+    CHK(cnt == (Num_elem / 3));
+
+    for (i = 1; i < Num_elem; i += 3)
+      CHK(bht.remove_key(int(i)) == (be + i));
+
+    bidir_hash_table<Bidir_abs>::iter it(bht);
+    CHK(!it);
+  }
+
 #define SCAN { std::cout << "SCAN line " << __LINE__ << std::endl; scan(); }
 
 int main()
@@ -217,5 +395,9 @@ int main()
     I(91)
     I(92)
 
+    stored_hash_test();
+
+    bidir_test();
+
     return(0);
   }
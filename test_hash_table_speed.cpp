@@ -0,0 +1,367 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Compare the speed of hash_table with 64-byte keys, with and without the
+hash value stored in each element, at various load factors.  The keys
+only differ in their last 8 bytes, so comparing keys is expensive.
+remove(handle) has to rehash the key if the hash value is not stored.
+
+Then compare the speed of remove(handle) with list and bidir_list buckets,
+at higher load factors.
+
+Usage:  a.out [ num_searches ]
+
+The timings are wall clock time, so they are only meaningful on an
+otherwise idle machine.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <exception>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+
+#include <stdint.h>
+
+#include "hash_table.h"
+#include "bidir_list.h"
+#include "fnv_hash.h"
+
+using std::cout;
+
+void bail(const char *msg)
+  {
+    cout << msg << '\n';
+    std::terminate();
+  }
+
+const unsigned key_size = 64;
+
+const uint32_t num_buckets = 1 << 10;
+
+struct Elem
+  {
+    uint8_t key[key_size];
+    uint32_t hash;
+    Elem *link;
+  };
+
+void make_key(uint8_t *key, uint64_t n)
+  {
+    std::memset(key, 'x', key_size - 8);
+
+    for (unsigned i = key_size - 8; i < key_size; ++i, n >>= 8)
+      key[i] = uint8_t(n);
+  }
+
+inline uint32_t hash(const uint8_t *key)
+  {
+    uint32_t h = abstract_container::fnv_hash_init;
+
+    for (unsigned i = 0; i < key_size; ++i)
+      h = abstract_container::fnv_hash_next(key[i], h);
+
+    return(h);
+  }
+
+class Abs
+  {
+  private:
+
+    struct List_abs
+      {
+        static const bool store_tail = false;
+        typedef Elem *handle;
+        static handle null() { return(nullptr); }
+        static handle link(handle h) { return(h->link); }
+        static void link(handle h, handle link_h) { h->link = link_h; }
+      };
+
+  protected:
+
+    typedef abstract_container::list<List_abs> list;
+    typedef uint32_t index;
+    typedef const uint8_t *key;
+
+    static const index num_hash_values = num_buckets;
+
+    static bool is_key(key k, Elem *h)
+      { return(std::memcmp(k, h->key, key_size) == 0); }
+
+    static index hash_key(key k) { return(hash(k) % num_buckets); }
+
+    static index hash_elem(Elem *h) { return(hash_key(h->key)); }
+  };
+
+class Stored_abs : public Abs
+  {
+  protected:
+
+    static index hash_key(key k) { return(hash(k)); }
+
+    static index hash_elem(Elem *h) { return(hash_key(h->key)); }
+
+    static void set_hash(Elem *h, index hash_value) { h->hash = hash_value; }
+
+    static index get_hash(Elem *h) { return(h->hash); }
+  };
+
+struct Bidir_elem
+  {
+    uint8_t key[key_size];
+    uint32_t hash;
+    Bidir_elem *link[2];
+  };
+
+class Bidir_abs
+  {
+  private:
+
+    struct List_abs
+      {
+        typedef Bidir_elem *handle;
+        static handle null() { return(nullptr); }
+        static handle link(handle h, bool is_forward)
+          { return(h->link[is_forward]); }
+        static void link(handle h, handle link_h, bool is_forward)
+          { h->link[is_forward] = link_h; }
+      };
+
+  protected:
+
+    typedef abstract_container::bidir_list<List_abs> list;
+    typedef uint32_t index;
+    typedef const uint8_t *key;
+
+    static const index num_hash_values = num_buckets;
+
+    static bool is_key(key k, Bidir_elem *h)
+      { return(std::memcmp(k, h->key, key_size) == 0); }
+
+    static index hash_key(key k) { return(hash(k) % num_buckets); }
+
+    static index hash_elem(Bidir_elem *h) { return(hash_key(h->key)); }
+  };
+
+class Bidir_stored_abs : public Bidir_abs
+  {
+  protected:
+
+    static index hash_key(key k) { return(hash(k)); }
+
+    static index hash_elem(Bidir_elem *h) { return(hash_key(h->key)); }
+
+    static void set_hash(Bidir_elem *h, index hash_value)
+      { h->hash = hash_value; }
+
+    static index get_hash(Bidir_elem *h) { return(h->hash); }
+  };
+
+abstract_container::hash_table<Abs> plain_table;
+abstract_container::hash_table<Stored_abs> stored_table;
+
+typedef std::chrono::steady_clock clk;
+
+unsigned long long num_searches = 2000000;
+
+inline double ns_since(clk::time_point beg)
+  {
+    return(
+      std::chrono::duration<double, std::nano>(clk::now() - beg).count());
+  }
+
+// Returns nanoseconds per search.  The hash values of the keys are
+// computed before timing, so only the chain walk is timed.
+template <class table_t>
+double search_speed(
+  table_t &table, const std::vector<const uint8_t *> &queries, bool hits)
+  {
+    unsigned long long i, found = 0;
+    std::vector<uint32_t> hv(num_searches);
+
+    for (i = 0; i < num_searches; ++i)
+      hv[i] = table.hash_key(queries[i]);
+
+    clk::time_point beg = clk::now();
+
+    for (i = 0; i < num_searches; ++i)
+      found += table.search(queries[i], hv[i]) != nullptr;
+
+    double ns = ns_since(beg);
+
+    if (found != (hits ? num_searches : 0))
+      bail("search result");
+
+    return(ns / num_searches);
+  }
+
+// Returns nanoseconds per remove(handle).  The elements are put back
+// afterward.
+template <class table_t, class elem_t>
+double remove_speed(table_t &table, std::vector<elem_t *> &order)
+  {
+    std::size_t i;
+
+    clk::time_point beg = clk::now();
+
+    for (i = 0; i < order.size(); ++i)
+      table.remove(order[i]);
+
+    double ns = ns_since(beg);
+
+    typename table_t::iter it(table);
+
+    if (it)
+      bail("table not empty");
+
+    for (i = 0; i < order.size(); ++i)
+      table.insert(order[i]);
+
+    return(ns / order.size());
+  }
+
+void run(unsigned load)
+  {
+    uint32_t num_elems = num_buckets * load;
+    std::vector<Elem> plain_elems(num_elems), stored_elems(num_elems);
+    std::vector<Elem *> plain_order(num_elems), stored_order(num_elems);
+    std::vector<uint8_t> keys(std::size_t(2 * num_elems) * key_size);
+    std::vector<const uint8_t *> hit_q(num_searches), miss_q(num_searches);
+    uint32_t i;
+
+    plain_table.purge();
+    stored_table.purge();
+
+    // Even numbers are the keys in the tables, odd are not.  The search
+    // keys are copies, not in the elements.
+    for (i = 0; i < (2 * num_elems); ++i)
+      make_key(&keys[std::size_t(i) * key_size], i);
+
+    for (i = 0; i < num_elems; ++i)
+      {
+        make_key(plain_elems[i].key, 2 * i);
+        plain_table.insert(&plain_elems[i]);
+
+        make_key(stored_elems[i].key, 2 * i);
+        stored_table.insert(&stored_elems[i]);
+      }
+
+    std::srand(load);
+    for (unsigned long long j = 0; j < num_searches; ++j)
+      {
+        std::size_t k = 2 * (uint32_t(std::rand()) % num_elems);
+        hit_q[j] = &keys[k * key_size];
+        miss_q[j] = &keys[(k + 1) * key_size];
+      }
+
+    // Remove in random order.
+    for (i = 0; i < num_elems; ++i)
+      {
+        plain_order[i] = &plain_elems[i];
+        stored_order[i] = &stored_elems[i];
+      }
+    for (i = num_elems - 1; i > 0; --i)
+      {
+        uint32_t j = uint32_t(std::rand()) % (i + 1);
+        std::swap(plain_order[i], plain_order[j]);
+        std::swap(stored_order[i], stored_order[j]);
+      }
+
+    cout << std::setw(6) << load << std::fixed << std::setprecision(1)
+         << std::setw(10) << search_speed(plain_table, hit_q, true)
+         << std::setw(10) << search_speed(stored_table, hit_q, true)
+         << std::setw(10) << search_speed(plain_table, miss_q, false)
+         << std::setw(10) << search_speed(stored_table, miss_q, false)
+         << std::setw(10) << remove_speed(plain_table, plain_order)
+         << std::setw(10) << remove_speed(stored_table, stored_order)
+         << '\n';
+  }
+
+// Returns nanoseconds per remove(handle), removing all the elements of a
+// table with the given load factor, in random order.
+template <class abstractor, class elem_t>
+double remove_all_speed(unsigned load)
+  {
+    typedef abstract_container::hash_table<abstractor> table_t;
+
+    uint32_t num_elems = num_buckets * load;
+    std::vector<elem_t> elems(num_elems);
+    std::vector<elem_t *> order(num_elems);
+    table_t *table = new table_t;
+    uint32_t i;
+
+    for (i = 0; i < num_elems; ++i)
+      {
+        make_key(elems[i].key, i);
+        table->insert(&elems[i]);
+        order[i] = &elems[i];
+      }
+
+    std::srand(load);
+    for (i = num_elems - 1; i > 0; --i)
+      std::swap(order[i], order[uint32_t(std::rand()) % (i + 1)]);
+
+    double ns = remove_speed(*table, order);
+
+    delete table;
+
+    return(ns);
+  }
+
+void run_remove(unsigned load)
+  {
+    cout << std::setw(6) << load << std::fixed << std::setprecision(1)
+         << std::setw(10) << remove_all_speed<Abs, Elem>(load)
+         << std::setw(10) << remove_all_speed<Stored_abs, Elem>(load)
+         << std::setw(10) << remove_all_speed<Bidir_abs, Bidir_elem>(load)
+         << std::setw(10)
+         << remove_all_speed<Bidir_stored_abs, Bidir_elem>(load)
+         << '\n';
+  }
+
+int main(int n_arg, char **arg)
+  {
+    if (n_arg > 1)
+      {
+        num_searches = std::strtoull(arg[1], 0, 10);
+        if (num_searches == 0)
+          bail("bad num_searches");
+      }
+
+    cout << "\nhash_table speed (nanoseconds per operation), " << key_size
+         << "-byte keys, " << num_buckets << " buckets\n"
+         << "         search hits      search misses     remove(handle)\n"
+         << "  load     plain    stored     plain    stored     plain"
+         << "    stored\n";
+
+    for (unsigned load = 1; load <= 16; load *= 2)
+      run(load);
+
+    cout << "\nremove(handle) speed (nanoseconds per remove)\n"
+         << "             list buckets     bidir_list buckets\n"
+         << "  load     plain    stored     plain    stored\n";
+
+    for (unsigned load = 4; load <= 256; load *= 4)
+      run_remove(load);
+
+    return(0);
+  }
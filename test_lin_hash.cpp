@@ -0,0 +1,309 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Unit testing for lin_hash_table.h .
+
+#include "lin_hash_table.h"
+#include "lin_hash_table.h"
+
+// Put a breakpoint on this function to break after a check fails.
+void bp() { }
+
+#include <cstdlib>
+#include <iostream>
+
+void check(bool expr, int line)
+  {
+    if (!expr)
+      {
+        std::cout << "*** fail line " << line << std::endl;
+        bp();
+        std::exit(1);
+      }
+  }
+
+#define CHK(EXPR) check((EXPR), __LINE__)
+
+using namespace abstract_container;
+
+const unsigned Num_elem = 3000;
+
+struct Elem
+  {
+    unsigned key;
+    Elem *link;
+
+    // For Hash_abs.
+    unsigned hash;
+
+    // Number of times visited by an iterator.
+    unsigned visits;
+  };
+
+Elem e[Num_elem];
+
+bool present[Num_elem];
+
+// Number of bucket arrays allocated and not freed.
+int num_allocs;
+
+// If true, alloc_buckets() fails.
+bool fail_alloc;
+
+unsigned num_hash_elem;
+
+class Abs
+  {
+  private:
+
+    struct List_abs
+      {
+        static const bool store_tail = false;
+        typedef Elem *handle;
+        static handle null() { return(nullptr); }
+        static handle link(handle h) { return(h->link); }
+        static void link(handle h, handle link_h) { h->link = link_h; }
+      };
+
+  protected:
+
+    typedef abstract_container::list<List_abs> list;
+    typedef unsigned index;
+
+    static const index min_buckets = 8;
+
+    static const index load_factor = 2;
+
+    typedef unsigned key;
+
+    bool is_key(key k, Elem *h) { return(h->key == k); }
+
+    // Multiply by an odd number, so all the bits of the key affect the
+    // high bits of the hash.  The high bits are shifted down, so they
+    // are used even when there are few buckets.
+    static index hash(key k)
+      {
+        index h = k * 0x9E3779B1u;
+
+        return(h ^ (h >> 16));
+      }
+
+    index hash_key(key k) { return(hash(k)); }
+
+    index hash_elem(Elem *h)
+      {
+        ++num_hash_elem;
+        return(hash(h->key));
+      }
+
+    list * alloc_buckets(index n)
+      {
+        if (fail_alloc)
+          return(nullptr);
+
+        ++num_allocs;
+        return(new list[n]);
+      }
+
+    void free_buckets(list *b, index)
+      {
+        --num_allocs;
+        delete [] b;
+      }
+  };
+
+typedef lin_hash_table<Abs> Ht;
+
+// Abstractor that stores the hash value in each element.
+class Hash_abs : public Abs
+  {
+  protected:
+
+    void set_hash(Elem *h, index hash_value) { h->hash = hash_value; }
+
+    index get_hash(Elem *h) { return(h->hash); }
+  };
+
+// Check that the table contains exactly the present elements, and has a
+// number of buckets consistent with the load factor.
+//
+void scan(Ht &ht)
+  {
+    unsigned cnt = 0;
+
+    for (unsigned i = 0; i < Num_elem; ++i)
+      {
+        e[i].visits = 0;
+
+        if (present[i])
+          {
+            ++cnt;
+            CHK(ht.search(e[i].key) == (e + i));
+          }
+        else
+          CHK(ht.search(e[i].key) == Ht::null());
+      }
+
+    CHK(ht.size() == cnt);
+
+    for (Ht::iter it(ht); it; ++it)
+      ++(*it)->visits;
+
+    for (unsigned i = 0; i < Num_elem; ++i)
+      CHK(e[i].visits == (present[i] ? 1 : 0));
+
+    if (!fail_alloc)
+      CHK(cnt <= (2 * ht.num_buckets()));
+  }
+
+void insert(Ht &ht, unsigned i)
+  {
+    ht.insert(e + i);
+    present[i] = true;
+  }
+
+// hash_elem() should only be called by insert(handle), even though
+// buckets are split and merged.
+//
+void stored_hash_test()
+  {
+    lin_hash_table<Hash_abs> ht;
+    unsigned i;
+
+    num_hash_elem = 0;
+
+    for (i = 0; i < Num_elem; ++i)
+      ht.insert(e + i);
+    CHK(ht.num_buckets() == (Num_elem / 2));
+
+    for (i = 0; i < Num_elem; ++i)
+      CHK(ht.search(e[i].key) == (e + i));
+
+    for (i = 0; i < Num_elem; i += 2)
+      ht.remove(e + i);
+    for (i = 1; i < Num_elem; i += 2)
+      CHK(ht.remove_key(e[i].key) == (e + i));
+    CHK(ht.size() == 0);
+    CHK(ht.num_buckets() == 8);
+
+    CHK(num_hash_elem == Num_elem);
+  }
+
+int main()
+  {
+    unsigned i, step;
+
+    for (i = 0; i < Num_elem; ++i)
+      e[i].key = 7 * i;
+
+    {
+      Ht ht;
+
+      CHK(ht.num_buckets() == 8);
+      scan(ht);
+
+      // Grow one bucket at a time.
+      for (i = 0; i < Num_elem; ++i)
+        {
+          insert(ht, i);
+          if ((i % 97) == 0)
+            scan(ht);
+        }
+      scan(ht);
+      CHK(ht.num_buckets() == (Num_elem / 2));
+
+      // Shrink while removing, with both remove functions.
+      for (i = 0; i < Num_elem; ++i)
+        {
+          if (i & 1)
+            ht.remove(e + i);
+          else
+            CHK(ht.remove_key(e[i].key) == (e + i));
+          present[i] = false;
+          if ((i % 97) == 0)
+            scan(ht);
+        }
+      scan(ht);
+      CHK(ht.num_buckets() == 8);
+      CHK(num_allocs == 0);
+
+      // Random inserts and removes.
+      std::srand(1);
+      for (step = 0; step < (20 * Num_elem); ++step)
+        {
+          i = unsigned(std::rand()) % Num_elem;
+          if (present[i])
+            {
+              CHK(ht.remove_key(e[i].key) == (e + i));
+              present[i] = false;
+            }
+          else
+            insert(ht, i);
+
+          CHK(ht.remove_key(1) == Ht::null());
+
+          if ((step % 1000) == 0)
+            scan(ht);
+        }
+      scan(ht);
+
+      // If bucket allocation fails, the table stays correct, but does not
+      // grow.
+      for (i = 0; i < Num_elem; ++i)
+        if (present[i])
+          {
+            ht.remove(e + i);
+            present[i] = false;
+          }
+      fail_alloc = true;
+      for (i = 0; i < Num_elem; ++i)
+        insert(ht, i);
+      scan(ht);
+      CHK(ht.num_buckets() <= 8);
+      fail_alloc = false;
+      ht.remove(e + 0);
+      insert(ht, 0);
+      CHK(ht.search(e[0].key) == (e + 0));
+      CHK(ht.num_buckets() > 8);
+
+      ht.purge();
+      for (i = 0; i < Num_elem; ++i)
+        present[i] = false;
+      scan(ht);
+      CHK(ht.num_buckets() == 8);
+      CHK(num_allocs == 0);
+
+      for (i = 0; i < Num_elem; i += 3)
+        insert(ht, i);
+      scan(ht);
+      CHK(num_allocs != 0);
+
+      // Destructor frees the bucket arrays.
+    }
+
+    CHK(num_allocs == 0);
+
+    stored_hash_test();
+
+    CHK(num_allocs == 0);
+
+    std::cout << "SUCCESS!\n";
+
+    return(0);
+  }
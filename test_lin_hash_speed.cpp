@@ -0,0 +1,227 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Compare the latency of inserts into a linear hashing table (which splits
+one bucket per insert), and into a table that doubles its number of
+buckets, rehashing all the elements, when the load factor is exceeded.
+
+Usage:  a.out [ num_elems ]
+
+The timings are wall clock time, so they are only meaningful on an
+otherwise idle machine.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <exception>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include <stdint.h>
+
+#include "lin_hash_table.h"
+
+using std::cout;
+
+void bail(const char *msg)
+  {
+    cout << msg << '\n';
+    std::terminate();
+  }
+
+struct Elem
+  {
+    uint32_t key;
+    Elem *link;
+  };
+
+struct List_abs
+  {
+    static const bool store_tail = false;
+    typedef Elem *handle;
+    static handle null() { return(nullptr); }
+    static handle link(handle h) { return(h->link); }
+    static void link(handle h, handle link_h) { h->link = link_h; }
+  };
+
+typedef abstract_container::list<List_abs> list;
+
+const uint32_t load_factor = 2;
+
+const uint32_t min_buckets = 8;
+
+inline uint32_t hash(uint32_t k)
+  {
+    uint32_t h = k * 0x9E3779B1u;
+
+    return(h ^ (h >> 16));
+  }
+
+class Abs
+  {
+  protected:
+
+    typedef ::list list;
+    typedef uint32_t index;
+    typedef uint32_t key;
+
+    static const index min_buckets = ::min_buckets;
+    static const index load_factor = ::load_factor;
+
+    static bool is_key(key k, Elem *h) { return(h->key == k); }
+
+    static index hash_key(key k) { return(hash(k)); }
+
+    static index hash_elem(Elem *h) { return(hash(h->key)); }
+
+    static list * alloc_buckets(index n) { return(new list[n]); }
+
+    static void free_buckets(list *b, index) { delete [] b; }
+  };
+
+typedef abstract_container::lin_hash_table<Abs> lin_table;
+
+// Hash table that doubles its number of buckets, and rehashes all its
+// elements, when the load factor is exceeded.
+class stw_table
+  {
+  public:
+
+    stw_table() : num_buckets(min_buckets), num_elems(0)
+      { buckets = new list[num_buckets]; }
+
+    ~stw_table() { delete [] buckets; }
+
+    void insert(Elem *h)
+      {
+        buckets[hash(h->key) & (num_buckets - 1)].push(h);
+
+        if (++num_elems > (load_factor * num_buckets))
+          grow();
+      }
+
+    Elem * search(uint32_t k)
+      {
+        list &b = buckets[hash(k) & (num_buckets - 1)];
+        Elem *h = b.start();
+
+        while (h and (h->key != k))
+          h = b.link(h);
+
+        return(h);
+      }
+
+  private:
+
+    list *buckets;
+    uint32_t num_buckets, num_elems;
+
+    void grow()
+      {
+        uint32_t new_num = 2 * num_buckets;
+        list *new_buckets = new list[new_num];
+
+        for (uint32_t i = 0; i < num_buckets; ++i)
+          while (!buckets[i].empty())
+            {
+              Elem *h = buckets[i].pop();
+              new_buckets[hash(h->key) & (new_num - 1)].push(h);
+            }
+
+        delete [] buckets;
+        buckets = new_buckets;
+        num_buckets = new_num;
+      }
+  };
+
+typedef std::chrono::steady_clock clk;
+
+// Insert the elements, timing each insert.  Then check they can all be
+// found.
+template <class table_t>
+void run(const char *name, std::vector<Elem> &elems)
+  {
+    table_t *table = new table_t;
+    std::vector<double> lat(elems.size());
+    std::size_t i;
+
+    clk::time_point total_beg = clk::now();
+
+    for (i = 0; i < elems.size(); ++i)
+      {
+        clk::time_point beg = clk::now();
+        table->insert(&elems[i]);
+        lat[i] =
+          std::chrono::duration<double, std::nano>(clk::now() - beg).count();
+      }
+
+    double total =
+      std::chrono::duration<double, std::milli>(clk::now() - total_beg)
+      .count();
+
+    for (i = 0; i < elems.size(); ++i)
+      if (table->search(elems[i].key) != &elems[i])
+        bail("search failed");
+
+    delete table;
+
+    std::sort(lat.begin(), lat.end());
+
+    std::size_t n = lat.size();
+
+    cout << std::setw(16) << name << std::fixed << std::setprecision(0)
+         << std::setw(9) << lat[n / 2]
+         << std::setw(9) << lat[(n * 99) / 100]
+         << std::setw(11) << lat[(n * 999) / 1000]
+         << std::setw(12) << lat[(n * 9999) / 10000]
+         << std::setw(12) << lat[n - 1]
+         << std::setprecision(1) << std::setw(11) << total << '\n';
+  }
+
+int main(int n_arg, char **arg)
+  {
+    std::size_t num_elems = 1000000;
+
+    if (n_arg > 1)
+      {
+        num_elems = std::strtoul(arg[1], 0, 10);
+        if (num_elems == 0)
+          bail("bad num_elems");
+      }
+
+    std::vector<Elem> elems(num_elems);
+
+    for (std::size_t i = 0; i < num_elems; ++i)
+      elems[i].key = uint32_t(i * 7);
+
+    cout << "\ninsert latency (nanoseconds), " << num_elems << " elements\n"
+         << "                     p50      p99     p99.9     p99.99"
+         << "         max   total ms\n";
+
+    for (int pass = 0; pass < 2; ++pass)
+      {
+        run<lin_table>("linear hashing", elems);
+        run<stw_table>("full rehash", elems);
+      }
+
+    return(0);
+  }
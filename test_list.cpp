@@ -144,8 +144,6 @@ int main()
 
     CHK(lst.empty());
 
-    #if !BIDIR
-
     lst.push(e + 2); SCAN
     lst.insert(e + 2, e + 4); SCAN
     lst.insert(e + 2, e + 0, reverse); SCAN
@@ -160,6 +158,20 @@ int main()
 
     CHK(lst.empty());
 
+    #if BIDIR
+
+    lst.push(e + 2); SCAN
+    lst.insert(e + 2, e + 4); SCAN
+    lst.insert(e + 2, e + 0, reverse); SCAN
+    lst.insert(e + 2, e + 3); SCAN
+
+    lst.remove_forward(e + 4, reverse); lst.make_detached(e + 3); SCAN
+    lst.remove_forward(e + 4, reverse); lst.make_detached(e + 2); SCAN
+    lst.remove_forward(e + 4, reverse); lst.make_detached(e + 0); SCAN
+    lst.pop(reverse); lst.make_detached(e + 4); SCAN
+
+    CHK(lst.empty());
+
     #endif
 
     lst.push(e + 2); SCAN
@@ -0,0 +1,322 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Memory-Mapped File AVL Tree Test.
+
+#include "stdio.h"
+#include "stdlib.h"
+
+#include "mmap_avl.h"
+
+// Check to make sure double inclusion OK.
+#include "mmap_avl.h"
+
+void bail(const char *note)
+  {
+    printf("%s\n", note);
+    exit(1);
+  }
+
+struct rec
+  {
+    int key;
+    int data;
+  };
+
+struct traits
+  {
+    typedef int key;
+    typedef rec value;
+
+    static int compare_key_value(key k, const value &v)
+      { return(k < v.key ? -1 : (k > v.key ? 1 : 0)); }
+
+    static int compare_value_value(const value &v1, const value &v2)
+      { return(compare_key_value(v1.key, v2)); }
+  };
+
+struct other_rec
+  {
+    int key;
+    char name[20];
+  };
+
+struct other_traits
+  {
+    typedef int key;
+    typedef other_rec value;
+
+    static int compare_key_value(key k, const value &v)
+      { return(k < v.key ? -1 : (k > v.key ? 1 : 0)); }
+
+    static int compare_value_value(const value &v1, const value &v2)
+      { return(compare_key_value(v1.key, v2)); }
+  };
+
+typedef abstract_container::mmap_avl_tree<traits> tree_t;
+
+const char *path;
+
+const unsigned num_keys = 2000;
+
+bool present[num_keys];
+
+tree_t::handle hnd[num_keys];
+
+// Check that the tree contains exactly the nodes that are present, in order.
+void check(tree_t &tree)
+  {
+    tree_t::iter it;
+    unsigned i;
+
+    it.start_iter_least(tree);
+    for (i = 0; i < num_keys; i++)
+      if (present[i])
+	{
+	  if (*it != hnd[i])
+	    {
+	      printf("%u\n", i);
+	      bail("check iter");
+	    }
+	  if ((tree.val(*it).key != int(i)) or
+	      (tree.val(*it).data != int(3 * i)))
+	    bail("check value");
+	  it++;
+	}
+    if (*it != tree_t::handle(0))
+      bail("check end");
+
+    for (i = 0; i < num_keys; i++)
+      if (tree.search(i) != (present[i] ? hnd[i] : 0))
+	bail("check search");
+
+    if (tree.read_error())
+      bail("check read error");
+  }
+
+// Overwrite the 8 bytes at offset 'offset' in the file with v.
+void corrupt(uint64_t offset, uint64_t v, const char *note)
+  {
+    FILE *f = fopen(path, "r+b");
+    if (!f)
+      bail("fopen");
+    if (fseek(f, long(offset), SEEK_SET) or (fwrite(&v, sizeof(v), 1, f) != 1))
+      bail(note);
+    fclose(f);
+  }
+
+void insert(tree_t &tree, unsigned i)
+  {
+    tree_t::handle h = tree.alloc();
+    if (h == 0)
+      bail("alloc");
+    tree.val(h).key = i;
+    tree.val(h).data = 3 * i;
+    if (tree.insert(h) != h)
+      bail("insert");
+    hnd[i] = h;
+    present[i] = true;
+  }
+
+void remove(tree_t &tree, unsigned i)
+  {
+    tree_t::handle h = tree.remove(i);
+    if (h != hnd[i])
+      bail("remove");
+    tree.free(h);
+    present[i] = false;
+  }
+
+int main(int n_arg, char **arg)
+  {
+    unsigned i;
+
+    path = n_arg > 1 ? arg[1] : "/tmp/test_mmap_avl.dat";
+
+    unlink(path);
+
+    {
+      tree_t tree;
+
+      if (!tree.open(path, 4))
+	bail("open new");
+      if (!tree.is_empty())
+	bail("new not empty");
+
+      // Insert in random order, so the file is enlarged many times.
+      srand(1);
+      for (i = 0; i < (3 * num_keys); i++)
+	{
+	  unsigned k = unsigned(rand()) % num_keys;
+	  if (!present[k])
+	    insert(tree, k);
+	}
+      check(tree);
+
+      // Destructor closes.
+    }
+
+    struct stat st;
+    if (stat(path, &st) != 0)
+      bail("stat");
+    off_t file_size = st.st_size;
+
+    {
+      tree_t tree;
+
+      if (!tree.open(path))
+	bail("reopen");
+      check(tree);
+
+      for (i = 0; i < num_keys; i += 2)
+	if (present[i])
+	  remove(tree, i);
+      check(tree);
+
+      tree.sync();
+
+      // Freed nodes are reused, so the file should not grow.
+      for (i = 0; i < num_keys; i += 2)
+	if (!present[i])
+	  insert(tree, i);
+      check(tree);
+
+      tree.close();
+
+      if (stat(path, &st) != 0)
+	bail("stat 2");
+      if (st.st_size != file_size)
+	bail("file grew");
+    }
+
+    {
+      tree_t tree;
+
+      if (!tree.open(path))
+	bail("reopen 2");
+      check(tree);
+
+      // build() into the file.
+      for (i = 0; i < num_keys; i++)
+	if (!present[i])
+	  insert(tree, i);
+      tree_t::handle sorted[num_keys];
+      for (i = 0; i < num_keys; i++)
+	sorted[i] = hnd[i];
+      tree.build(sorted, num_keys);
+      check(tree);
+    }
+
+    // A file for a different value type must not be opened.
+    {
+      abstract_container::mmap_avl_tree<other_traits> tree;
+
+      if (tree.open(path))
+	bail("opened with wrong value type");
+    }
+
+    // A corrupt link is reported as a read error.
+    {
+      tree_t tree;
+
+      // Overwrite the less link of the least node with an offset past the
+      // end of the file.
+      corrupt(hnd[0], uint64_t(file_size) * 2, "corrupt");
+
+      if (!tree.open(path))
+	bail("reopen 4");
+      if (tree.search(-1) != 0)
+	bail("corrupt search");
+      if (!tree.read_error())
+	bail("no read error");
+    }
+
+    // So is a link into the middle of a record.
+    {
+      tree_t tree;
+
+      corrupt(hnd[0], hnd[1] + 8, "corrupt 2");
+
+      if (!tree.open(path))
+	bail("reopen 5");
+      if (tree.search(-1) != 0)
+	bail("misaligned search");
+      if (!tree.read_error())
+	bail("no read error 2");
+    }
+
+    // Offsets of the free list and capacity fields of the file header.
+    const uint64_t free_list_offset = 24, capacity_offset = 40;
+
+    unlink(path);
+
+    {
+      tree_t tree;
+
+      if (!tree.open(path, 4))
+	bail("open new 2");
+      for (i = 0; i < 3; i++)
+	insert(tree, i);
+      remove(tree, 1);
+    }
+
+    // A corrupt link in the list of free records is reported as a read
+    // error by alloc().
+    corrupt(hnd[1], hnd[0] + 8, "corrupt 3");
+    {
+      tree_t tree;
+
+      if (!tree.open(path))
+	bail("reopen 6");
+      if (tree.alloc() != 0)
+	bail("alloc from corrupt free list");
+      if (!tree.read_error())
+	bail("no read error 3");
+    }
+
+    // A file whose header has a corrupt free list, or no capacity, must
+    // not be opened.
+    corrupt(free_list_offset, uint64_t(0x7fffffff) << 8, "corrupt 4");
+    {
+      tree_t tree;
+
+      if (tree.open(path))
+	bail("opened with corrupt free list");
+    }
+    unlink(path);
+    {
+      tree_t tree;
+
+      if (!tree.open(path))
+	bail("open new 3");
+    }
+    corrupt(capacity_offset, 0, "corrupt 5");
+    {
+      tree_t tree;
+
+      if (tree.open(path))
+	bail("opened with no capacity");
+    }
+
+    unlink(path);
+
+    printf("SUCCESS!\n");
+
+    return(0);
+  }
@@ -0,0 +1,269 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Paged File AVL Tree Test.
+
+#include "stdio.h"
+#include "stdlib.h"
+
+#include "paged_avl.h"
+
+// Check to make sure double inclusion OK.
+#include "paged_avl.h"
+
+void bail(const char *note)
+  {
+    printf("%s\n", note);
+    exit(1);
+  }
+
+struct rec
+  {
+    int key;
+    int data;
+  };
+
+struct traits
+  {
+    typedef int key;
+    typedef rec value;
+
+    static int compare_key_value(key k, const value &v)
+      { return(k < v.key ? -1 : (k > v.key ? 1 : 0)); }
+
+    static int compare_value_value(const value &v1, const value &v2)
+      { return(compare_key_value(v1.key, v2)); }
+  };
+
+// Small pages, so there are many of them.
+typedef abstract_container::paged_avl_tree<traits, 256> tree_t;
+
+const char *path;
+
+const unsigned num_keys = 2000;
+
+bool present[num_keys];
+
+tree_t::handle hnd[num_keys];
+
+// Much fewer frames than pages in the tree.
+const unsigned num_frames = 5;
+
+tree_t::frame frames[num_frames];
+
+// Check that the tree contains exactly the nodes that are present, in order.
+void check(tree_t &tree)
+  {
+    tree_t::iter it;
+    unsigned i;
+
+    it.start_iter_least(tree);
+    for (i = 0; i < num_keys; i++)
+      if (present[i])
+	{
+	  if (*it != hnd[i])
+	    {
+	      printf("%u\n", i);
+	      bail("check iter");
+	    }
+	  if ((tree.read_val(*it).key != int(i)) or
+	      (tree.read_val(*it).data != int(3 * i)))
+	    bail("check value");
+	  it++;
+	}
+    if (*it != tree_t::handle(0))
+      bail("check end");
+
+    for (i = 0; i < num_keys; i++)
+      if (tree.search(i) != (present[i] ? hnd[i] : 0))
+	bail("check search");
+
+    if (tree.read_error())
+      bail("check read error");
+  }
+
+void insert(tree_t &tree, unsigned i)
+  {
+    tree_t::handle h = tree.alloc();
+    tree.val(h).key = i;
+    tree.val(h).data = 3 * i;
+    if (tree.insert(h) != h)
+      bail("insert");
+    hnd[i] = h;
+    present[i] = true;
+  }
+
+void remove(tree_t &tree, unsigned i)
+  {
+    tree_t::handle h = tree.remove(i);
+    if (h != hnd[i])
+      bail("remove");
+    tree.free(h);
+    present[i] = false;
+  }
+
+int main(int n_arg, char **arg)
+  {
+    unsigned i;
+
+    path = n_arg > 1 ? arg[1] : "/tmp/test_paged_avl.dat";
+
+    unlink(path);
+
+    {
+      tree_t tree;
+
+      if (tree.open(path, frames, 1))
+	bail("opened with one frame");
+
+      if (!tree.open(path, frames, num_frames))
+	bail("open new");
+      if (!tree.is_empty())
+	bail("new not empty");
+
+      // Insert in random order, so pages are evicted many times.
+      srand(1);
+      for (i = 0; i < (3 * num_keys); i++)
+	{
+	  unsigned k = unsigned(rand()) % num_keys;
+	  if (!present[k])
+	    insert(tree, k);
+	}
+      check(tree);
+
+      const tree_t::cache_stats &st = tree.stats();
+      if ((st.faults == 0) or (st.hits == 0) or (st.write_backs == 0) or
+	  (st.traversal_reads == 0) or (st.relink_reads == 0))
+	bail("stats");
+
+      // Destructor closes.
+    }
+
+    {
+      tree_t tree;
+
+      if (!tree.open(path, frames, num_frames))
+	bail("reopen");
+      check(tree);
+
+      for (i = 0; i < num_keys; i += 2)
+	if (present[i])
+	  remove(tree, i);
+      check(tree);
+
+      if (!tree.sync())
+	bail("sync");
+
+      // Freed nodes are reused.
+      for (i = 0; i < num_keys; i += 2)
+	if (!present[i])
+	  insert(tree, i);
+      check(tree);
+
+      for (i = 0; i < num_keys; i++)
+	if (hnd[i] >= (tree_t::nodes_per_page + num_keys))
+	  bail("free not reused");
+
+      if (!tree.close())
+	bail("close");
+    }
+
+    {
+      tree_t tree;
+
+      if (!tree.open(path, frames, num_frames))
+	bail("reopen 2");
+
+      // Searches do not change pages, or read links without access.
+      tree.reset_stats();
+      for (i = 0; i < num_keys; i++)
+	tree.search(i);
+      if ((tree.stats().write_backs != 0) or (tree.stats().relink_reads != 0))
+	bail("search stats");
+
+      // build() in the file.
+      for (i = 0; i < num_keys; i++)
+	if (!present[i])
+	  insert(tree, i);
+      tree_t::handle sorted[num_keys];
+      for (i = 0; i < num_keys; i++)
+	sorted[i] = hnd[i];
+      tree.build(sorted, num_keys);
+      check(tree);
+    }
+
+    // A file with a different page size must not be opened.
+    {
+      abstract_container::paged_avl_tree<traits, 512> tree;
+      abstract_container::paged_avl_tree<traits, 512>::frame fr[2];
+
+      if (tree.open(path, fr, 2))
+	bail("opened with wrong page size");
+    }
+
+    // A corrupt link is reported as a read error.
+    {
+      tree_t tree;
+
+      // Overwrite the less link of the least node with a node number past
+      // the end of the file.
+      typedef abstract_container::paged_avl_abs<traits, 256>::node node;
+      FILE *f = fopen(path, "r+b");
+      if (!f)
+	bail("fopen");
+      uint64_t bad = tree_t::nodes_per_page + (2 * num_keys);
+      if (fseek(
+	    f,
+	    long(((hnd[0] / tree_t::nodes_per_page) * 256) +
+		 ((hnd[0] % tree_t::nodes_per_page) * sizeof(node))),
+	    SEEK_SET) or
+	  (fwrite(&bad, sizeof(bad), 1, f) != 1))
+	bail("corrupt");
+      fclose(f);
+
+      if (!tree.open(path, frames, num_frames))
+	bail("reopen 3");
+      if (tree.search(-1) != 0)
+	bail("corrupt search");
+      if (!tree.read_error())
+	bail("no read error");
+    }
+
+    // A page that cannot be read is reported as a read error.
+    {
+      tree_t tree;
+
+      if (!tree.open(path, frames, num_frames))
+	bail("reopen 4");
+
+      // Remove all pages but the header page.
+      if (truncate(path, 256) != 0)
+	bail("truncate");
+
+      tree.search(num_keys / 2);
+      if (!tree.read_error())
+	bail("no page read error");
+    }
+
+    unlink(path);
+
+    printf("SUCCESS!\n");
+
+    return(0);
+  }
@@ -0,0 +1,400 @@
+/*
+Copyright (c) 2016 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Persistent AVL Tree Test.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <thread>
+
+#include "persist_avl.h"
+
+// Check to make sure double inclusion OK.
+#include "persist_avl.h"
+
+void bail(const char *note)
+  {
+    printf("%s\n", note);
+    exit(1);
+  }
+
+const unsigned num_keys = 500;
+
+// Enough nodes for the tree, the retired nodes, and the copies made by
+// one operation.
+const unsigned max_nodes = 20000;
+
+const unsigned null_h = ~0u;
+
+struct node_t
+  {
+    int key;
+    unsigned lt, gt, retired_next;
+    int bf;
+
+    // True while the node is allocated.  Readers check that they never
+    // see a node that has been released.
+    std::atomic<bool> live;
+  };
+
+node_t node[max_nodes];
+
+// Free node list (only used by the writer).
+unsigned free_head;
+
+unsigned num_live;
+
+unsigned alloc()
+  {
+    unsigned h = free_head;
+
+    if (h == null_h)
+      bail("out of nodes");
+    free_head = node[h].lt;
+    node[h].live.store(true, std::memory_order_relaxed);
+    ++num_live;
+
+    return(h);
+  }
+
+void init_nodes()
+  {
+    for (unsigned i = 0; i < max_nodes; ++i)
+      {
+	node[i].lt = i + 1 < max_nodes ? i + 1 : null_h;
+	node[i].live.store(false);
+      }
+    free_head = 0;
+    num_live = 0;
+  }
+
+class abstr
+  {
+  public:
+
+    typedef unsigned handle;
+    typedef int key;
+
+    static handle get_less(handle h, bool) { return(node[h].lt); }
+    static void set_less(handle h, handle lh) { node[h].lt = lh; }
+    static handle get_greater(handle h, bool) { return(node[h].gt); }
+    static void set_greater(handle h, handle gh) { node[h].gt = gh; }
+    static int get_balance_factor(handle h) { return(node[h].bf); }
+    static void set_balance_factor(handle h, int bf) { node[h].bf = bf; }
+
+    static int compare_key_node(key k, handle h)
+      { return(k < node[h].key ? -1 : (k > node[h].key ? 1 : 0)); }
+
+    static int compare_node_node(handle h1, handle h2)
+      { return(compare_key_node(node[h1].key, h2)); }
+
+    static handle null() { return(null_h); }
+
+    static handle clone(handle h)
+      {
+	if (!node[h].live.load(std::memory_order_relaxed))
+	  bail("clone released");
+
+	handle n = alloc();
+	node[n].key = node[h].key;
+	node[n].lt = node[h].lt;
+	node[n].gt = node[h].gt;
+	node[n].bf = node[h].bf;
+	return(n);
+      }
+
+    static void release(handle h)
+      {
+	if (!node[h].live.load(std::memory_order_relaxed))
+	  bail("released twice");
+	node[h].live.store(false, std::memory_order_relaxed);
+	node[h].lt = free_head;
+	free_head = h;
+	--num_live;
+      }
+
+    static handle get_retired_next(handle h)
+      { return(node[h].retired_next); }
+    static void set_retired_next(handle h, handle next)
+      { node[h].retired_next = next; }
+  };
+
+typedef abstract_container::persist_avl_tree<abstr> tree_t;
+
+// Verifies the AVL properties of a subtree, with keys greater than lo and
+// less than hi, and returns its depth.  Counts the nodes in cnt.
+unsigned verify(unsigned h, int lo, int hi, unsigned &cnt)
+  {
+    if (h == null_h)
+      return(0);
+
+    if (!node[h].live.load(std::memory_order_relaxed))
+      bail("verify released");
+    if ((node[h].key <= lo) or (node[h].key >= hi))
+      bail("verify order");
+
+    ++cnt;
+
+    unsigned ld = verify(node[h].lt, lo, node[h].key, cnt),
+	     gd = verify(node[h].gt, node[h].key, hi, cnt);
+
+    if (int(gd) - int(ld) != node[h].bf)
+      bail("verify balance factor");
+
+    return((ld > gd ? ld : gd) + 1);
+  }
+
+void check(tree_t &tree, tree_t::handle root, const bool *present)
+  {
+    unsigned cnt = 0, i, n = 0;
+
+    verify(root, -1, num_keys, cnt);
+
+    for (i = 0; i < num_keys; ++i)
+      if (present[i])
+	{
+	  ++n;
+	  if (tree.search(root, i) == null_h)
+	    bail("check missing");
+	}
+      else if (tree.search(root, i) != null_h)
+	bail("check extra");
+
+    if (cnt != n)
+      bail("check count");
+
+    tree_t::iter it;
+    i = 0;
+    for (it.start_iter_least(tree, root); *it != null_h; ++it)
+      {
+	while (!present[i])
+	  ++i;
+	if (node[*it].key != int(i))
+	  bail("check iter");
+	++i;
+      }
+    while ((i < num_keys) and !present[i])
+      ++i;
+    if (i != num_keys)
+      bail("check iter end");
+  }
+
+// Does an insert or remove of a random key.
+void random_op(tree_t &tree, bool *present)
+  {
+    int k = rand() % num_keys;
+
+    if (present[k])
+      {
+	unsigned h = tree.remove(k);
+	if ((h == null_h) or (node[h].key != k))
+	  bail("remove");
+      }
+    else
+      {
+	unsigned h = alloc();
+	node[h].key = k;
+	if (tree.insert(h) != h)
+	  bail("insert");
+      }
+    present[k] = !present[k];
+  }
+
+void version_test()
+  {
+    static bool present[num_keys], old_present[num_keys];
+    unsigned i, j;
+
+    init_nodes();
+
+    {
+      tree_t tree;
+      tree_t::reader rd(tree), old_rd(tree);
+
+      if (!rd.valid() or !old_rd.valid())
+	bail("reader not valid");
+
+      srand(1);
+
+      for (i = 0; i < 20; ++i)
+	{
+	  // Pin a version, then change the tree.  The pinned version must
+	  // not change.
+	  for (j = 0; j < num_keys; ++j)
+	    old_present[j] = present[j];
+	  tree_t::handle old_root = old_rd.pin();
+
+	  for (j = 0; j < 500; ++j)
+	    {
+	      random_op(tree, present);
+	      if ((j % 50) == 0)
+		{
+		  check(tree, rd.pin(), present);
+		  rd.unpin();
+		}
+	    }
+
+	  check(tree, old_root, old_present);
+	  check(tree, rd.pin(), present);
+	  rd.unpin();
+
+	  old_rd.unpin();
+	}
+
+      // With no readers pinned, all retired nodes can be released.
+      if (!tree.reclaim())
+	bail("reclaim");
+
+      unsigned cnt = 0;
+      verify(rd.pin(), -1, num_keys, cnt);
+      rd.unpin();
+      if (cnt != num_live)
+	bail("live count");
+
+      // A pinned reader blocks reclamation.
+      old_rd.pin();
+      random_op(tree, present);
+      if (tree.reclaim())
+	bail("reclaim while pinned");
+      old_rd.unpin();
+      if (!tree.reclaim())
+	bail("reclaim 2");
+
+      // The destructor does not release the nodes in the tree.
+    }
+  }
+
+void slot_test()
+  {
+    abstract_container::persist_avl_tree<abstr, 3> tree;
+    abstract_container::persist_avl_tree<abstr, 3>::reader r1(tree), r2(tree);
+
+    {
+      abstract_container::persist_avl_tree<abstr, 3>::reader r3(tree),
+	r4(tree);
+
+      if (!r1.valid() or !r2.valid() or !r3.valid() or r4.valid())
+	bail("slot");
+    }
+
+    abstract_container::persist_avl_tree<abstr, 3>::reader r5(tree);
+
+    if (!r5.valid())
+      bail("slot reuse");
+  }
+
+std::atomic<bool> writer_done;
+
+std::atomic<unsigned long long> num_reads;
+
+// Repeatedly pin the current version and check that it is in order, and
+// none of its nodes are released.
+void reader_thread(tree_t *tree)
+  {
+    tree_t::reader rd(*tree);
+    tree_t::iter it;
+
+    if (!rd.valid())
+      bail("reader_thread");
+
+    while (!writer_done.load())
+      {
+	tree_t::handle root = rd.pin();
+	int last = -1;
+
+	for (it.start_iter_least(*tree, root); *it != null_h; ++it)
+	  {
+	    if (!node[*it].live.load(std::memory_order_relaxed))
+	      bail("reader saw released node");
+	    if (node[*it].key <= last)
+	      bail("reader order");
+	    last = node[*it].key;
+	    if (tree->search(root, last) != *it)
+	      bail("reader search");
+	  }
+	rd.unpin();
+	num_reads++;
+      }
+  }
+
+void thread_test()
+  {
+    static bool present[num_keys];
+    const unsigned num_readers = 3;
+    std::thread *thr[num_readers];
+    unsigned i;
+
+    init_nodes();
+
+    {
+      tree_t tree;
+
+      writer_done = false;
+      num_reads = 0;
+
+      for (i = 0; i < num_readers; ++i)
+	thr[i] = new std::thread(reader_thread, &tree);
+
+      srand(2);
+      for (i = 0; (i < 50000) or (num_reads < 100); ++i)
+	{
+	  random_op(tree, present);
+
+	  // Nodes can only be released after every pinned reader has
+	  // pinned again, so let the readers run if nodes are low.
+	  while ((num_live > (max_nodes - 100)) and !tree.reclaim())
+	    std::this_thread::yield();
+	}
+
+      writer_done = true;
+      for (i = 0; i < num_readers; ++i)
+	{
+	  thr[i]->join();
+	  delete thr[i];
+	}
+
+      if (!tree.reclaim())
+	bail("thread reclaim");
+
+      tree_t::reader rd(tree);
+      check(tree, rd.pin(), present);
+      rd.unpin();
+    }
+  }
+
+int main()
+  {
+    printf("version test\n");
+
+    version_test();
+
+    printf("reader slot test\n");
+
+    slot_test();
+
+    printf("thread test\n");
+
+    thread_test();
+
+    printf("SUCCESS!\n");
+
+    return(0);
+  }
@@ -559,6 +559,45 @@ check_last_loc(u2_idx, "UU2");
 
 END_TEST
 
+// Begin tests focusing on notify_uniq_cond().
+
+START_TEST
+
+enum
+  {
+    u_idx,
+    u2_idx,
+    s_idx,
+    s2_idx,
+    num_t
+  };
+
+thr.resize(num_t);
+
+// Thread u2 is notifying the unique lock condition, but has already called notify_one() (when no thread was waiting).
+//
+start_thr(tf_lock_unique, u2_idx, "NU0");
+
+start_thr_s(tf_lock_shared, s_idx, "US0");
+
+start_thr(tf_lock_unique, u_idx, "", "CVW0");
+
+// Thread s2 sees that a unique lock is wanted.  Thread s releases its shared lock while s2 is still sharing, so s does
+// not notify.
+//
+start_thr_s(tf_lock_shared, s2_idx, "LS3");
+next_loc(s_idx, "", "DPTD");
+
+// Thread s2 has to notify thread u, so it must wait for thread u2 to finish notifying, rather than skip the notify.
+//
+thr[s2_idx].block_loc = "";
+check_last_loc(s2_idx, "NU1");
+thr[u2_idx].block_loc = "";
+
+check_last_loc(u_idx, "UU2");
+
+END_TEST
+
 } // end anonymous namespace
 
 namespace abstract_container
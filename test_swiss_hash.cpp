@@ -0,0 +1,236 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+// Unit testing for swiss_hash_table.h .
+
+#include "swiss_hash_table.h"
+#include "swiss_hash_table.h"
+
+// Put a breakpoint on this function to break after a check fails.
+void bp() { }
+
+#include <cstdlib>
+#include <iostream>
+
+void check(bool expr, int line)
+  {
+    if (!expr)
+      {
+        std::cout << "*** fail line " << line << std::endl;
+        bp();
+        std::exit(1);
+      }
+  }
+
+#define CHK(EXPR) check((EXPR), __LINE__)
+
+using namespace abstract_container;
+
+const unsigned Num_slots = 256;
+
+const unsigned Num_elem = 2 * Num_slots;
+
+struct Elem
+  {
+    unsigned key;
+
+    // Number of times visited by an iterator.
+    unsigned visits;
+  };
+
+Elem e[Num_elem];
+
+bool present[Num_elem];
+
+// If true, all keys hash to one of a few values, so there are long probe
+// sequences, and many matching fingerprints.
+bool bad_hash;
+
+class Abs
+  {
+  protected:
+
+    typedef Elem *handle;
+    typedef unsigned index;
+    typedef unsigned key;
+
+    static const size_t num_slots = Num_slots;
+
+    static handle null() { return(0); }
+
+    bool is_key(key k, Elem *h) { return(h->key == k); }
+
+    static index hash(key k)
+      {
+        if (bad_hash)
+          return((k % 3) * 0x1001);
+
+        index h = k * 0x9E3779B1u;
+
+        return(h ^ (h >> 15));
+      }
+
+    index hash_key(key k) { return(hash(k)); }
+
+    index hash_elem(Elem *h) { return(hash(h->key)); }
+  };
+
+typedef swiss_hash_table<Abs> Ht;
+
+Ht ht;
+
+// Check that the table contains exactly the present elements.
+//
+void scan()
+  {
+    unsigned cnt = 0;
+
+    for (unsigned i = 0; i < Num_elem; ++i)
+      {
+        e[i].visits = 0;
+
+        if (present[i])
+          {
+            ++cnt;
+            CHK(ht.search(e[i].key) == (e + i));
+          }
+        else
+          CHK(ht.search(e[i].key) == Ht::null());
+      }
+
+    CHK(ht.size() == cnt);
+
+    for (Ht::iter it(ht); it; ++it)
+      ++(*it)->visits;
+
+    for (unsigned i = 0; i < Num_elem; ++i)
+      CHK(e[i].visits == (present[i] ? 1 : 0));
+  }
+
+// Random inserts and removes, keeping about max_elems elements.
+void churn(unsigned max_elems, unsigned steps)
+  {
+    unsigned cnt = 0;
+
+    for (unsigned i = 0; i < Num_elem; ++i)
+      cnt += present[i];
+
+    for (unsigned step = 0; step < steps; ++step)
+      {
+        unsigned i = unsigned(std::rand()) % Num_elem;
+
+        if (present[i])
+          {
+            if (step & 1)
+              ht.remove(e + i);
+            else
+              CHK(ht.remove_key(e[i].key) == (e + i));
+            present[i] = false;
+            --cnt;
+          }
+        else if (cnt < max_elems)
+          {
+            CHK(ht.insert(e + i));
+            present[i] = true;
+            ++cnt;
+          }
+
+        if ((step % 500) == 0)
+          scan();
+      }
+
+    scan();
+  }
+
+void empty()
+  {
+    ht.purge();
+
+    for (unsigned i = 0; i < Num_elem; ++i)
+      present[i] = false;
+
+    scan();
+  }
+
+int main()
+  {
+    unsigned i;
+
+    for (i = 0; i < Num_elem; ++i)
+      e[i].key = 5 * i;
+
+    std::srand(1);
+
+    scan();
+
+    // Low, high, and full load.
+    churn(Num_slots / 2, 20000);
+    churn((7 * Num_slots) / 8, 20000);
+    churn(Num_slots - 3, 20000);
+    churn(Num_slots, 20000);
+
+    // Insert fails when full.
+    unsigned cnt = unsigned(ht.size());
+    for (i = 0; i < Num_elem; ++i)
+      if (!present[i])
+        {
+          if (cnt == Num_slots)
+            break;
+          CHK(ht.insert(e + i));
+          present[i] = true;
+          ++cnt;
+        }
+    CHK(i < Num_elem);
+    CHK(!ht.insert(e + i));
+    scan();
+
+    empty();
+
+    // Colliding hash values.
+    bad_hash = true;
+    churn(40, 5000);
+    churn(Num_slots / 2, 5000);
+    empty();
+    bad_hash = false;
+
+    // Fill in order, then empty, then fill again, so deleted slots are
+    // reused.
+    for (i = 0; i < Num_slots; ++i)
+      {
+        CHK(ht.insert(e + i));
+        present[i] = true;
+      }
+    scan();
+    for (i = 0; i < Num_slots; ++i)
+      {
+        ht.remove(e + i);
+        present[i] = false;
+      }
+    scan();
+    for (i = Num_slots; i < Num_elem; ++i)
+      {
+        CHK(ht.insert(e + i));
+        present[i] = true;
+      }
+    scan();
+
+    std::cout << "SUCCESS!\n";
+
+    return(0);
+  }
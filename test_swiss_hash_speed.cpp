@@ -0,0 +1,196 @@
+/*
+Copyright (c) 2016, 2025 Walter William Karas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+Compare search speed of swiss_hash_table and hash_table (with singly-linked
+list buckets), with the same hash function, and the same number of slots
+as buckets, at various load factors.
+
+Usage:  a.out [ num_searches ]
+
+The timings are wall clock time, so they are only meaningful on an
+otherwise idle machine.
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <exception>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include <stdint.h>
+
+#include "hash_table.h"
+#include "swiss_hash_table.h"
+
+using std::cout;
+
+void bail(const char *msg)
+  {
+    cout << msg << '\n';
+    std::terminate();
+  }
+
+const uint32_t num_slots = 1 << 20;
+
+struct Elem
+  {
+    uint32_t key;
+    Elem *link;
+  };
+
+inline uint32_t hash(uint32_t k)
+  {
+    uint32_t h = k * 0x9E3779B1u;
+
+    return(h ^ (h >> 15));
+  }
+
+class Chain_abs
+  {
+  private:
+
+    struct List_abs
+      {
+        static const bool store_tail = false;
+        typedef Elem *handle;
+        static handle null() { return(nullptr); }
+        static handle link(handle h) { return(h->link); }
+        static void link(handle h, handle link_h) { h->link = link_h; }
+      };
+
+  protected:
+
+    typedef abstract_container::list<List_abs> list;
+    typedef uint32_t index;
+    typedef uint32_t key;
+
+    static const index num_hash_values = num_slots;
+
+    static bool is_key(key k, Elem *h) { return(h->key == k); }
+
+    static index hash_key(key k) { return(hash(k) & (num_slots - 1)); }
+
+    static index hash_elem(Elem *h) { return(hash_key(h->key)); }
+  };
+
+class Swiss_abs
+  {
+  protected:
+
+    typedef Elem *handle;
+    typedef uint32_t index;
+    typedef uint32_t key;
+
+    static const size_t num_slots = ::num_slots;
+
+    static handle null() { return(nullptr); }
+
+    static bool is_key(key k, Elem *h) { return(h->key == k); }
+
+    static index hash_key(key k) { return(hash(k)); }
+
+    static index hash_elem(Elem *h) { return(hash(h->key)); }
+  };
+
+// Too big for the stack.
+abstract_container::hash_table<Chain_abs> chain_table;
+abstract_container::swiss_hash_table<Swiss_abs> swiss_table;
+
+typedef std::chrono::steady_clock clk;
+
+unsigned long long num_searches = 4000000;
+
+// Returns nanoseconds per search.
+template <class table_t>
+double search_speed(
+  table_t &table, const std::vector<uint32_t> &queries, bool hits)
+  {
+    unsigned long long i, found = 0;
+
+    clk::time_point beg = clk::now();
+
+    for (i = 0; i < num_searches; ++i)
+      found += table.search(queries[i]) != nullptr;
+
+    double ns =
+      std::chrono::duration<double, std::nano>(clk::now() - beg).count();
+
+    if (found != (hits ? num_searches : 0))
+      bail("search result");
+
+    return(ns / num_searches);
+  }
+
+void run(unsigned load_pct)
+  {
+    uint32_t num_elems = uint32_t((uint64_t(num_slots) * load_pct) / 100);
+    std::vector<Elem> elems(num_elems);
+    std::vector<uint32_t> hit_q(num_searches), miss_q(num_searches);
+    uint32_t i;
+
+    chain_table.purge();
+    swiss_table.purge();
+
+    // Even keys are in the tables, odd keys are not.
+    for (i = 0; i < num_elems; ++i)
+      {
+        elems[i].key = 2 * i;
+        chain_table.insert(&elems[i]);
+        if (!swiss_table.insert(&elems[i]))
+          bail("swiss table full");
+      }
+
+    std::srand(load_pct);
+    for (unsigned long long j = 0; j < num_searches; ++j)
+      {
+        hit_q[j] = 2 * (uint32_t(std::rand()) % num_elems);
+        miss_q[j] = hit_q[j] + 1;
+      }
+
+    cout << std::setw(6) << load_pct << '%' << std::fixed
+         << std::setprecision(1)
+         << std::setw(10) << search_speed(chain_table, hit_q, true)
+         << std::setw(10) << search_speed(swiss_table, hit_q, true)
+         << std::setw(10) << search_speed(chain_table, miss_q, false)
+         << std::setw(10) << search_speed(swiss_table, miss_q, false)
+         << '\n';
+  }
+
+int main(int n_arg, char **arg)
+  {
+    if (n_arg > 1)
+      {
+        num_searches = std::strtoull(arg[1], 0, 10);
+        if (num_searches == 0)
+          bail("bad num_searches");
+      }
+
+    cout << "\nsearch speed (nanoseconds per search), " << num_slots
+         << " slots/buckets\n"
+         << "                  hits                misses\n"
+         << "   load     chain     swiss     chain     swiss\n";
+
+    for (unsigned load_pct = 50; load_pct <= 90; load_pct += 10)
+      run(load_pct);
+
+    return(0);
+  }